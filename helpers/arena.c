@@ -0,0 +1,33 @@
+#include "arena.h"
+
+#include <furi.h>
+
+void arena_init(Arena* arena, void* buffer, size_t size) {
+    arena->base = buffer;
+    arena->size = size;
+    arena->used = 0;
+    arena->peak = 0;
+}
+
+void* arena_push(Arena* arena, size_t size) {
+    size_t offset = (arena->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    furi_check(offset + size <= arena->size);
+    arena->used = offset + size;
+    if(arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return arena->base + offset;
+}
+
+void arena_reset(Arena* arena) {
+    arena->used = 0;
+}
+
+size_t arena_mark(const Arena* arena) {
+    return arena->used;
+}
+
+void arena_rewind(Arena* arena, size_t mark) {
+    furi_check(mark <= arena->used);
+    arena->used = mark;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Bump allocator over a caller provided buffer. Allocations are only released all
+ * at once with arena_reset, so there is nothing to fragment.
+ */
+#define ARENA_ALIGN 8
+// bytes an arena_push of size takes up, alignment included
+#define ARENA_SIZE(size) (((size) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+typedef struct {
+    uint8_t* base;
+    size_t size;
+    size_t used;
+    size_t peak; // highest used since init, for the heap report
+} Arena;
+
+void arena_init(Arena* arena, void* buffer, size_t size);
+
+// returns size bytes aligned for any type, crashes if the arena is exhausted
+void* arena_push(Arena* arena, size_t size);
+
+// releases everything pushed since init
+void arena_reset(Arena* arena);
+
+// current position, everything pushed after it can be released with arena_rewind
+size_t arena_mark(const Arena* arena);
+
+void arena_rewind(Arena* arena, size_t mark);
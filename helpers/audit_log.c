@@ -0,0 +1,387 @@
+#include "audit_log.h"
+
+#include <furi.h>
+#include <furi_hal.h>
+
+#define TAG "AuditLog"
+
+#define AUDIT_LOG_FLAG_FLUSH (1 << 0)
+#define AUDIT_LOG_FLAG_EXIT (1 << 1)
+
+// index entries and log records a query reads at once, both fit in the batch buffer
+#define AUDIT_QUERY_ENTRIES 8
+#define AUDIT_QUERY_RECORDS 64
+
+struct AuditLog {
+    FuriThread* thread;
+    FuriMutex* mutex; // the ring
+    FuriMutex* io_mutex; // the files, the batch buffer and the index state
+    Storage* storage;
+    AuditRecord ring[AUDIT_LOG_RING];
+    uint16_t head; // next record to write out
+    uint16_t count; // records pending
+    uint32_t dropped;
+    uint32_t records; // records in the log file
+    uint32_t block_first; // summary of the block the next record goes into
+    uint32_t block_last;
+    uint8_t block_cards[256 / 8];
+    uint8_t batch[AUDIT_LOG_RING * AUDIT_RECORD_SIZE]; // encoded records, kept off the small thread stack
+};
+
+static const char* const audit_result_names[AuditResultCount] = {
+    [AuditResultAccepted] = "accepted",
+    [AuditResultUnknown] = "unknown",
+    [AuditResultRevoked] = "revoked",
+    [AuditResultStale] = "stale",
+    [AuditResultWriteFailed] = "write failed",
+    [AuditResultStorageError] = "storage error",
+};
+
+const char* audit_result_name(uint8_t result) {
+    return result < AuditResultCount ? audit_result_names[result] : "?";
+}
+
+static void audit_put_u32(uint8_t* out, uint32_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+    out[2] = value >> 16;
+    out[3] = value >> 24;
+}
+
+static uint32_t audit_get_u32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+void audit_record_encode(const AuditRecord* record, uint8_t* out) {
+    audit_put_u32(out, record->time);
+    out[4] = record->card_id;
+    out[5] = record->chain_idx;
+    out[6] = record->chain_idx >> 8;
+    out[7] = record->result;
+}
+
+void audit_record_decode(AuditRecord* record, const uint8_t* in) {
+    record->time = audit_get_u32(in);
+    record->card_id = in[4];
+    record->chain_idx = in[5] | (in[6] << 8);
+    record->result = in[7];
+}
+
+// opens the index for reading and writing and returns the entries it holds
+// a missing index or one of another layout starts over empty
+static uint32_t audit_index_open(File* index) {
+    const uint8_t header[AUDIT_INDEX_HEADER_SIZE] = {
+        'H', 'T', 'A', 'I', AUDIT_INDEX_VERSION, AUDIT_INDEX_ENTRY_SIZE,
+        AUDIT_BLOCK_RECORDS & 0xFF, AUDIT_BLOCK_RECORDS >> 8};
+    uint8_t found[AUDIT_INDEX_HEADER_SIZE];
+
+    if(!storage_file_open(index, AUDIT_INDEX_PATH, FSAM_READ_WRITE, FSOM_OPEN_ALWAYS)) return 0;
+    uint64_t size = storage_file_size(index);
+    if(size >= AUDIT_INDEX_HEADER_SIZE &&
+       storage_file_read(index, found, sizeof(found)) == sizeof(found) &&
+       memcmp(found, header, sizeof(header)) == 0) {
+        return (size - AUDIT_INDEX_HEADER_SIZE) / AUDIT_INDEX_ENTRY_SIZE;
+    }
+    storage_file_seek(index, 0, true);
+    storage_file_truncate(index);
+    storage_file_write(index, header, sizeof(header));
+    return 0;
+}
+
+// writes the summary of the block the last record went into
+static void audit_index_write_block(AuditLog* log, File* index) {
+    uint8_t entry[AUDIT_INDEX_ENTRY_SIZE];
+    audit_put_u32(&entry[0], log->block_first);
+    audit_put_u32(&entry[4], log->block_last);
+    memcpy(&entry[8], log->block_cards, sizeof(log->block_cards));
+    uint32_t block = (log->records - 1) / AUDIT_BLOCK_RECORDS;
+    storage_file_seek(index, AUDIT_INDEX_HEADER_SIZE + block * AUDIT_INDEX_ENTRY_SIZE, true);
+    storage_file_write(index, entry, sizeof(entry));
+}
+
+// adds a record that is now in the log to the summary of its block
+static void audit_index_note(AuditLog* log, File* index, const AuditRecord* record) {
+    if(log->records % AUDIT_BLOCK_RECORDS == 0) {
+        log->block_first = UINT32_MAX;
+        log->block_last = 0;
+        memset(log->block_cards, 0, sizeof(log->block_cards));
+    }
+    // the RTC can be set back, so the span is the earliest and latest time, not first and last
+    if(record->time < log->block_first) log->block_first = record->time;
+    if(record->time > log->block_last) log->block_last = record->time;
+    log->block_cards[record->card_id / 8] |= 1 << (record->card_id % 8);
+    log->records++;
+    if(log->records % AUDIT_BLOCK_RECORDS == 0) {
+        audit_index_write_block(log, index);
+    }
+}
+
+// brings the index up to the log after a start, rereading the last indexed block and
+// whatever was appended after it, usually just that one block
+static void audit_log_catch_up(AuditLog* log) {
+    File* file = storage_file_alloc(log->storage);
+    File* index = storage_file_alloc(log->storage);
+    uint32_t records = 0;
+    if(storage_file_open(file, AUDIT_LOG_PATH, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        uint64_t size = storage_file_size(file);
+        if(size > AUDIT_LOG_HEADER_SIZE) {
+            records = (size - AUDIT_LOG_HEADER_SIZE) / AUDIT_RECORD_SIZE;
+        }
+    }
+
+    uint32_t blocks = audit_index_open(index);
+    uint32_t start = blocks ? blocks - 1 : 0;
+    if(start * AUDIT_BLOCK_RECORDS > records) {
+        // the log was replaced or cut short, its index has to start over
+        start = 0;
+        storage_file_seek(index, AUDIT_INDEX_HEADER_SIZE, true);
+        storage_file_truncate(index);
+    }
+
+    log->records = start * AUDIT_BLOCK_RECORDS;
+    if(log->records < records) {
+        storage_file_seek(file, AUDIT_LOG_HEADER_SIZE + log->records * AUDIT_RECORD_SIZE, true);
+    }
+    AuditRecord record;
+    while(log->records < records) {
+        uint32_t count = records - log->records;
+        if(count > AUDIT_LOG_RING) count = AUDIT_LOG_RING;
+        size_t len = count * AUDIT_RECORD_SIZE;
+        if(storage_file_read(file, log->batch, len) != len) break;
+        for(uint32_t i = 0; i < count; i++) {
+            audit_record_decode(&record, &log->batch[i * AUDIT_RECORD_SIZE]);
+            audit_index_note(log, index, &record);
+        }
+    }
+    if(log->records % AUDIT_BLOCK_RECORDS) {
+        audit_index_write_block(log, index);
+    }
+    if(log->records > start * AUDIT_BLOCK_RECORDS) {
+        FURI_LOG_I(TAG, "indexed %lu records", log->records - start * AUDIT_BLOCK_RECORDS);
+    }
+
+    storage_file_close(index);
+    storage_file_free(index);
+    storage_file_close(file);
+    storage_file_free(file);
+}
+
+// moves every pending record to the end of the file, the ring is only locked while copying
+static void audit_log_flush(AuditLog* log) {
+    furi_mutex_acquire(log->io_mutex, FuriWaitForever);
+    furi_mutex_acquire(log->mutex, FuriWaitForever);
+    uint16_t count = log->count;
+    for(uint16_t i = 0; i < count; i++) {
+        audit_record_encode(
+            &log->ring[(log->head + i) % AUDIT_LOG_RING], &log->batch[i * AUDIT_RECORD_SIZE]);
+    }
+    log->head = (log->head + count) % AUDIT_LOG_RING;
+    log->count = 0;
+    furi_mutex_release(log->mutex);
+    if(!count) {
+        furi_mutex_release(log->io_mutex);
+        return;
+    }
+
+    File* file = storage_file_alloc(log->storage);
+    bool written = storage_file_open(file, AUDIT_LOG_PATH, FSAM_WRITE, FSOM_OPEN_APPEND);
+    if(written && storage_file_size(file) == 0) {
+        const uint8_t header[AUDIT_LOG_HEADER_SIZE] = {
+            'H', 'T', 'A', 'L', AUDIT_LOG_VERSION, AUDIT_RECORD_SIZE, 0, 0};
+        written = storage_file_write(file, header, sizeof(header)) == sizeof(header);
+    }
+    size_t len = count * AUDIT_RECORD_SIZE;
+    written = written && storage_file_write(file, log->batch, len) == len;
+    storage_file_close(file);
+
+    if(written) {
+        // the index is written after the log, if this is cut off the next start catches it up
+        audit_index_open(file);
+        AuditRecord record;
+        for(uint16_t i = 0; i < count; i++) {
+            audit_record_decode(&record, &log->batch[i * AUDIT_RECORD_SIZE]);
+            audit_index_note(log, file, &record);
+        }
+        if(log->records % AUDIT_BLOCK_RECORDS) {
+            audit_index_write_block(log, file);
+        }
+        storage_file_close(file);
+    }
+    storage_file_free(file);
+    furi_mutex_release(log->io_mutex);
+
+    if(!written) {
+        FURI_LOG_E(TAG, "%u records lost, log write failed", count);
+        furi_mutex_acquire(log->mutex, FuriWaitForever);
+        log->dropped += count;
+        furi_mutex_release(log->mutex);
+    }
+}
+
+static int32_t audit_log_thread(void* context) {
+    AuditLog* log = context;
+
+    furi_mutex_acquire(log->io_mutex, FuriWaitForever);
+    audit_log_catch_up(log);
+    furi_mutex_release(log->io_mutex);
+
+    while(true) {
+        // a timeout means nothing was added for a while, the door is idle
+        uint32_t flags = furi_thread_flags_wait(
+            AUDIT_LOG_FLAG_FLUSH | AUDIT_LOG_FLAG_EXIT,
+            FuriFlagWaitAny,
+            furi_ms_to_ticks(AUDIT_LOG_IDLE_MS));
+        audit_log_flush(log);
+        if(!(flags & FuriFlagError) && (flags & AUDIT_LOG_FLAG_EXIT)) break;
+    }
+
+    return 0;
+}
+
+AuditLog* audit_log_alloc(Storage* storage) {
+    AuditLog* log = malloc(sizeof(AuditLog));
+    log->storage = storage;
+    log->head = 0;
+    log->count = 0;
+    log->dropped = 0;
+    log->records = 0;
+    log->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    log->io_mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    log->thread = furi_thread_alloc_ex(TAG, 2048, audit_log_thread, log);
+    furi_thread_set_priority(log->thread, FuriThreadPriorityLow);
+    furi_thread_start(log->thread);
+    return log;
+}
+
+void audit_log_free(AuditLog* log) {
+    furi_thread_flags_set(furi_thread_get_id(log->thread), AUDIT_LOG_FLAG_EXIT);
+    furi_thread_join(log->thread);
+    furi_thread_free(log->thread);
+    furi_mutex_free(log->io_mutex);
+    furi_mutex_free(log->mutex);
+    free(log);
+}
+
+void audit_log_add(AuditLog* log, uint8_t card_id, uint16_t chain_idx, AuditResult result) {
+    furi_mutex_acquire(log->mutex, FuriWaitForever);
+    bool wake = false;
+    if(log->count < AUDIT_LOG_RING) {
+        AuditRecord* record = &log->ring[(log->head + log->count) % AUDIT_LOG_RING];
+        record->time = furi_hal_rtc_get_timestamp();
+        record->card_id = card_id;
+        record->chain_idx = chain_idx;
+        record->result = result;
+        wake = ++log->count == AUDIT_LOG_FLUSH_AT;
+    } else {
+        log->dropped++;
+    }
+    furi_mutex_release(log->mutex);
+
+    if(wake) {
+        furi_thread_flags_set(furi_thread_get_id(log->thread), AUDIT_LOG_FLAG_FLUSH);
+    }
+}
+
+uint32_t audit_log_dropped(AuditLog* log) {
+    furi_mutex_acquire(log->mutex, FuriWaitForever);
+    uint32_t dropped = log->dropped;
+    furi_mutex_release(log->mutex);
+    return dropped;
+}
+
+// reads one block of the log and reports its matching records
+static bool audit_log_query_block(
+    AuditLog* log,
+    File* file,
+    uint32_t block,
+    int16_t card_id,
+    uint32_t from,
+    uint32_t to,
+    AuditQueryCallback callback,
+    void* context,
+    AuditQueryStats* stats) {
+    uint8_t* buffer = &log->batch[AUDIT_QUERY_ENTRIES * AUDIT_INDEX_ENTRY_SIZE];
+    uint32_t first = block * AUDIT_BLOCK_RECORDS;
+    uint32_t end = first + AUDIT_BLOCK_RECORDS;
+    if(end > log->records) end = log->records;
+    if(!storage_file_seek(file, AUDIT_LOG_HEADER_SIZE + first * AUDIT_RECORD_SIZE, true)) {
+        return false;
+    }
+
+    AuditRecord record;
+    stats->blocks_read++;
+    for(uint32_t pos = first; pos < end;) {
+        uint32_t count = end - pos;
+        if(count > AUDIT_QUERY_RECORDS) count = AUDIT_QUERY_RECORDS;
+        size_t len = count * AUDIT_RECORD_SIZE;
+        if(storage_file_read(file, buffer, len) != len) return false;
+        for(uint32_t i = 0; i < count; i++) {
+            audit_record_decode(&record, &buffer[i * AUDIT_RECORD_SIZE]);
+            if((card_id < 0 || record.card_id == card_id) && record.time >= from &&
+               record.time <= to) {
+                stats->matched++;
+                callback(&record, context);
+            }
+        }
+        pos += count;
+    }
+    return true;
+}
+
+bool audit_log_query(
+    AuditLog* log,
+    int16_t card_id,
+    uint32_t from,
+    uint32_t to,
+    AuditQueryCallback callback,
+    void* context,
+    AuditQueryStats* stats) {
+    _Static_assert(
+        AUDIT_QUERY_ENTRIES * AUDIT_INDEX_ENTRY_SIZE + AUDIT_QUERY_RECORDS * AUDIT_RECORD_SIZE <=
+            AUDIT_LOG_RING * AUDIT_RECORD_SIZE,
+        "query buffers don't fit in the batch buffer");
+    audit_log_flush(log);
+    furi_mutex_acquire(log->io_mutex, FuriWaitForever);
+
+    memset(stats, 0, sizeof(AuditQueryStats));
+    stats->blocks_total = (log->records + AUDIT_BLOCK_RECORDS - 1) / AUDIT_BLOCK_RECORDS;
+    File* file = storage_file_alloc(log->storage);
+    File* index = storage_file_alloc(log->storage);
+    bool ok = storage_file_open(file, AUDIT_LOG_PATH, FSAM_READ, FSOM_OPEN_EXISTING) ||
+              log->records == 0;
+    uint32_t entries = 0;
+    if(ok && storage_file_open(index, AUDIT_INDEX_PATH, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        uint64_t size = storage_file_size(index);
+        entries = size > AUDIT_INDEX_HEADER_SIZE ?
+                      (size - AUDIT_INDEX_HEADER_SIZE) / AUDIT_INDEX_ENTRY_SIZE :
+                      0;
+        storage_file_seek(index, AUDIT_INDEX_HEADER_SIZE, true);
+    }
+
+    // the index is streamed a few entries at a time, only blocks whose span overlaps the
+    // range and that hold the card are read. Blocks without an entry are always read
+    for(uint32_t block = 0; ok && block < stats->blocks_total; block++) {
+        uint32_t slot = block % AUDIT_QUERY_ENTRIES;
+        if(block < entries && slot == 0) {
+            uint32_t count = entries - block;
+            if(count > AUDIT_QUERY_ENTRIES) count = AUDIT_QUERY_ENTRIES;
+            size_t len = count * AUDIT_INDEX_ENTRY_SIZE;
+            if(storage_file_read(index, log->batch, len) != len) {
+                entries = block; // scan the rest of the log instead
+            }
+        }
+        if(block < entries) {
+            const uint8_t* entry = &log->batch[slot * AUDIT_INDEX_ENTRY_SIZE];
+            if(audit_get_u32(&entry[4]) < from || audit_get_u32(&entry[0]) > to) continue;
+            if(card_id >= 0 && !(entry[8 + card_id / 8] & (1 << (card_id % 8)))) continue;
+        }
+        ok = audit_log_query_block(log, file, block, card_id, from, to, callback, context, stats);
+    }
+
+    storage_file_close(index);
+    storage_file_free(index);
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_mutex_release(log->io_mutex);
+    return ok;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <storage/storage.h>
+
+#define AUDIT_LOG_PATH "/ext/rfid_hashes/audit.bin"
+// "HTAL", version u8, record size u8, 2 reserved bytes
+#define AUDIT_LOG_HEADER_SIZE 8
+#define AUDIT_LOG_VERSION 1
+// time u32, card_id u8, chain_idx u16, result u8, little-endian
+#define AUDIT_RECORD_SIZE 8
+// records held in RAM until the writer thread appends them
+#define AUDIT_LOG_RING 128
+// pending records that wake the writer right away
+#define AUDIT_LOG_FLUSH_AT 32
+// quiet time after which whatever is pending gets written
+#define AUDIT_LOG_IDLE_MS 2000
+
+// summary of every block of AUDIT_BLOCK_RECORDS log records, kept next to the log
+#define AUDIT_INDEX_PATH "/ext/rfid_hashes/audit.idx"
+// "HTAI", version u8, entry size u8, block records u16
+#define AUDIT_INDEX_HEADER_SIZE 8
+#define AUDIT_INDEX_VERSION 1
+#define AUDIT_BLOCK_RECORDS 256
+// earliest time u32, latest time u32, bit per card id (32 bytes), little-endian
+#define AUDIT_INDEX_ENTRY_SIZE 40
+
+// outcome of a tap, stored as one byte
+typedef enum {
+    AuditResultAccepted, // value matched and the card (or verifier anchor) moved on
+    AuditResultUnknown, // no card with this id
+    AuditResultRevoked,
+    AuditResultStale, // value didn't match: replayed, old or forged
+    AuditResultWriteFailed, // value matched but the card couldn't be advanced
+    AuditResultStorageError, // the card file couldn't be read or written
+    AuditResultCount,
+} AuditResult;
+
+typedef struct {
+    uint32_t time; // RTC timestamp
+    uint8_t card_id;
+    uint16_t chain_idx; // position of the card after the tap, 0 if it isn't known
+    uint8_t result; // AuditResult
+} AuditRecord;
+
+/*
+ * Append-only tap log. Taps go into a RAM ring and a low priority thread appends them to
+ * the log file in batches, once AUDIT_LOG_FLUSH_AT are pending or the log has been quiet
+ * for AUDIT_LOG_IDLE_MS, so adding a record never waits on the SD card.
+ * The thread also keeps the index: the time span of each block of records and which cards
+ * it holds, so a query only reads the blocks that can contain matches. An index that is
+ * missing or behind the log is caught up from the log when the thread starts.
+ */
+typedef struct AuditLog AuditLog;
+
+// starts the writer thread
+AuditLog* audit_log_alloc(Storage* storage);
+
+// writes out what is still pending and stops the writer thread
+void audit_log_free(AuditLog* log);
+
+// a full ring (the SD card stalled for AUDIT_LOG_RING taps) drops the record and counts it
+void audit_log_add(AuditLog* log, uint8_t card_id, uint16_t chain_idx, AuditResult result);
+
+// records lost to a full ring or a failed write
+uint32_t audit_log_dropped(AuditLog* log);
+
+void audit_record_encode(const AuditRecord* record, uint8_t* out);
+
+void audit_record_decode(AuditRecord* record, const uint8_t* in);
+
+const char* audit_result_name(uint8_t result);
+
+typedef struct {
+    uint32_t matched;
+    uint16_t blocks_read;
+    uint16_t blocks_total;
+} AuditQueryStats;
+
+// called for every match, oldest first
+typedef void (*AuditQueryCallback)(const AuditRecord* record, void* context);
+
+// writes out the pending records, then reports the records of card_id (or of every card if
+// card_id is negative) with a time in [from, to]. Runs on the calling thread
+// returns false if the log can't be read
+bool audit_log_query(
+    AuditLog* log,
+    int16_t card_id,
+    uint32_t from,
+    uint32_t to,
+    AuditQueryCallback callback,
+    void* context,
+    AuditQueryStats* stats);
@@ -0,0 +1,98 @@
+#include "card_archive.h"
+
+#include <string.h>
+#include "hash_chain.h"
+
+#define CARD_ARCHIVE_VERSION 1
+#define CARD_ARCHIVE_HEADER_SIZE 6
+
+static const uint8_t card_archive_magic[4] = {'H', 'T', 'A', 'R'};
+
+static bool card_archive_put(CardArchive* archive, const uint8_t* data, size_t len) {
+    archive->crc = hash_record_crc_update(archive->crc, data, len);
+    return storage_file_write(archive->file, data, len) == len;
+}
+
+static bool card_archive_get(CardArchive* archive, uint8_t* data, size_t len) {
+    if(storage_file_read(archive->file, data, len) != len) {
+        return false;
+    }
+    archive->crc = hash_record_crc_update(archive->crc, data, len);
+    return true;
+}
+
+bool card_archive_create(CardArchive* archive, Storage* storage, const char* path) {
+    uint8_t header[CARD_ARCHIVE_HEADER_SIZE];
+    memcpy(header, card_archive_magic, sizeof(card_archive_magic));
+    header[4] = CARD_ARCHIVE_VERSION & 0xFF;
+    header[5] = CARD_ARCHIVE_VERSION >> 8;
+
+    archive->file = storage_file_alloc(storage);
+    archive->crc = 0xFFFFFFFF;
+    archive->ended = false;
+    if(!storage_file_open(archive->file, path, FSAM_WRITE, FSOM_CREATE_ALWAYS) ||
+       !card_archive_put(archive, header, sizeof(header))) {
+        card_archive_close(archive);
+        return false;
+    }
+    return true;
+}
+
+bool card_archive_write(CardArchive* archive, const uint8_t* record, uint16_t len) {
+    uint8_t prefix[2] = {len & 0xFF, len >> 8};
+    return len && card_archive_put(archive, prefix, sizeof(prefix)) && card_archive_put(archive, record, len);
+}
+
+bool card_archive_finish(CardArchive* archive) {
+    uint8_t end[2] = {0, 0};
+    bool finished = card_archive_put(archive, end, sizeof(end));
+    uint32_t crc = ~archive->crc;
+    uint8_t trailer[4] = {crc & 0xFF, (crc >> 8) & 0xFF, (crc >> 16) & 0xFF, crc >> 24};
+    finished = finished && storage_file_write(archive->file, trailer, sizeof(trailer)) == sizeof(trailer);
+    card_archive_close(archive);
+    return finished;
+}
+
+bool card_archive_open(CardArchive* archive, Storage* storage, const char* path) {
+    uint8_t header[CARD_ARCHIVE_HEADER_SIZE];
+    archive->file = storage_file_alloc(storage);
+    archive->crc = 0xFFFFFFFF;
+    archive->ended = false;
+    if(!storage_file_open(archive->file, path, FSAM_READ, FSOM_OPEN_EXISTING) ||
+       !card_archive_get(archive, header, sizeof(header)) ||
+       memcmp(header, card_archive_magic, sizeof(card_archive_magic)) != 0 ||
+       (header[4] | (header[5] << 8)) != CARD_ARCHIVE_VERSION) {
+        card_archive_close(archive);
+        return false;
+    }
+    return true;
+}
+
+int32_t card_archive_read(CardArchive* archive, uint8_t* record, size_t size) {
+    uint8_t prefix[2];
+    if(!card_archive_get(archive, prefix, sizeof(prefix))) {
+        return -1;
+    }
+    uint16_t len = prefix[0] | (prefix[1] << 8);
+    if(len == 0) {
+        uint8_t trailer[4];
+        if(storage_file_read(archive->file, trailer, sizeof(trailer)) != sizeof(trailer)) {
+            return -1;
+        }
+        uint32_t crc = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((uint32_t)trailer[3] << 24);
+        archive->ended = crc == ~archive->crc;
+        return 0;
+    }
+    if(len > size || !card_archive_get(archive, record, len)) {
+        return -1;
+    }
+    return len;
+}
+
+void card_archive_close(CardArchive* archive) {
+    if(archive->file) {
+        storage_file_close(archive->file);
+        storage_file_free(archive->file);
+        archive->file = NULL;
+    }
+}
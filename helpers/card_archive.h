@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <storage/storage.h>
+
+// kept in the app's data directory
+#define CARD_ARCHIVE_FILE "cards.htar"
+
+/*
+ * Single file holding many card records, written and read one record at a time.
+ * Layout, little-endian:
+ *   char[4] magic "HTAR", u16 version
+ *   per card: u16 record length (1..HASH_RECORD_MAX_SIZE), record as made by hash_record_encode
+ *   u16 0 ends the records
+ *   u32 CRC-32 of every byte before it
+ * tools/hashtag_archive.py reads and writes the same format on a computer.
+ */
+typedef struct {
+    File* file;
+    uint32_t crc; // running CRC of everything read or written so far
+    bool ended; // read the end marker and matching CRC
+} CardArchive;
+
+// creates the archive and writes its header
+bool card_archive_create(CardArchive* archive, Storage* storage, const char* path);
+
+bool card_archive_write(CardArchive* archive, const uint8_t* record, uint16_t len);
+
+// writes the end marker and the CRC, then closes the file
+bool card_archive_finish(CardArchive* archive);
+
+// opens an archive and checks its header
+bool card_archive_open(CardArchive* archive, Storage* storage, const char* path);
+
+// reads the next record into record, which holds size bytes
+// returns its length, 0 after the last one (archive->ended tells if the CRC matched), -1 on a malformed archive
+int32_t card_archive_read(CardArchive* archive, uint8_t* record, size_t size);
+
+void card_archive_close(CardArchive* archive);
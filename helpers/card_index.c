@@ -0,0 +1,180 @@
+#include "card_index.h"
+
+#include <furi.h>
+#include <string.h>
+
+#define TAG "CardIndex"
+
+/*
+ * File layout, little-endian:
+ *   0  char[4] magic "HTIX"
+ *   4  u16     version
+ *   6  u16     cards present
+ *   8  u32     CRC-32 of the entries
+ *  12  entries
+ */
+#define CARD_INDEX_VERSION 3
+#define CARD_INDEX_HEADER_SIZE 12
+
+static const uint8_t card_index_magic[4] = {'H', 'T', 'I', 'X'};
+
+// chain values are hash output, folding the halves keeps every bit in play
+static uint16_t card_index_fingerprint(const uint8_t* value) {
+    return (value[0] ^ value[2]) | ((value[1] ^ value[3]) << 8);
+}
+
+static uint8_t* card_index_entry(CardIndex* index, uint8_t card_id) {
+    return &index->entries[card_id * CARD_INDEX_ENTRY_SIZE];
+}
+
+static void card_index_mark_checked(CardIndex* index, uint8_t card_id) {
+    index->checked[card_id / 8] |= 1 << (card_id % 8);
+}
+
+void card_index_clear(CardIndex* index) {
+    memset(index->entries, 0, sizeof(index->entries));
+    index->count = 0;
+    index->revoked = 0;
+    index->dirty = true;
+    // a cleared index is filled from the card files (or there are none yet)
+    memset(index->checked, 0xFF, sizeof(index->checked));
+}
+
+bool card_index_load(CardIndex* index, Storage* storage, const char* path) {
+    uint8_t header[CARD_INDEX_HEADER_SIZE];
+    bool loaded = false;
+    File* file = storage_file_alloc(storage);
+
+    if(storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING) &&
+       storage_file_read(file, header, sizeof(header)) == sizeof(header) &&
+       storage_file_read(file, index->entries, sizeof(index->entries)) == sizeof(index->entries)) {
+        uint16_t version = header[4] | (header[5] << 8);
+        uint32_t crc = header[8] | (header[9] << 8) | (header[10] << 16) | ((uint32_t)header[11] << 24);
+        loaded = memcmp(header, card_index_magic, sizeof(card_index_magic)) == 0 &&
+                 version == CARD_INDEX_VERSION &&
+                 crc == hash_record_crc(CARD_INDEX_VERSION, index->entries, sizeof(index->entries));
+    }
+    index->count = 0;
+    index->revoked = 0;
+    for(uint16_t i = 0; loaded && i < CARD_INDEX_CARDS; i++) {
+        CardSummary summary;
+        if(card_index_get(index, i, &summary)) {
+            index->count++;
+            index->revoked += (summary.flags & HashRecordFlagRevoked) != 0;
+        }
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+
+    if(!loaded) {
+        FURI_LOG_W(TAG, "index missing or invalid");
+        card_index_clear(index);
+    } else {
+        index->dirty = false;
+        memset(index->checked, 0, sizeof(index->checked));
+    }
+    return loaded;
+}
+
+bool card_index_save(CardIndex* index, Storage* storage, const char* path) {
+    uint8_t header[CARD_INDEX_HEADER_SIZE];
+    uint32_t crc = hash_record_crc(CARD_INDEX_VERSION, index->entries, sizeof(index->entries));
+    memcpy(header, card_index_magic, sizeof(card_index_magic));
+    header[4] = CARD_INDEX_VERSION & 0xFF;
+    header[5] = CARD_INDEX_VERSION >> 8;
+    header[6] = index->count & 0xFF;
+    header[7] = index->count >> 8;
+    header[8] = crc & 0xFF;
+    header[9] = (crc >> 8) & 0xFF;
+    header[10] = (crc >> 16) & 0xFF;
+    header[11] = crc >> 24;
+
+    File* file = storage_file_alloc(storage);
+    bool saved = storage_file_open(file, path, FSAM_WRITE, FSOM_CREATE_ALWAYS) &&
+                 storage_file_write(file, header, sizeof(header)) == sizeof(header) &&
+                 storage_file_write(file, index->entries, sizeof(index->entries)) == sizeof(index->entries);
+    storage_file_close(file);
+    storage_file_free(file);
+
+    if(saved) {
+        index->dirty = false;
+    }
+    return saved;
+}
+
+void card_index_set(CardIndex* index, const HashData* data, uint32_t last_seen) {
+    uint8_t* entry = card_index_entry(index, data->card_id);
+    if(entry[2] == 0 && entry[3] == 0) {
+        index->count++;
+    } else if(entry[8] & HashRecordFlagRevoked) {
+        index->revoked--;
+    }
+    if(data->flags & HashRecordFlagRevoked) {
+        index->revoked++;
+    }
+    entry[0] = data->curr_idx & 0xFF;
+    entry[1] = data->curr_idx >> 8;
+    entry[2] = data->chain_len & 0xFF;
+    entry[3] = data->chain_len >> 8;
+    entry[4] = last_seen & 0xFF;
+    entry[5] = (last_seen >> 8) & 0xFF;
+    entry[6] = (last_seen >> 16) & 0xFF;
+    entry[7] = last_seen >> 24;
+    entry[8] = data->flags;
+    uint16_t fingerprint = 0;
+    if(!(data->flags & HashRecordFlagVerifier)) {
+        fingerprint = card_index_fingerprint((const uint8_t*)&data->hash_bytes[data->curr_idx]);
+    }
+    entry[9] = fingerprint & 0xFF;
+    entry[10] = fingerprint >> 8;
+    index->dirty = true;
+    card_index_mark_checked(index, data->card_id);
+}
+
+void card_index_remove(CardIndex* index, uint8_t card_id) {
+    uint8_t* entry = card_index_entry(index, card_id);
+    if(entry[2] == 0 && entry[3] == 0) {
+        return;
+    }
+    if(entry[8] & HashRecordFlagRevoked) {
+        index->revoked--;
+    }
+    memset(entry, 0, CARD_INDEX_ENTRY_SIZE);
+    index->count--;
+    index->dirty = true;
+    card_index_mark_checked(index, card_id);
+}
+
+bool card_index_get(const CardIndex* index, uint8_t card_id, CardSummary* summary) {
+    const uint8_t* entry = &index->entries[card_id * CARD_INDEX_ENTRY_SIZE];
+    summary->curr_idx = entry[0] | (entry[1] << 8);
+    summary->chain_len = entry[2] | (entry[3] << 8);
+    summary->last_seen = entry[4] | (entry[5] << 8) | (entry[6] << 16) | ((uint32_t)entry[7] << 24);
+    summary->flags = entry[8];
+    summary->fingerprint = entry[9] | (entry[10] << 8);
+    return summary->chain_len != 0;
+}
+
+bool card_index_may_match(const CardIndex* index, uint8_t card_id, const uint8_t* value) {
+    CardSummary summary;
+    if(!card_index_get(index, card_id, &summary) || (summary.flags & HashRecordFlagRevoked)) {
+        return false;
+    }
+    return (summary.flags & HashRecordFlagVerifier) || summary.fingerprint == card_index_fingerprint(value);
+}
+
+bool card_index_is_checked(const CardIndex* index, uint8_t card_id) {
+    return index->checked[card_id / 8] & (1 << (card_id % 8));
+}
+
+void card_index_check(CardIndex* index, uint8_t card_id, const HashData* data) {
+    CardSummary summary;
+    bool present = card_index_get(index, card_id, &summary);
+    if(data && (!present || summary.curr_idx != data->curr_idx ||
+                summary.chain_len != data->chain_len || summary.flags != data->flags)) {
+        FURI_LOG_W(TAG, "entry of card %u was behind its file, repaired", card_id);
+        card_index_set(index, data, present ? summary.last_seen : 0);
+    }
+    // a listed card without a file is reported by the file read, its entry is left alone
+    card_index_mark_checked(index, card_id);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <storage/storage.h>
+#include "hash_chain.h"
+
+// kept in the app's data directory
+#define CARD_INDEX_FILE "index.bin"
+// one entry per possible card id
+#define CARD_INDEX_CARDS 256
+// curr_idx u16, chain_len u16, last_seen u32, flags u8, fingerprint u16, little-endian,
+// the card id is the entry's position
+#define CARD_INDEX_ENTRY_SIZE 11
+
+typedef struct {
+    uint16_t curr_idx;
+    uint16_t chain_len;
+    uint32_t last_seen; // RTC timestamp of the last record write, 0 if unknown
+    uint8_t flags; // HashRecordFlag of the record
+    uint16_t fingerprint; // of the value the card is expected to present, unused for verifier records
+} CardSummary;
+
+/*
+ * Summary of every stored card, kept in RAM in its file layout so loading and saving it
+ * is a single read or write. It is a cache of the card files: it is rebuilt from them
+ * when the file is missing or fails its CRC.
+ * The index is saved after the record writes, so power lost in between leaves a valid
+ * index with an entry behind its card file. Loaded entries are therefore only trusted
+ * to reject a tag once they were checked against the card file, see card_index_check.
+ */
+typedef struct {
+    uint8_t entries[CARD_INDEX_CARDS * CARD_INDEX_ENTRY_SIZE]; // chain_len 0 marks a free id
+    uint16_t count; // cards present, revoked ones included
+    uint16_t revoked; // cards whose files still have to be removed
+    bool dirty; // changed since the last save
+    uint8_t checked[CARD_INDEX_CARDS / 8]; // bit per entry known to agree with its card file
+} CardIndex;
+
+void card_index_clear(CardIndex* index);
+
+// returns false if the file is missing, from another version or corrupt
+// loaded entries start out unchecked
+bool card_index_load(CardIndex* index, Storage* storage, const char* path);
+
+bool card_index_save(CardIndex* index, Storage* storage, const char* path);
+
+// records the state of a card after its record was written
+void card_index_set(CardIndex* index, const HashData* data, uint32_t last_seen);
+
+void card_index_remove(CardIndex* index, uint8_t card_id);
+
+// returns false if there is no card with this id
+bool card_index_get(const CardIndex* index, uint8_t card_id, CardSummary* summary);
+
+/*
+ * Fast reject for a tag read, without touching storage. The index works as a quotient
+ * filter: the card id picks the entry, which keeps a 16 bit fingerprint of the value the
+ * card should present next. Returns false for unknown and revoked ids and for values whose
+ * fingerprint doesn't match, true means the card file has to be checked.
+ * Verifier records only pass on their id, their next value isn't known.
+ */
+bool card_index_may_match(const CardIndex* index, uint8_t card_id, const uint8_t* value);
+
+// false for an entry loaded from the file that wasn't compared with its card file yet
+bool card_index_is_checked(const CardIndex* index, uint8_t card_id);
+
+// brings the entry in line with the card's record just read from storage, NULL if the card
+// has no file, and marks it checked
+void card_index_check(CardIndex* index, uint8_t card_id, const HashData* data);
@@ -0,0 +1,105 @@
+#include "chain_pool.h"
+
+#include <furi.h>
+#include <furi_hal.h>
+
+#define TAG "ChainPool"
+
+#define CHAIN_POOL_FLAG_REFILL (1 << 0)
+#define CHAIN_POOL_FLAG_EXIT (1 << 1)
+
+struct ChainPool {
+    FuriThread* thread;
+    FuriMutex* mutex;
+    HashData chains[CHAIN_POOL_SIZE];
+    uint8_t count; // ready chains, always the first count entries
+    HashData scratch; // chain being generated, kept off the small thread stack
+};
+
+// RTC timestamp, a running counter and random bytes, so chains made in the same second differ
+void chain_pool_generate(HashData* data) {
+    static uint32_t counter = 0;
+    uint8_t nonce[CHAIN_POOL_NONCE_LEN];
+    furi_hal_random_fill_buf(nonce, sizeof(nonce));
+    chain_pool_generate_from(data, furi_hal_rtc_get_timestamp(), counter++, nonce);
+}
+
+// chains are keyed with the site key when one is set, their steps then only hash the 4 byte
+// value so verifier-only units can check them (unkeyed, a 32 bit step could be brute forced)
+void chain_pool_generate_from(HashData* data, uint32_t timestamp, uint32_t seq, const uint8_t* nonce) {
+    uint8_t seed[sizeof(uint32_t) + sizeof(uint32_t) + CHAIN_POOL_NONCE_LEN];
+    // the record only keeps seeds up to HASH_SEED_MAX, longer ones store the whole chain
+    _Static_assert(sizeof(seed) <= HASH_SEED_MAX, "chain seed must fit a seed only record");
+    memcpy(seed, &timestamp, sizeof(timestamp));
+    memcpy(&seed[sizeof(uint32_t)], &seq, sizeof(seq));
+    memcpy(&seed[sizeof(uint32_t) + sizeof(uint32_t)], nonce, CHAIN_POOL_NONCE_LEN);
+    if(hash_backend_has_key()) {
+        hash_chain_generate(data, HashBackendRipemd128Keyed, HashRecordFlagShortStep, seed, sizeof(seed));
+    } else {
+        hash_chain_generate(data, HASH_BACKEND_DEFAULT, 0, seed, sizeof(seed));
+    }
+}
+
+static int32_t chain_pool_thread(void* context) {
+    ChainPool* pool = context;
+
+    while(true) {
+        furi_mutex_acquire(pool->mutex, FuriWaitForever);
+        bool full = pool->count >= CHAIN_POOL_SIZE;
+        furi_mutex_release(pool->mutex);
+
+        if(full) {
+            uint32_t flags = furi_thread_flags_wait(
+                CHAIN_POOL_FLAG_REFILL | CHAIN_POOL_FLAG_EXIT, FuriFlagWaitAny, FuriWaitForever);
+            if(flags & CHAIN_POOL_FLAG_EXIT) break;
+            continue;
+        }
+
+        // hash outside the lock so a pop never waits on a whole chain
+        chain_pool_generate(&pool->scratch);
+
+        furi_mutex_acquire(pool->mutex, FuriWaitForever);
+        if(pool->count < CHAIN_POOL_SIZE) {
+            memcpy(&pool->chains[pool->count++], &pool->scratch, sizeof(HashData));
+        }
+        furi_mutex_release(pool->mutex);
+
+        if(furi_thread_flags_get() & CHAIN_POOL_FLAG_EXIT) break;
+    }
+
+    return 0;
+}
+
+ChainPool* chain_pool_alloc(void) {
+    ChainPool* pool = malloc(sizeof(ChainPool));
+    pool->count = 0;
+    pool->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    pool->thread = furi_thread_alloc_ex(TAG, 1024, chain_pool_thread, pool);
+    furi_thread_set_priority(pool->thread, FuriThreadPriorityLow);
+    furi_thread_start(pool->thread);
+    return pool;
+}
+
+void chain_pool_free(ChainPool* pool) {
+    furi_thread_flags_set(furi_thread_get_id(pool->thread), CHAIN_POOL_FLAG_EXIT);
+    furi_thread_join(pool->thread);
+    furi_thread_free(pool->thread);
+    furi_mutex_free(pool->mutex);
+    free(pool);
+}
+
+bool chain_pool_pop(ChainPool* pool, HashData* data) {
+    uint8_t card_id = data->card_id;
+    bool popped = false;
+
+    furi_mutex_acquire(pool->mutex, FuriWaitForever);
+    if(pool->count > 0) {
+        memcpy(data, &pool->chains[--pool->count], sizeof(HashData));
+        popped = true;
+    }
+    furi_mutex_release(pool->mutex);
+
+    data->card_id = card_id;
+    furi_thread_flags_set(furi_thread_get_id(pool->thread), CHAIN_POOL_FLAG_REFILL);
+    return popped;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include "hash_chain.h"
+
+// chains kept ready in RAM
+#define CHAIN_POOL_SIZE 4
+// random bytes in a chain's seed
+#define CHAIN_POOL_NONCE_LEN 8
+
+/*
+ * Keeps a few freshly seeded hash chains ready so enrolment doesn't wait for hashing.
+ * A low priority thread refills the pool whenever a chain is taken out.
+ */
+typedef struct ChainPool ChainPool;
+
+// allocates the pool and starts the generator thread
+ChainPool* chain_pool_alloc(void);
+
+// stops the generator thread and frees the pool
+void chain_pool_free(ChainPool* pool);
+
+// moves a ready chain into data, card_id is left untouched
+// returns false if the pool is empty, the caller has to generate one itself then
+bool chain_pool_pop(ChainPool* pool, HashData* data);
+
+// seeds a chain on the calling thread the same way the pool does
+void chain_pool_generate(HashData* data);
+
+// the chain of a given seed: RTC timestamp, sequence number and CHAIN_POOL_NONCE_LEN bytes
+// the same arguments always give the same chain
+void chain_pool_generate_from(HashData* data, uint32_t timestamp, uint32_t seq, const uint8_t* nonce);
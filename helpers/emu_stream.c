@@ -0,0 +1,140 @@
+#include "emu_stream.h"
+
+#include <furi.h>
+#include <furi_hal.h>
+#include <furi_hal_rfid.h>
+#include <toolbox/pulse_protocols/pulse_glue.h>
+
+// DMA buffer length in pairs, each half is refilled while the other one plays
+#define EMU_PLAYER_DMA_LEN 256
+
+struct EmuPlayer {
+    uint32_t duration[EMU_PLAYER_DMA_LEN];
+    uint32_t pulse[EMU_PLAYER_DMA_LEN];
+    const EmuStream* volatile playing;
+    const EmuStream* volatile next; // set by a switch, taken over by the interrupt
+    uint16_t pos; // next pair of playing to copy
+    volatile uint32_t switch_start; // cycle counter at the switch request
+    volatile uint32_t switch_cycles;
+    bool running;
+};
+
+EmuStream* emu_stream_encode(ProtocolDict* dict, ProtocolId protocol) {
+    uint16_t(*pairs)[2] = malloc(sizeof(uint16_t[2]) * EMU_STREAM_MAX_PERIODS);
+    PulseGlue* glue = pulse_glue_alloc();
+    bool fits = true;
+
+    protocol_dict_encoder_start(dict, protocol);
+    for(size_t i = 0; i < EMU_STREAM_MAX_PERIODS && fits; i++) {
+        bool pulse_pop = false;
+        while(!pulse_pop) {
+            LevelDuration level_duration = protocol_dict_encoder_yield(dict, protocol);
+            pulse_pop = pulse_glue_push(
+                glue,
+                level_duration_get_level(level_duration),
+                level_duration_get_duration(level_duration));
+        }
+        uint32_t duration, pulse;
+        pulse_glue_pop(glue, &duration, &pulse);
+        fits = duration > 0 && duration <= UINT16_MAX + 1;
+        pairs[i][0] = duration - 1;
+        pairs[i][1] = pulse;
+    }
+    pulse_glue_free(glue);
+
+    // the encoders loop over their frame, so the shortest period the whole sample repeats
+    // with is one frame (or two, when the frame doesn't end on a full pulse)
+    uint16_t count = 0;
+    for(uint16_t period = 1; fits && period <= EMU_STREAM_MAX_PERIODS / 2; period++) {
+        if(memcmp(pairs, pairs[period], sizeof(pairs[0]) * (EMU_STREAM_MAX_PERIODS - period)) == 0) {
+            count = period;
+            break;
+        }
+    }
+
+    EmuStream* stream = NULL;
+    if(count) {
+        stream = malloc(sizeof(EmuStream) + sizeof(pairs[0]) * count);
+        stream->count = count;
+        memcpy(stream->pairs, pairs, sizeof(pairs[0]) * count);
+    }
+    free(pairs);
+    return stream;
+}
+
+void emu_stream_free(EmuStream* stream) {
+    free(stream);
+}
+
+// copies the next len pairs into the DMA buffer, a pending switch is taken at a frame start
+static void emu_player_fill(EmuPlayer* player, size_t start, size_t len) {
+    for(size_t i = start; i < start + len; i++) {
+        if(player->pos == 0 && player->next) {
+            player->playing = player->next;
+            player->next = NULL;
+            player->switch_cycles = DWT->CYCCNT - player->switch_start;
+        }
+        const EmuStream* stream = player->playing;
+        player->duration[i] = stream->pairs[player->pos][0];
+        player->pulse[i] = stream->pairs[player->pos][1];
+        if(++player->pos == stream->count) {
+            player->pos = 0;
+        }
+    }
+}
+
+// runs in the DMA interrupt, half means the first half has been played
+static void emu_player_dma_isr(bool half, void* context) {
+    EmuPlayer* player = context;
+    emu_player_fill(player, half ? 0 : EMU_PLAYER_DMA_LEN / 2, EMU_PLAYER_DMA_LEN / 2);
+}
+
+EmuPlayer* emu_player_alloc(void) {
+    EmuPlayer* player = malloc(sizeof(EmuPlayer));
+    player->playing = NULL;
+    player->next = NULL;
+    player->running = false;
+    return player;
+}
+
+void emu_player_free(EmuPlayer* player) {
+    emu_player_stop(player);
+    free(player);
+}
+
+void emu_player_start(EmuPlayer* player, const EmuStream* stream) {
+    emu_player_stop(player);
+    player->playing = stream;
+    player->next = NULL;
+    player->pos = 0;
+    player->switch_cycles = 0;
+    emu_player_fill(player, 0, EMU_PLAYER_DMA_LEN);
+    furi_hal_rfid_tim_emulate_dma_start(
+        player->duration, player->pulse, EMU_PLAYER_DMA_LEN, emu_player_dma_isr, player);
+    player->running = true;
+}
+
+void emu_player_switch(EmuPlayer* player, const EmuStream* stream) {
+    if(!player->running) {
+        emu_player_start(player, stream);
+        return;
+    }
+    player->switch_cycles = 0;
+    player->switch_start = DWT->CYCCNT;
+    player->next = stream;
+}
+
+void emu_player_stop(EmuPlayer* player) {
+    if(player->running) {
+        furi_hal_rfid_tim_emulate_dma_stop();
+        player->running = false;
+    }
+}
+
+bool emu_player_is_playing(const EmuPlayer* player) {
+    return player->running;
+}
+
+uint32_t emu_player_switch_cycles(const EmuPlayer* player) {
+    return player->switch_cycles;
+}
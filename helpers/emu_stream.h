@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <lib/lfrfid/lfrfid_worker.h>
+
+// longest frame that can be cached, in carrier timer periods, enough for 96 bit FSK frames
+#define EMU_STREAM_MAX_PERIODS 1280
+
+/*
+ * One tag's emulation signal, encoded once. The protocol encoder's output is glued into
+ * the timer period and pulse pairs the RFID timer DMA plays, and one repetition of the
+ * frame is kept, already in register form.
+ */
+typedef struct {
+    uint16_t count; // pairs in one frame
+    uint16_t pairs[][2]; // timer auto reload (period - 1) and compare (pulse) values
+} EmuStream;
+
+// encodes the data currently set for protocol in dict
+// returns NULL if the frame doesn't repeat within EMU_STREAM_MAX_PERIODS
+EmuStream* emu_stream_encode(ProtocolDict* dict, ProtocolId protocol);
+
+void emu_stream_free(EmuStream* stream);
+
+/*
+ * Plays cached streams through the RFID timer DMA, the way the LFRFID worker's emulation
+ * does, but the half buffer refills are plain copies made in the DMA interrupt. Switching
+ * to another stream only swaps the pointer the next refill reads from, there is no encoding
+ * and no worker to restart. The LFRFID worker has to be stopped while a stream plays.
+ */
+typedef struct EmuPlayer EmuPlayer;
+
+EmuPlayer* emu_player_alloc(void);
+
+// stops playback if needed
+void emu_player_free(EmuPlayer* player);
+
+void emu_player_start(EmuPlayer* player, const EmuStream* stream);
+
+// the new stream takes over at the end of the frame being copied
+void emu_player_switch(EmuPlayer* player, const EmuStream* stream);
+
+void emu_player_stop(EmuPlayer* player);
+
+bool emu_player_is_playing(const EmuPlayer* player);
+
+// CPU cycles from the last switch request until the new stream's first pair was in the DMA
+// buffer, 0 while the switch is still pending
+uint32_t emu_player_switch_cycles(const EmuPlayer* player);
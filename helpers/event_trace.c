@@ -0,0 +1,158 @@
+#include "event_trace.h"
+
+#include <furi.h>
+#include <furi_hal.h>
+
+struct EventTrace {
+    File* file;
+    bool open;
+    bool writing;
+    uint8_t buffer[EVENT_TRACE_BUFFER];
+    uint16_t len; // bytes in buffer
+    uint16_t pos; // next byte to read
+    uint32_t start_tick;
+    uint32_t start_time;
+};
+
+static void event_trace_put_u32(uint8_t* out, uint32_t value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = value >> 24;
+}
+
+static uint32_t event_trace_get_u32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+EventTrace* event_trace_alloc(Storage* storage) {
+    EventTrace* trace = malloc(sizeof(EventTrace));
+    trace->file = storage_file_alloc(storage);
+    trace->open = false;
+    return trace;
+}
+
+void event_trace_free(EventTrace* trace) {
+    event_trace_close(trace);
+    storage_file_free(trace->file);
+    free(trace);
+}
+
+bool event_trace_record(EventTrace* trace, const char* path) {
+    event_trace_close(trace);
+    if(!storage_file_open(trace->file, path, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        storage_file_close(trace->file);
+        return false;
+    }
+    uint32_t frequency = furi_kernel_get_tick_frequency();
+    uint8_t header[EVENT_TRACE_HEADER_SIZE] = {
+        'H', 'T', 'T', 'R', EVENT_TRACE_VERSION, 0, frequency & 0xFF, frequency >> 8};
+    trace->start_tick = furi_get_tick();
+    trace->start_time = furi_hal_rtc_get_timestamp();
+    event_trace_put_u32(&header[8], trace->start_tick);
+    event_trace_put_u32(&header[12], trace->start_time);
+    trace->open = true;
+    trace->writing = true;
+    trace->len = 0;
+    if(storage_file_write(trace->file, header, sizeof(header)) != sizeof(header)) {
+        event_trace_close(trace);
+        return false;
+    }
+    return true;
+}
+
+bool event_trace_replay(EventTrace* trace, const char* path) {
+    event_trace_close(trace);
+    uint8_t header[EVENT_TRACE_HEADER_SIZE];
+    if(!storage_file_open(trace->file, path, FSAM_READ, FSOM_OPEN_EXISTING) ||
+       storage_file_read(trace->file, header, sizeof(header)) != sizeof(header) ||
+       memcmp(header, "HTTR", 4) != 0 || header[4] != EVENT_TRACE_VERSION) {
+        storage_file_close(trace->file);
+        return false;
+    }
+    trace->start_tick = event_trace_get_u32(&header[8]);
+    trace->start_time = event_trace_get_u32(&header[12]);
+    trace->open = true;
+    trace->writing = false;
+    trace->len = 0;
+    trace->pos = 0;
+    return true;
+}
+
+bool event_trace_add(EventTrace* trace, const TraceEvent* event) {
+    if(!trace->open || !trace->writing) return false;
+    // a full buffer that wasn't written yet drops the record rather than writing here
+    if(trace->len + EVENT_TRACE_RECORD_SIZE + EVENT_TRACE_DATA_SIZE > EVENT_TRACE_BUFFER) {
+        return true;
+    }
+    uint8_t* out = &trace->buffer[trace->len];
+    out[0] = event->tick;
+    out[1] = event->tick >> 8;
+    out[2] = event->tick >> 16;
+    out[3] = event->tick >> 24;
+    out[4] = event->delay;
+    out[5] = event->delay >> 8;
+    out[6] = event->type | (event->has_data ? EVENT_TRACE_HAS_DATA : 0) |
+             (event->repeat ? EVENT_TRACE_REPEAT : 0);
+    trace->len += EVENT_TRACE_RECORD_SIZE;
+    if(event->has_data) {
+        out[7] = event->protocol;
+        memcpy(&out[8], event->data, sizeof(event->data));
+        trace->len += EVENT_TRACE_DATA_SIZE;
+    }
+    return trace->len + EVENT_TRACE_RECORD_SIZE + EVENT_TRACE_DATA_SIZE > EVENT_TRACE_BUFFER;
+}
+
+bool event_trace_flush(EventTrace* trace) {
+    if(!trace->open || !trace->writing || !trace->len) return true;
+    bool written = storage_file_write(trace->file, trace->buffer, trace->len) == trace->len;
+    trace->len = 0;
+    return written;
+}
+
+// makes sure count bytes are in the buffer from pos on
+static bool event_trace_fill(EventTrace* trace, uint16_t count) {
+    if(trace->len - trace->pos >= count) return true;
+    memmove(trace->buffer, &trace->buffer[trace->pos], trace->len - trace->pos);
+    trace->len -= trace->pos;
+    trace->pos = 0;
+    trace->len += storage_file_read(
+        trace->file, &trace->buffer[trace->len], EVENT_TRACE_BUFFER - trace->len);
+    return trace->len >= count;
+}
+
+bool event_trace_next(EventTrace* trace, TraceEvent* event) {
+    if(!trace->open || trace->writing || !event_trace_fill(trace, EVENT_TRACE_RECORD_SIZE)) {
+        return false;
+    }
+    const uint8_t* in = &trace->buffer[trace->pos];
+    event->tick = event_trace_get_u32(in);
+    event->delay = in[4] | (in[5] << 8);
+    event->type = in[6] & ~(EVENT_TRACE_HAS_DATA | EVENT_TRACE_REPEAT);
+    event->has_data = in[6] & EVENT_TRACE_HAS_DATA;
+    event->repeat = in[6] & EVENT_TRACE_REPEAT;
+    trace->pos += EVENT_TRACE_RECORD_SIZE;
+    if(event->has_data) {
+        if(!event_trace_fill(trace, EVENT_TRACE_DATA_SIZE)) return false;
+        in = &trace->buffer[trace->pos];
+        event->protocol = in[0];
+        memcpy(event->data, &in[1], sizeof(event->data));
+        trace->pos += EVENT_TRACE_DATA_SIZE;
+    }
+    return true;
+}
+
+void event_trace_close(EventTrace* trace) {
+    if(!trace->open) return;
+    event_trace_flush(trace);
+    storage_file_close(trace->file);
+    trace->open = false;
+}
+
+uint32_t event_trace_start_tick(const EventTrace* trace) {
+    return trace->start_tick;
+}
+
+uint32_t event_trace_start_time(const EventTrace* trace) {
+    return trace->start_time;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <storage/storage.h>
+
+// "HTTR", version u8, reserved u8, tick frequency u16, kernel tick and RTC timestamp (u32 each)
+// the recording started at
+#define EVENT_TRACE_HEADER_SIZE 16
+#define EVENT_TRACE_VERSION 2
+// tick u32, delay u16, type u8 with EVENT_TRACE_HAS_DATA and EVENT_TRACE_REPEAT, then protocol u8
+// and 8 data bytes if the first bit is set, little-endian
+#define EVENT_TRACE_RECORD_SIZE 7
+#define EVENT_TRACE_DATA_SIZE 9
+#define EVENT_TRACE_HAS_DATA 0x80
+#define EVENT_TRACE_REPEAT 0x40
+// records are collected here and written when it fills up
+#define EVENT_TRACE_BUFFER 512
+
+typedef struct {
+    uint32_t tick; // kernel tick the event was handled at
+    uint16_t delay; // ticks it waited in the event queue, saturated
+    uint8_t type; // RfidAppEventType
+    bool has_data;
+    bool repeat; // auto repeat of a held key
+    uint8_t protocol; // ProtocolId, 0xFF for none
+    uint8_t data[8];
+} TraceEvent;
+
+/*
+ * Compact file of the events the app's state machine handled, for replaying a session.
+ * Records are buffered in RAM; the caller decides when a full buffer gets written, so a
+ * write never lands inside an event's handling.
+ */
+typedef struct EventTrace EventTrace;
+
+EventTrace* event_trace_alloc(Storage* storage);
+
+// closes the trace first, writing out what is buffered
+void event_trace_free(EventTrace* trace);
+
+// starts a new trace file, replacing an old one, with the current tick and RTC time as its start
+bool event_trace_record(EventTrace* trace, const char* path);
+
+// opens a trace for reading, returns false if it is missing or from another version
+bool event_trace_replay(EventTrace* trace, const char* path);
+
+// buffers a record, returns true once the buffer should be written with event_trace_flush
+bool event_trace_add(EventTrace* trace, const TraceEvent* event);
+
+bool event_trace_flush(EventTrace* trace);
+
+// returns false at the end of the trace or on a cut off record
+bool event_trace_next(EventTrace* trace, TraceEvent* event);
+
+void event_trace_close(EventTrace* trace);
+
+// kernel tick the recording started at, of the trace opened with event_trace_replay
+uint32_t event_trace_start_tick(const EventTrace* trace);
+
+// RTC timestamp the recording started at
+uint32_t event_trace_start_time(const EventTrace* trace);
@@ -0,0 +1,390 @@
+#include "hash_backend.h"
+
+#include <string.h>
+#include "../lib/sphlib/sph_ripemd.h"
+
+static uint32_t hash_backend_rotr32(uint32_t x, uint8_t n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static uint64_t hash_backend_rotl64(uint64_t x, uint8_t n) {
+    return (x << n) | (x >> (64 - n));
+}
+
+static uint32_t hash_backend_le32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+static uint64_t hash_backend_le64(const uint8_t* in) {
+    return hash_backend_le32(in) | ((uint64_t)hash_backend_le32(in + 4) << 32);
+}
+
+/* RIPEMD-128, the original chain function */
+
+static const sph_u32 hash_backend_ripemd128_iv[4] = {
+    SPH_C32(0x67452301), SPH_C32(0xEFCDAB89), SPH_C32(0x98BADCFE), SPH_C32(0x10325476),
+};
+
+static void hash_backend_ripemd128(const uint8_t* in, size_t len, uint8_t* out) {
+    // chain steps take the single block kernels, only the seed goes the generic way
+    if(len == 10) {
+        sph_ripemd128_step10(in, hash_backend_ripemd128_iv, 0, out);
+        return;
+    }
+    if(len == 4) {
+        sph_ripemd128_step4(in, hash_backend_ripemd128_iv, 0, out);
+        return;
+    }
+    sph_ripemd128_context ctx;
+    sph_ripemd128_init(&ctx);
+    sph_ripemd128(&ctx, in, len);
+    sph_ripemd128_close(&ctx, out);
+}
+
+static void hash_backend_ripemd128_x(uint8_t* buffs, size_t len, size_t num) {
+    if(len == 10) {
+        sph_ripemd128_step10_x(buffs, hash_backend_ripemd128_iv, 0, num);
+        return;
+    }
+    if(len == 4) {
+        sph_ripemd128_step4_x(buffs, hash_backend_ripemd128_iv, 0, num);
+        return;
+    }
+    for(size_t i = 0; i < num; i++) {
+        hash_backend_ripemd128(&buffs[i * HASH_BACKEND_DIGEST_LEN], len, &buffs[i * HASH_BACKEND_DIGEST_LEN]);
+    }
+}
+
+/*
+ * Keyed RIPEMD-128: the digest of the site key block followed by the input. The key block
+ * is compressed once when the key is set, every digest then starts from that midstate, so
+ * a chain step costs the same single compression as an unkeyed one.
+ */
+
+static sph_u32 hash_backend_key_state[4];
+static uint8_t hash_backend_key_block[HASH_BACKEND_KEY_MAX];
+static bool hash_backend_keyed = false;
+
+void hash_backend_set_key(const uint8_t* key, size_t len) {
+    sph_u32 msg[16];
+    if(len > HASH_BACKEND_KEY_MAX) {
+        len = HASH_BACKEND_KEY_MAX;
+    }
+    memset(hash_backend_key_block, 0, sizeof(hash_backend_key_block));
+    memcpy(hash_backend_key_block, key, len);
+    for(uint8_t i = 0; i < 16; i++) {
+        msg[i] = hash_backend_le32(hash_backend_key_block + 4 * i);
+    }
+    memcpy(hash_backend_key_state, hash_backend_ripemd128_iv, sizeof(hash_backend_key_state));
+    sph_ripemd128_comp(msg, hash_backend_key_state);
+    hash_backend_keyed = len > 0;
+}
+
+bool hash_backend_has_key(void) {
+    return hash_backend_keyed;
+}
+
+static void hash_backend_ripemd128_keyed(const uint8_t* in, size_t len, uint8_t* out) {
+    if(len == 4) {
+        sph_ripemd128_step4(in, hash_backend_key_state, sizeof(hash_backend_key_block), out);
+        return;
+    }
+    if(len == 10) {
+        sph_ripemd128_step10(in, hash_backend_key_state, sizeof(hash_backend_key_block), out);
+        return;
+    }
+    // longer inputs don't fit a single padded block, hash the key block again the plain way
+    if(len > 55) {
+        sph_ripemd128_context ctx;
+        sph_ripemd128_init(&ctx);
+        sph_ripemd128(&ctx, hash_backend_key_block, sizeof(hash_backend_key_block));
+        sph_ripemd128(&ctx, in, len);
+        sph_ripemd128_close(&ctx, out);
+        return;
+    }
+
+    uint8_t block[64];
+    sph_u32 msg[16];
+    sph_u32 val[4];
+    uint64_t bits = (uint64_t)(sizeof(hash_backend_key_block) + len) * 8;
+    memset(block, 0, sizeof(block));
+    memcpy(block, in, len);
+    block[len] = 0x80;
+    for(uint8_t i = 0; i < 8; i++) {
+        block[56 + i] = bits >> (8 * i);
+    }
+    for(uint8_t i = 0; i < 16; i++) {
+        msg[i] = hash_backend_le32(block + 4 * i);
+    }
+    memcpy(val, hash_backend_key_state, sizeof(val));
+    sph_ripemd128_comp(msg, val);
+    for(uint8_t i = 0; i < HASH_BACKEND_DIGEST_LEN; i++) {
+        out[i] = val[i / 4] >> (8 * (i % 4));
+    }
+}
+
+static void hash_backend_ripemd128_keyed_x(uint8_t* buffs, size_t len, size_t num) {
+    if(len == 4) {
+        sph_ripemd128_step4_x(buffs, hash_backend_key_state, sizeof(hash_backend_key_block), num);
+        return;
+    }
+    if(len == 10) {
+        sph_ripemd128_step10_x(buffs, hash_backend_key_state, sizeof(hash_backend_key_block), num);
+        return;
+    }
+    for(size_t i = 0; i < num; i++) {
+        hash_backend_ripemd128_keyed(&buffs[i * HASH_BACKEND_DIGEST_LEN], len, &buffs[i * HASH_BACKEND_DIGEST_LEN]);
+    }
+}
+
+/*
+ * SipHash-2-4 with 128 bit output. It is a keyed PRF, unkeyed chains run it with an
+ * all zero key, where it makes no preimage resistance claims. Kept for comparison.
+ */
+
+#define SIPROUND                                  \
+    do {                                          \
+        v0 += v1;                                 \
+        v1 = hash_backend_rotl64(v1, 13);         \
+        v1 ^= v0;                                 \
+        v0 = hash_backend_rotl64(v0, 32);         \
+        v2 += v3;                                 \
+        v3 = hash_backend_rotl64(v3, 16);         \
+        v3 ^= v2;                                 \
+        v0 += v3;                                 \
+        v3 = hash_backend_rotl64(v3, 21);         \
+        v3 ^= v0;                                 \
+        v2 += v1;                                 \
+        v1 = hash_backend_rotl64(v1, 17);         \
+        v1 ^= v2;                                 \
+        v2 = hash_backend_rotl64(v2, 32);         \
+    } while(0)
+
+static void hash_backend_siphash24(const uint8_t* in, size_t len, uint8_t* out) {
+    static const uint8_t key[16] = {0};
+    uint64_t k0 = hash_backend_le64(key);
+    uint64_t k1 = hash_backend_le64(key + 8);
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1 ^ 0xee;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+    uint64_t m;
+    size_t i;
+
+    for(i = 0; i + 8 <= len; i += 8) {
+        m = hash_backend_le64(in + i);
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+    m = (uint64_t)len << 56;
+    for(size_t j = 0; i + j < len; j++) {
+        m |= (uint64_t)in[i + j] << (8 * j);
+    }
+    v3 ^= m;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= m;
+
+    v2 ^= 0xee;
+    for(i = 0; i < 4; i++) {
+        SIPROUND;
+    }
+    m = v0 ^ v1 ^ v2 ^ v3;
+    for(i = 0; i < 8; i++) {
+        out[i] = m >> (8 * i);
+    }
+    v1 ^= 0xdd;
+    for(i = 0; i < 4; i++) {
+        SIPROUND;
+    }
+    m = v0 ^ v1 ^ v2 ^ v3;
+    for(i = 0; i < 8; i++) {
+        out[8 + i] = m >> (8 * i);
+    }
+}
+
+#undef SIPROUND
+
+/* BLAKE2s with a 16 byte digest, unkeyed */
+
+static const uint32_t hash_backend_blake2s_iv[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+static const uint8_t hash_backend_blake2s_sigma[10][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+};
+
+#define BLAKE2S_G(a, b, c, d, x, y)                  \
+    do {                                             \
+        v[a] = v[a] + v[b] + (x);                    \
+        v[d] = hash_backend_rotr32(v[d] ^ v[a], 16); \
+        v[c] = v[c] + v[d];                          \
+        v[b] = hash_backend_rotr32(v[b] ^ v[c], 12); \
+        v[a] = v[a] + v[b] + (y);                    \
+        v[d] = hash_backend_rotr32(v[d] ^ v[a], 8);  \
+        v[c] = v[c] + v[d];                          \
+        v[b] = hash_backend_rotr32(v[b] ^ v[c], 7);  \
+    } while(0)
+
+static void hash_backend_blake2s_compress(uint32_t* h, const uint8_t* block, uint32_t counter, bool last) {
+    uint32_t m[16];
+    uint32_t v[16];
+    for(uint8_t i = 0; i < 16; i++) {
+        m[i] = hash_backend_le32(block + 4 * i);
+    }
+    memcpy(v, h, 8 * sizeof(uint32_t));
+    memcpy(v + 8, hash_backend_blake2s_iv, sizeof(hash_backend_blake2s_iv));
+    v[12] ^= counter;
+    if(last) {
+        v[14] = ~v[14];
+    }
+    for(uint8_t r = 0; r < 10; r++) {
+        const uint8_t* s = hash_backend_blake2s_sigma[r];
+        BLAKE2S_G(0, 4, 8, 12, m[s[0]], m[s[1]]);
+        BLAKE2S_G(1, 5, 9, 13, m[s[2]], m[s[3]]);
+        BLAKE2S_G(2, 6, 10, 14, m[s[4]], m[s[5]]);
+        BLAKE2S_G(3, 7, 11, 15, m[s[6]], m[s[7]]);
+        BLAKE2S_G(0, 5, 10, 15, m[s[8]], m[s[9]]);
+        BLAKE2S_G(1, 6, 11, 12, m[s[10]], m[s[11]]);
+        BLAKE2S_G(2, 7, 8, 13, m[s[12]], m[s[13]]);
+        BLAKE2S_G(3, 4, 9, 14, m[s[14]], m[s[15]]);
+    }
+    for(uint8_t i = 0; i < 8; i++) {
+        h[i] ^= v[i] ^ v[i + 8];
+    }
+}
+
+#undef BLAKE2S_G
+
+static void hash_backend_blake2s128(const uint8_t* in, size_t len, uint8_t* out) {
+    uint32_t h[8];
+    uint8_t block[64];
+    memcpy(h, hash_backend_blake2s_iv, sizeof(h));
+    h[0] ^= 0x01010000 ^ HASH_BACKEND_DIGEST_LEN;
+
+    // every block but the last one is full, an empty input still compresses one zero block
+    size_t done = 0;
+    while(len - done > 64) {
+        done += 64;
+        hash_backend_blake2s_compress(h, in + done - 64, done, false);
+    }
+    memset(block, 0, sizeof(block));
+    memcpy(block, in + done, len - done);
+    hash_backend_blake2s_compress(h, block, len, true);
+
+    for(uint8_t i = 0; i < HASH_BACKEND_DIGEST_LEN; i++) {
+        out[i] = h[i / 4] >> (8 * (i % 4));
+    }
+}
+
+/* SHA-256 truncated to its first 16 bytes */
+
+static const uint32_t hash_backend_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void hash_backend_sha256_compress(uint32_t* h, const uint8_t* block) {
+    uint32_t w[16];
+    uint32_t s[8];
+    for(uint8_t i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[4 * i] << 24) | (block[4 * i + 1] << 16) | (block[4 * i + 2] << 8) |
+               block[4 * i + 3];
+    }
+    memcpy(s, h, sizeof(s));
+    for(uint8_t i = 0; i < 64; i++) {
+        // the message schedule is kept as a rolling window of 16 words
+        if(i >= 16) {
+            uint32_t w15 = w[(i - 15) & 15];
+            uint32_t w2 = w[(i - 2) & 15];
+            w[i & 15] += (hash_backend_rotr32(w15, 7) ^ hash_backend_rotr32(w15, 18) ^ (w15 >> 3)) +
+                         w[(i - 7) & 15] +
+                         (hash_backend_rotr32(w2, 17) ^ hash_backend_rotr32(w2, 19) ^ (w2 >> 10));
+        }
+        uint32_t t1 = s[7] +
+                      (hash_backend_rotr32(s[4], 6) ^ hash_backend_rotr32(s[4], 11) ^
+                       hash_backend_rotr32(s[4], 25)) +
+                      ((s[4] & s[5]) ^ (~s[4] & s[6])) + hash_backend_sha256_k[i] + w[i & 15];
+        uint32_t t2 = (hash_backend_rotr32(s[0], 2) ^ hash_backend_rotr32(s[0], 13) ^
+                       hash_backend_rotr32(s[0], 22)) +
+                      ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+        memmove(s + 1, s, 7 * sizeof(uint32_t));
+        s[4] += t1;
+        s[0] = t1 + t2;
+    }
+    for(uint8_t i = 0; i < 8; i++) {
+        h[i] += s[i];
+    }
+}
+
+static void hash_backend_sha256_trunc(const uint8_t* in, size_t len, uint8_t* out) {
+    uint32_t h[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    uint8_t block[64];
+    size_t done = 0;
+    for(; len - done >= 64; done += 64) {
+        hash_backend_sha256_compress(h, in + done);
+    }
+
+    size_t rest = len - done;
+    memset(block, 0, sizeof(block));
+    memcpy(block, in + done, rest);
+    block[rest] = 0x80;
+    if(rest >= 56) {
+        hash_backend_sha256_compress(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    uint64_t bits = (uint64_t)len * 8;
+    for(uint8_t i = 0; i < 8; i++) {
+        block[63 - i] = bits >> (8 * i);
+    }
+    hash_backend_sha256_compress(h, block);
+
+    for(uint8_t i = 0; i < HASH_BACKEND_DIGEST_LEN; i++) {
+        out[i] = h[i / 4] >> (24 - 8 * (i % 4));
+    }
+}
+
+static const HashBackend hash_backends[HashBackendCount] = {
+    [HashBackendRipemd128] = {"RIPEMD-128", sizeof(sph_ripemd128_context), hash_backend_ripemd128, hash_backend_ripemd128_x},
+    [HashBackendSipHash24] = {"SipHash-2-4", 4 * sizeof(uint64_t), hash_backend_siphash24},
+    [HashBackendBlake2s128] = {"BLAKE2s-128", 32 * sizeof(uint32_t) + 64, hash_backend_blake2s128},
+    [HashBackendSha256Trunc] = {"SHA-256/128", 24 * sizeof(uint32_t) + 64, hash_backend_sha256_trunc},
+    [HashBackendRipemd128Keyed] = {"RIPEMD-128K", 20 * sizeof(sph_u32) + 64, hash_backend_ripemd128_keyed, hash_backend_ripemd128_keyed_x},
+};
+
+const HashBackend* hash_backend_get(uint8_t id) {
+    if(id == HashBackendRipemd128Keyed && !hash_backend_keyed) {
+        return NULL;
+    }
+    return id < HashBackendCount ? &hash_backends[id] : NULL;
+}
+
+void hash_backend_step_x(const HashBackend* hash, uint8_t* buffs, size_t len, size_t num) {
+    if(hash->step_x) {
+        hash->step_x(buffs, len, num);
+        return;
+    }
+    for(size_t i = 0; i < num; i++) {
+        hash->digest(&buffs[i * HASH_BACKEND_DIGEST_LEN], len, &buffs[i * HASH_BACKEND_DIGEST_LEN]);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// every backend gives at least this many digest bytes. A chain keeps the first 4 as the card
+// value and feeds the first 10 (4 in short step chains) into its next step
+#define HASH_BACKEND_DIGEST_LEN 16
+// longest site key, it has to fit the one block that is absorbed up front
+#define HASH_BACKEND_KEY_MAX 64
+
+// ids are stored in card records, never renumber them
+typedef enum {
+    HashBackendRipemd128 = 0,
+    HashBackendSipHash24 = 1,
+    HashBackendBlake2s128 = 2,
+    HashBackendSha256Trunc = 3,
+    HashBackendRipemd128Keyed = 4, // RIPEMD-128 over the site key block followed by the input
+    HashBackendCount,
+} HashBackendId;
+
+// backend newly generated chains use
+#ifndef HASH_BACKEND_DEFAULT
+#define HASH_BACKEND_DEFAULT HashBackendRipemd128
+#endif
+
+typedef struct {
+    const char* name;
+    size_t state_size; // bytes of hashing state on the stack per call
+    // writes HASH_BACKEND_DIGEST_LEN bytes of the digest of in to out
+    void (*digest)(const uint8_t* in, size_t len, uint8_t* out);
+    // optional, digest in place of each of num HASH_BACKEND_DIGEST_LEN byte buffers' first len
+    // bytes, several at once where the host has vector units. See hash_backend_step_x
+    void (*step_x)(uint8_t* buffs, size_t len, size_t num);
+} HashBackend;
+
+// returns NULL for an unknown id, and for the keyed backend while no site key is set
+const HashBackend* hash_backend_get(uint8_t id);
+
+// one chain step of num chains: each HASH_BACKEND_DIGEST_LEN byte buffer at buffs becomes the
+// digest of its first len bytes. Backends without step_x digest them one by one
+void hash_backend_step_x(const HashBackend* hash, uint8_t* buffs, size_t len, size_t num);
+
+// absorbs the site key (up to HASH_BACKEND_KEY_MAX bytes, zero padded to one block) into the
+// saved midstate of the keyed backend, a zero length clears it. Call before any hashing thread starts
+void hash_backend_set_key(const uint8_t* key, size_t len);
+
+// whether a site key is set
+bool hash_backend_has_key(void);
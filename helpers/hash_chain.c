@@ -0,0 +1,239 @@
+#include "hash_chain.h"
+
+#include <string.h>
+
+// the fields of a freshly generated chain, hash_bytes is filled in already
+static void hash_chain_generated(HashData* data, uint8_t backend, uint8_t flags, const uint8_t* seed, size_t seed_len) {
+    data->backend = backend;
+    data->chain_len = HASH_CHAIN_LEN;
+    data->curr_idx = 0;
+    data->seq = 0;
+    data->anchor = 0;
+    if (seed_len <= HASH_SEED_MAX) {
+        memcpy(data->seed, seed, seed_len);
+        data->seed_len = seed_len;
+        data->flags = flags | HashRecordFlagSeedOnly;
+    } else {
+        data->seed_len = 0;
+        data->flags = flags;
+    }
+}
+
+bool hash_chain_generate(HashData* data, uint8_t backend, uint8_t flags, const uint8_t* seed, size_t seed_len) {
+    const HashBackend* hash = hash_backend_get(backend);
+    if (!hash) {
+        return false;
+    }
+    flags &= HashRecordFlagShortStep;
+    size_t step_len = flags ? HASH_CHAIN_SHORT_STEP_LEN : HASH_CHAIN_STEP_LEN;
+    uint8_t buff[HASH_BACKEND_DIGEST_LEN];
+    hash->digest(seed, seed_len, buff);
+    for (int i = HASH_CHAIN_LEN - 1; i >= 0; i--) {
+        memcpy(&data->hash_bytes[i], buff, 4);
+        if (i > 0) {
+            hash->digest(buff, step_len, buff);
+        }
+    }
+    hash_chain_generated(data, backend, flags, seed, seed_len);
+    return true;
+}
+
+bool hash_chain_generate_batch(HashData* data, size_t count, uint8_t backend, uint8_t flags, const uint8_t* seeds, size_t seed_len) {
+    const HashBackend* hash = hash_backend_get(backend);
+    if (!hash) {
+        return false;
+    }
+    flags &= HashRecordFlagShortStep;
+    size_t step_len = flags ? HASH_CHAIN_SHORT_STEP_LEN : HASH_CHAIN_STEP_LEN;
+    uint8_t buffs[HASH_CHAIN_BATCH][HASH_BACKEND_DIGEST_LEN];
+    for (size_t first = 0; first < count; first += HASH_CHAIN_BATCH) {
+        size_t num = count - first < HASH_CHAIN_BATCH ? count - first : HASH_CHAIN_BATCH;
+        for (size_t n = 0; n < num; n++) {
+            hash->digest(&seeds[(first + n) * seed_len], seed_len, buffs[n]);
+        }
+        for (int i = HASH_CHAIN_LEN - 1; i >= 0; i--) {
+            for (size_t n = 0; n < num; n++) {
+                memcpy(&data[first + n].hash_bytes[i], buffs[n], 4);
+            }
+            if (i > 0) {
+                hash_backend_step_x(hash, buffs[0], step_len, num);
+            }
+        }
+    }
+    for (size_t n = 0; n < count; n++) {
+        hash_chain_generated(&data[n], backend, flags, &seeds[n * seed_len], seed_len);
+    }
+    return true;
+}
+
+bool hash_chain_to_verifier(HashData* data) {
+    const HashBackend* hash = hash_backend_get(data->backend);
+    if (!hash || !(data->flags & HashRecordFlagShortStep) || (data->flags & HashRecordFlagVerifier)) {
+        return false;
+    }
+    uint8_t buff[HASH_BACKEND_DIGEST_LEN];
+    hash->digest((const uint8_t*)&data->hash_bytes[data->curr_idx], HASH_CHAIN_SHORT_STEP_LEN, buff);
+    memcpy(&data->anchor, buff, 4);
+    data->flags = (data->flags & ~HashRecordFlagSeedOnly) | HashRecordFlagVerifier;
+    data->seed_len = 0;
+    memset(data->hash_bytes, 0, sizeof(data->hash_bytes));
+    return true;
+}
+
+uint8_t hash_chain_verify(HashData* data, const uint8_t* value) {
+    const HashBackend* hash = hash_backend_get(data->backend);
+    if (!hash || !(data->flags & HashRecordFlagVerifier)) {
+        return 0;
+    }
+    uint8_t buff[HASH_BACKEND_DIGEST_LEN];
+    memcpy(buff, value, 4);
+    // the value k steps ahead of the anchor sits at curr_idx + k - 1, which has to be on the chain
+    for (uint8_t k = 1; k <= HASH_VERIFY_RESYNC && data->curr_idx + k <= data->chain_len; k++) {
+        hash->digest(buff, HASH_CHAIN_SHORT_STEP_LEN, buff);
+        if (memcmp(buff, &data->anchor, 4) == 0) {
+            memcpy(&data->anchor, value, 4);
+            data->curr_idx += k;
+            return k;
+        }
+    }
+    return 0;
+}
+
+static void hash_record_put_u16(uint8_t* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void hash_record_put_u32(uint8_t* out, uint32_t value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = value >> 24;
+}
+
+static uint16_t hash_record_get_u16(const uint8_t* in) {
+    return in[0] | (in[1] << 8);
+}
+
+static uint32_t hash_record_get_u32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+size_t hash_record_encode(const HashData* data, uint8_t* out, size_t out_size) {
+    bool seed_only = data->flags & HashRecordFlagSeedOnly;
+    bool verifier = data->flags & HashRecordFlagVerifier;
+    size_t size = HASH_RECORD_HEADER_SIZE;
+    if (verifier) {
+        size = HASH_RECORD_VERIFIER_SIZE;
+    } else {
+        size += seed_only ? data->seed_len : 4 * (data->chain_len - data->curr_idx);
+    }
+    if (size > out_size) {
+        return 0;
+    }
+
+    out[0] = HASH_RECORD_VERSION;
+    out[1] = (data->flags & HASH_RECORD_FLAG_MASK) | (data->backend << HASH_RECORD_BACKEND_SHIFT);
+    out[2] = data->card_id;
+    out[3] = seed_only && !verifier ? data->seed_len : 0;
+    hash_record_put_u16(&out[4], data->chain_len);
+    hash_record_put_u16(&out[6], data->curr_idx);
+    if (verifier) {
+        hash_record_put_u32(&out[HASH_RECORD_HEADER_SIZE], data->anchor);
+    } else if (seed_only) {
+        memcpy(&out[HASH_RECORD_HEADER_SIZE], data->seed, data->seed_len);
+    } else {
+        for (uint16_t i = data->curr_idx; i < data->chain_len; i++) {
+            hash_record_put_u32(&out[HASH_RECORD_HEADER_SIZE + 4 * (i - data->curr_idx)], data->hash_bytes[i]);
+        }
+    }
+    return size;
+}
+
+bool hash_record_decode(HashData* data, const uint8_t* in, size_t len) {
+    if (len < HASH_RECORD_HEADER_SIZE || in[0] != HASH_RECORD_VERSION) {
+        return false;
+    }
+    uint8_t flags = in[1] & HASH_RECORD_FLAG_MASK;
+    uint8_t backend = in[1] >> HASH_RECORD_BACKEND_SHIFT;
+    uint8_t seed_len = in[3];
+    uint16_t chain_len = hash_record_get_u16(&in[4]);
+    uint16_t curr_idx = hash_record_get_u16(&in[6]);
+    if (chain_len > HASH_CHAIN_MAX || curr_idx > chain_len) {
+        return false;
+    }
+
+    if (flags & HashRecordFlagVerifier) {
+        // a verifier is used up once curr_idx reaches chain_len, every other record needs a value left
+        if (len != HASH_RECORD_VERIFIER_SIZE || (flags & HashRecordFlagSeedOnly)) {
+            return false;
+        }
+        memset(data->hash_bytes, 0, sizeof(data->hash_bytes));
+        data->anchor = hash_record_get_u32(&in[HASH_RECORD_HEADER_SIZE]);
+        data->seed_len = 0;
+        data->backend = backend;
+    } else if (curr_idx == chain_len) {
+        return false;
+    } else if (flags & HashRecordFlagSeedOnly) {
+        if (seed_len == 0 || seed_len > HASH_SEED_MAX || len != HASH_RECORD_HEADER_SIZE + (size_t)seed_len ||
+            chain_len != HASH_CHAIN_LEN) {
+            return false;
+        }
+        if (!hash_chain_generate(data, backend, flags, &in[HASH_RECORD_HEADER_SIZE], seed_len)) {
+            return false;
+        }
+    } else {
+        if (len != HASH_RECORD_HEADER_SIZE + 4 * (size_t)(chain_len - curr_idx)) {
+            return false;
+        }
+        memset(data->hash_bytes, 0, sizeof(data->hash_bytes));
+        for (uint16_t i = curr_idx; i < chain_len; i++) {
+            data->hash_bytes[i] = hash_record_get_u32(&in[HASH_RECORD_HEADER_SIZE + 4 * (i - curr_idx)]);
+        }
+        data->seed_len = 0;
+        data->backend = backend;
+    }
+    data->flags = flags;
+    data->card_id = in[2];
+    data->chain_len = chain_len;
+    data->curr_idx = curr_idx;
+    return true;
+}
+
+uint32_t hash_record_crc_update(uint32_t crc, const uint8_t* in, size_t len) {
+    // CRC-32 (0xEDB88320), a nibble at a time to keep the table small
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    for (size_t i = 0; i < len; i++) {
+        crc ^= in[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return crc;
+}
+
+uint32_t hash_record_crc(uint32_t seq, const uint8_t* record, size_t len) {
+    uint8_t seq_bytes[4];
+    hash_record_put_u32(seq_bytes, seq);
+    uint32_t crc = hash_record_crc_update(0xFFFFFFFF, seq_bytes, sizeof(seq_bytes));
+    return ~hash_record_crc_update(crc, record, len);
+}
+
+bool hash_record_decode_v1(HashData* data, const uint8_t* in, size_t len) {
+    if (len != HASH_RECORD_V1_SIZE || in[1] >= 100) {
+        return false;
+    }
+    data->card_id = in[0];
+    data->curr_idx = in[1];
+    data->chain_len = 100;
+    data->flags = 0;
+    data->seed_len = 0;
+    data->backend = HashBackendRipemd128;
+    data->anchor = 0;
+    for (uint16_t i = 0; i < 100; i++) {
+        data->hash_bytes[i] = hash_record_get_u32(&in[4 + 4 * i]);
+    }
+    return true;
+}
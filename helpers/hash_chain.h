@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hash_backend.h"
+
+// number of values in a newly generated hash chain
+#define HASH_CHAIN_LEN 100
+// most values a chain can have in memory
+#define HASH_CHAIN_MAX 100
+// longest seed a record can keep for regenerating its chain
+#define HASH_SEED_MAX 20
+// bytes of the previous digest fed into each step: sizeof(DateTime) on the device (five u8
+// fields, u16 year, u8 weekday, padded), which the original chain code hashed per step
+#define HASH_CHAIN_STEP_LEN 10
+// bytes fed into each step of a short step chain, the value the card holds
+#define HASH_CHAIN_SHORT_STEP_LEN 4
+// chains hash_chain_generate_batch steps together, a multiple of every SPH_RIPEMD128_LANES
+#define HASH_CHAIN_BATCH 16
+// most chain steps a verifier walks to catch up with a card that was advanced elsewhere
+#define HASH_VERIFY_RESYNC 8
+
+typedef enum {
+    HashRecordFlagSeedOnly = (1 << 0), // record stores the seed, values are regenerated on load
+    HashRecordFlagRevoked = (1 << 1), // card was revoked, its files are waiting to be removed
+    HashRecordFlagShortStep = (1 << 2), // every step hashes the previous 4 byte value, so a verifier can walk it
+    HashRecordFlagVerifier = (1 << 3), // record keeps only the anchor, see hash_chain_verify
+} HashRecordFlag;
+
+// the record's flags byte keeps the HashRecordFlag bits low and the HashBackendId in the high nibble
+#define HASH_RECORD_FLAG_MASK 0x0F
+#define HASH_RECORD_BACKEND_SHIFT 4
+
+// a card's chain in memory, records on storage use the explicit layout below
+typedef struct {
+    uint8_t card_id;
+    uint8_t flags; // HashRecordFlag
+    uint16_t chain_len; // values in hash_bytes
+    uint16_t curr_idx; // value the card currently holds
+    uint8_t seed_len; // 0 if the chain has no stored seed
+    uint8_t backend; // HashBackendId the chain was generated with
+    uint8_t seed[HASH_SEED_MAX];
+    uint32_t seq; // generation of the stored record, not part of it
+    uint32_t anchor; // verifier records: the value before curr_idx, hash_bytes is unused
+    uint32_t hash_bytes[HASH_CHAIN_MAX];
+} HashData;
+
+/*
+ * Record layout, all fields little-endian:
+ *   0  u8   version (HASH_RECORD_VERSION)
+ *   1  u8   flags, backend id in the high nibble (0, RIPEMD-128, for records from before backends)
+ *   2  u8   card_id
+ *   3  u8   seed_len
+ *   4  u16  chain_len
+ *   6  u16  curr_idx
+ *   8  seed[seed_len]                      with HashRecordFlagSeedOnly
+ *      u32 anchor                          with HashRecordFlagVerifier
+ *      u32 hash_bytes[curr_idx..chain_len) otherwise, used up values are dropped
+ */
+#define HASH_RECORD_VERSION 2
+#define HASH_RECORD_HEADER_SIZE 8
+#define HASH_RECORD_VERIFIER_SIZE (HASH_RECORD_HEADER_SIZE + 4)
+#define HASH_RECORD_MAX_SIZE (HASH_RECORD_HEADER_SIZE + 4 * HASH_CHAIN_MAX)
+// raw struct dump written by version 1: card_id, curr_idx, 2 padding bytes, 100 values
+#define HASH_RECORD_V1_SIZE 404
+
+// fill hash array with keys, with first generated key at end
+// the seed is hashed once, every later step hashes the first 10 bytes of the previous digest,
+// or only the 4 byte value with HashRecordFlagShortStep in flags
+// a seed of up to HASH_SEED_MAX bytes is kept so the record can be stored seed only
+// returns false for an unknown backend
+bool hash_chain_generate(HashData* data, uint8_t backend, uint8_t flags, const uint8_t* seed, size_t seed_len);
+
+// hash_chain_generate for count chains, data[n] from the seed_len bytes at seeds + n * seed_len.
+// The chains are stepped HASH_CHAIN_BATCH at a time, which vectorizes on hosts provisioning
+// many cards; the device generates one chain per card
+bool hash_chain_generate_batch(HashData* data, size_t count, uint8_t backend, uint8_t flags, const uint8_t* seeds, size_t seed_len);
+
+// turns a short step chain into a verifier record that only keeps the hash of the current value
+// returns false for chains a verifier can't walk
+bool hash_chain_to_verifier(HashData* data);
+
+// checks a value presented by the card against a verifier record: it is accepted if 1 to
+// HASH_VERIFY_RESYNC hash steps lead to the anchor. The anchor then moves to the value
+// returns the number of steps, 0 if the value is rejected (replayed, stale or unknown)
+uint8_t hash_chain_verify(HashData* data, const uint8_t* value);
+
+// serializes data into out, returns the record size or 0 if out is too small
+size_t hash_record_encode(const HashData* data, uint8_t* out, size_t out_size);
+
+// parses a record, regenerating the chain of seed only records
+// returns false if the record is malformed or from an unknown version
+bool hash_record_decode(HashData* data, const uint8_t* in, size_t len);
+
+// running CRC-32 (zlib polynomial), start from 0xFFFFFFFF and invert the final value
+uint32_t hash_record_crc_update(uint32_t crc, const uint8_t* in, size_t len);
+
+// CRC-32 over the record and the sequence number of the slot it is stored in
+uint32_t hash_record_crc(uint32_t seq, const uint8_t* record, size_t len);
+
+// parses the version 1 raw struct dump
+bool hash_record_decode_v1(HashData* data, const uint8_t* in, size_t len);
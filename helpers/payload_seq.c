@@ -0,0 +1,52 @@
+#include "payload_seq.h"
+
+#include <string.h>
+#include "hash_backend.h"
+
+void payload_seq_get(
+    PayloadSeqMode mode,
+    const uint8_t* base,
+    size_t len,
+    uint32_t step,
+    uint32_t k,
+    uint8_t* out) {
+    uint64_t delta = (uint64_t)k * step;
+    uint16_t carry = 0;
+
+    switch(mode) {
+    case PayloadSeqAdd:
+        // byte by byte from the least significant end, delta runs out after 8 bytes
+        for(size_t i = len; i-- > 0;) {
+            carry += base[i] + (delta & 0xFF);
+            out[i] = carry & 0xFF;
+            carry >>= 8;
+            delta >>= 8;
+        }
+        break;
+    case PayloadSeqXor:
+        for(size_t i = len; i-- > 0;) {
+            out[i] = base[i] ^ (delta & 0xFF);
+            delta >>= 8;
+        }
+        break;
+    case PayloadSeqHash: {
+        uint8_t in[PAYLOAD_SEQ_MAX_LEN + 4];
+        uint8_t digest[HASH_BACKEND_DIGEST_LEN];
+        memcpy(in, base, len);
+        for(uint8_t i = 0; i < 4; i++) {
+            in[len + i] = k >> (8 * i);
+        }
+        hash_backend_get(HashBackendRipemd128)->digest(in, len + 4, digest);
+        memcpy(out, digest, len);
+        break;
+    }
+    default:
+        memcpy(out, base, len);
+        break;
+    }
+}
+
+const char* payload_seq_mode_name(PayloadSeqMode mode) {
+    static const char* const names[PayloadSeqCount] = {"base + k*step", "base ^ k*step", "hash(base, k)"};
+    return mode < PayloadSeqCount ? names[mode] : "?";
+}
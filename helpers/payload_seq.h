@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// longest payload a sequence works on, the HID generic data size
+#define PAYLOAD_SEQ_MAX_LEN 8
+
+// how the k-th payload of a sequence is derived from the base payload
+typedef enum {
+    PayloadSeqAdd, // base + k * step
+    PayloadSeqXor, // base ^ (k * step)
+    PayloadSeqHash, // digest of base and k, for ids that shouldn't be guessable from each other
+    PayloadSeqCount,
+} PayloadSeqMode;
+
+/*
+ * Payloads are treated as one big-endian number of len bytes, the way readers print
+ * them, so the last byte is the least significant. Add wraps at len bytes.
+ * Writes the k-th payload of the sequence starting at base to out.
+ */
+void payload_seq_get(
+    PayloadSeqMode mode,
+    const uint8_t* base,
+    size_t len,
+    uint32_t step,
+    uint32_t k,
+    uint8_t* out);
+
+const char* payload_seq_mode_name(PayloadSeqMode mode);
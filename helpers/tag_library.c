@@ -0,0 +1,92 @@
+#include "tag_library.h"
+
+#include <furi.h>
+#include <lib/lfrfid/lfrfid_dict_file.h>
+
+#define TAG_LIBRARY_PATH_LEN 48
+
+static void tag_library_path(const TagLibrary* library, char* path, size_t size, uint8_t slot) {
+    snprintf(path, size, "%s/" TAG_LIBRARY_DIR "/%u.rfid", library->data_dir, slot);
+}
+
+// reads the data the dict holds for the tag's protocol back into it
+static void tag_library_get_data(SavedTag* tag, ProtocolDict* dict) {
+    size_t size = protocol_dict_get_data_size(dict, tag->protocol);
+    tag->data_size = size > TAG_LIBRARY_DATA_MAX ? TAG_LIBRARY_DATA_MAX : size;
+    memset(tag->data, 0, sizeof(tag->data));
+    protocol_dict_get_data(dict, tag->protocol, tag->data, tag->data_size);
+}
+
+void tag_library_load(TagLibrary* library, Storage* storage, ProtocolDict* dict, const char* data_dir) {
+    library->count = 0;
+    library->data_dir = data_dir;
+    char path[TAG_LIBRARY_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/" TAG_LIBRARY_DIR, data_dir);
+    storage_simply_mkdir(storage, path);
+
+    for(uint8_t slot = 0; slot < TAG_LIBRARY_SLOTS; slot++) {
+        tag_library_path(library, path, sizeof(path), slot);
+        if(!storage_file_exists(storage, path)) continue;
+        ProtocolId protocol = lfrfid_dict_file_load(dict, path);
+        if(protocol == PROTOCOL_NO) continue;
+
+        SavedTag* tag = &library->tags[library->count++];
+        tag->protocol = protocol;
+        tag->slot = slot;
+        tag_library_get_data(tag, dict);
+    }
+}
+
+int8_t tag_library_add(
+    TagLibrary* library,
+    ProtocolDict* dict,
+    ProtocolId protocol,
+    const uint8_t* data,
+    size_t data_size) {
+    if(library->count >= TAG_LIBRARY_SLOTS) return -1;
+    // a cut off payload would be saved as a different badge
+    if(data_size > TAG_LIBRARY_DATA_MAX || data_size != protocol_dict_get_data_size(dict, protocol)) {
+        return -1;
+    }
+
+    // tags are kept in slot order, so the first gap in the slot numbers is the free slot
+    uint8_t index = 0;
+    while(index < library->count && library->tags[index].slot == index) {
+        index++;
+    }
+
+    char path[TAG_LIBRARY_PATH_LEN];
+    tag_library_path(library, path, sizeof(path), index);
+    protocol_dict_set_data(dict, protocol, data, data_size);
+    if(!lfrfid_dict_file_save(dict, protocol, path)) return -1;
+
+    memmove(
+        &library->tags[index + 1],
+        &library->tags[index],
+        sizeof(SavedTag) * (library->count - index));
+    library->count++;
+    SavedTag* tag = &library->tags[index];
+    tag->protocol = protocol;
+    tag->slot = index;
+    tag_library_get_data(tag, dict);
+    return index;
+}
+
+bool tag_library_remove(TagLibrary* library, Storage* storage, uint8_t index) {
+    if(index >= library->count) return false;
+
+    char path[TAG_LIBRARY_PATH_LEN];
+    tag_library_path(library, path, sizeof(path), library->tags[index].slot);
+    if(storage_common_remove(storage, path) != FSE_OK) return false;
+
+    library->count--;
+    memmove(
+        &library->tags[index],
+        &library->tags[index + 1],
+        sizeof(SavedTag) * (library->count - index));
+    return true;
+}
+
+void tag_library_set_data(const SavedTag* tag, ProtocolDict* dict) {
+    protocol_dict_set_data(dict, tag->protocol, tag->data, tag->data_size);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <storage/storage.h>
+#include <lib/lfrfid/lfrfid_worker.h>
+
+// one .rfid file per saved tag, in the format of the stock RFID app, in this folder of the
+// app's data directory
+#define TAG_LIBRARY_DIR "tags"
+#define TAG_LIBRARY_SLOTS 8
+#define TAG_LIBRARY_DATA_MAX 8
+
+typedef struct {
+    ProtocolId protocol;
+    uint8_t slot; // file number, stays the same when other tags are removed
+    uint8_t data_size;
+    uint8_t data[TAG_LIBRARY_DATA_MAX];
+} SavedTag;
+
+// saved tags in slot order
+typedef struct {
+    SavedTag tags[TAG_LIBRARY_SLOTS];
+    uint8_t count;
+    const char* data_dir; // the tag files are in its TAG_LIBRARY_DIR, set by tag_library_load
+} TagLibrary;
+
+// loads every saved tag, files that don't parse are skipped
+void tag_library_load(TagLibrary* library, Storage* storage, ProtocolDict* dict, const char* data_dir);
+
+// saves a tag in the first free slot
+// returns its index in tags, or -1 if the library is full, data_size isn't the protocol's
+// whole payload (or more than TAG_LIBRARY_DATA_MAX) or the file couldn't be written
+int8_t tag_library_add(
+    TagLibrary* library,
+    ProtocolDict* dict,
+    ProtocolId protocol,
+    const uint8_t* data,
+    size_t data_size);
+
+// deletes the tag at index, the tags after it move up by one
+bool tag_library_remove(TagLibrary* library, Storage* storage, uint8_t index);
+
+// sets the tag's data in dict, ready to encode
+void tag_library_set_data(const SavedTag* tag, ProtocolDict* dict);
@@ -0,0 +1,58 @@
+#include "virtual_list.h"
+
+#include <gui/elements.h>
+
+void virtual_list_init(VirtualList* list, uint16_t count, uint8_t rows) {
+    list->count = count;
+    list->selected = 0;
+    list->top = 0;
+    list->rows = rows;
+}
+
+bool virtual_list_move(VirtualList* list, int16_t step) {
+    if(list->count == 0) {
+        return false;
+    }
+    int32_t selected = list->selected + step;
+    if(selected < 0) {
+        selected = 0;
+    } else if(selected >= list->count) {
+        selected = list->count - 1;
+    }
+    if(selected == list->selected) {
+        return false;
+    }
+    list->selected = selected;
+
+    if(list->selected < list->top) {
+        list->top = list->selected;
+    } else if(list->selected >= list->top + list->rows) {
+        list->top = list->selected - list->rows + 1;
+    }
+    return true;
+}
+
+void virtual_list_draw(
+    const VirtualList* list,
+    Canvas* canvas,
+    int32_t y,
+    uint8_t row_height,
+    VirtualListDrawItem draw_item,
+    void* context) {
+    for(uint8_t row = 0; row < list->rows && list->top + row < list->count; row++) {
+        draw_item(canvas, list->top + row, y + row_height * row, context);
+    }
+    if(list->count == 0) {
+        return;
+    }
+    canvas_draw_str(canvas, 2, y + row_height * (list->selected - list->top), ">");
+    if(list->count > list->rows) {
+        elements_scrollbar_pos(
+            canvas,
+            canvas_width(canvas),
+            y - row_height + 2,
+            row_height * list->rows,
+            list->selected,
+            list->count);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <gui/canvas.h>
+
+/*
+ * Cursor and scroll position of a list that only knows its length. Items are drawn
+ * through a callback for the visible rows only, so the cost of moving and drawing
+ * doesn't depend on how many items there are.
+ */
+typedef struct {
+    uint16_t count; // items in the list
+    uint16_t selected;
+    uint16_t top; // first visible item
+    uint8_t rows; // items that fit on screen
+} VirtualList;
+
+// draws item at the baseline y
+typedef void (*VirtualListDrawItem)(Canvas* canvas, uint16_t item, int32_t y, void* context);
+
+void virtual_list_init(VirtualList* list, uint16_t count, uint8_t rows);
+
+// moves the selection by step items, stopping at either end, and scrolls it into view
+// returns false if the selection didn't change
+bool virtual_list_move(VirtualList* list, int16_t step);
+
+// draws the visible items from y on, the cursor and a scrollbar at the right edge
+void virtual_list_draw(
+    const VirtualList* list,
+    Canvas* canvas,
+    int32_t y,
+    uint8_t row_height,
+    VirtualListDrawItem draw_item,
+    void* context);
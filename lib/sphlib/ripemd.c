@@ -591,6 +591,12 @@ sph_ripemd_comp(const sph_u32 msg[16], sph_u32 val[4])
 #define sROUND2(a, b, c, d, f, s, r, k)  \
 	sRR(a ## 2, b ## 2, c ## 2, d ## 2, f, s, r, sK2 ## k)
 
+/*
+ * Type of the working variables in RIPEMD128_ROUND_BODY; the multi-lane
+ * code below runs the same body on vectors of words.
+ */
+#define RIPEMD128_WORD   sph_u32
+
 /*
  * This macro defines the body for a RIPEMD-128 compression function
  * implementation. The "in" parameter should evaluate, when applied to a
@@ -601,9 +607,9 @@ sph_ripemd_comp(const sph_u32 msg[16], sph_u32 val[4])
  */
 
 #define RIPEMD128_ROUND_BODY(in, h)   do { \
-		sph_u32 A1, B1, C1, D1; \
-		sph_u32 A2, B2, C2, D2; \
-		sph_u32 tmp; \
+		RIPEMD128_WORD A1, B1, C1, D1; \
+		RIPEMD128_WORD A2, B2, C2, D2; \
+		RIPEMD128_WORD tmp; \
  \
 		A1 = A2 = (h)[0]; \
 		B1 = B2 = (h)[1]; \
@@ -1095,6 +1101,182 @@ sph_ripemd128_comp(const sph_u32 msg[16], sph_u32 val[4])
 #undef RIPEMD128_IN
 }
 
+#if SPH_RIPEMD128_LANES > 1
+
+/*
+ * SPH_RIPEMD128_LANES independent compressions in lockstep. Each lane
+ * of a vector holds the same word of a different message; GCC vector
+ * extensions turn the scalar round body into AVX2 or SSE2 code.
+ */
+typedef sph_u32 ripemd128_vec
+	__attribute__ ((vector_size (4 * SPH_RIPEMD128_LANES)));
+
+#undef RIPEMD128_WORD
+#define RIPEMD128_WORD   ripemd128_vec
+
+static void
+ripemd128_comp_lanes(const sph_u32 (*msg)[16], sph_u32 (*val)[4])
+{
+	ripemd128_vec w[16], h[4];
+	int i, l;
+
+	for (i = 0; i < 16; i ++)
+		for (l = 0; l < SPH_RIPEMD128_LANES; l ++)
+			w[i][l] = msg[l][i];
+	for (i = 0; i < 4; i ++)
+		for (l = 0; l < SPH_RIPEMD128_LANES; l ++)
+			h[i][l] = val[l][i];
+#define RIPEMD128_IN(x)   w[x]
+	RIPEMD128_ROUND_BODY(RIPEMD128_IN, h);
+#undef RIPEMD128_IN
+	for (i = 0; i < 4; i ++)
+		for (l = 0; l < SPH_RIPEMD128_LANES; l ++)
+			val[l][i] = h[i][l];
+}
+
+/*
+ * The multi-lane counterpart of ripemd128_step() below: steps the
+ * SPH_RIPEMD128_LANES 16 byte buffers at buf in place, each to the digest
+ * of its first len bytes after val. The constant words fold the same way.
+ */
+#if defined __GNUC__
+__attribute__ ((always_inline))
+#endif
+static SPH_INLINE void
+ripemd128_step_lanes(unsigned char *buf, size_t len,
+	const sph_u32 val[4], sph_u32 prefix)
+{
+	union {
+		sph_u32 w[4];
+		unsigned char b[16];
+	} u;
+	ripemd128_vec w[4], h[4];
+	const ripemd128_vec zero = { 0 };
+	const ripemd128_vec bits = zero + ((prefix + (sph_u32)len) << 3);
+	int i, l;
+
+	for (l = 0; l < SPH_RIPEMD128_LANES; l ++) {
+		memset(&u, 0, sizeof u);
+		memcpy(u.b, buf + 16 * l, len);
+		u.b[len] = 0x80;
+		for (i = 0; i < 4; i ++)
+			w[i][l] = sph_dec32le_aligned(u.b + 4 * i);
+	}
+	for (i = 0; i < 4; i ++)
+		h[i] = zero + val[i];
+#define RIPEMD128_IN(x)   ((x) < 4 ? w[(x) & 3] \
+	: (x) == 14 ? bits : zero)
+	RIPEMD128_ROUND_BODY(RIPEMD128_IN, h);
+#undef RIPEMD128_IN
+	for (l = 0; l < SPH_RIPEMD128_LANES; l ++)
+		for (i = 0; i < 4; i ++)
+			sph_enc32le(buf + 16 * l + 4 * i, h[i][l]);
+}
+
+#undef RIPEMD128_WORD
+#define RIPEMD128_WORD   sph_u32
+
+#endif
+
+/* see sph_ripemd.h */
+void
+sph_ripemd128_comp_x(const sph_u32 (*msg)[16], sph_u32 (*val)[4], size_t num)
+{
+	size_t n = 0;
+
+#if SPH_RIPEMD128_LANES > 1
+	for (; n + SPH_RIPEMD128_LANES <= num; n += SPH_RIPEMD128_LANES)
+		ripemd128_comp_lanes(msg + n, val + n);
+#endif
+	for (; n < num; n ++)
+		sph_ripemd128_comp(msg[n], val[n]);
+}
+
+/*
+ * Single final block of a RIPEMD-128 message: the len (at most 15) bytes
+ * at data, after val has absorbed prefix bytes (whole blocks) before them.
+ * Words 4 to 15 of the block are zeros and the bit length; with a constant
+ * len the padding byte lands in a known word too, so every constant word
+ * folds into the round additions and each caller below gets its own body
+ * with only the data words live next to the two lines.
+ */
+#if defined __GNUC__
+__attribute__ ((always_inline))
+#endif
+static SPH_INLINE void
+ripemd128_step(const unsigned char *data, size_t len,
+	const sph_u32 val[4], sph_u32 prefix, unsigned char *dst)
+{
+	union {
+		sph_u32 w[4];
+		unsigned char b[16];
+	} u;
+	sph_u32 w[4], h[4];
+	sph_u32 bits = (prefix + (sph_u32)len) << 3;
+	int i;
+
+	memset(&u, 0, sizeof u);
+	memcpy(u.b, data, len);
+	u.b[len] = 0x80;
+	for (i = 0; i < 4; i ++)
+		w[i] = sph_dec32le_aligned(u.b + 4 * i);
+	memcpy(h, val, sizeof h);
+#define RIPEMD128_IN(x)   ((x) < 4 ? w[(x) & 3] \
+	: (x) == 14 ? bits : SPH_C32(0))
+	RIPEMD128_ROUND_BODY(RIPEMD128_IN, h);
+#undef RIPEMD128_IN
+	for (i = 0; i < 4; i ++)
+		sph_enc32le(dst + 4 * i, h[i]);
+}
+
+/* see sph_ripemd.h */
+void
+sph_ripemd128_step10(const void *data, const sph_u32 val[4],
+	sph_u32 prefix, void *dst)
+{
+	ripemd128_step(data, 10, val, prefix, dst);
+}
+
+/* see sph_ripemd.h */
+void
+sph_ripemd128_step4(const void *data, const sph_u32 val[4],
+	sph_u32 prefix, void *dst)
+{
+	ripemd128_step(data, 4, val, prefix, dst);
+}
+
+/* see sph_ripemd.h */
+void
+sph_ripemd128_step10_x(void *buf, const sph_u32 val[4],
+	sph_u32 prefix, size_t num)
+{
+	unsigned char *b = buf;
+	size_t n = 0;
+
+#if SPH_RIPEMD128_LANES > 1
+	for (; n + SPH_RIPEMD128_LANES <= num; n += SPH_RIPEMD128_LANES)
+		ripemd128_step_lanes(b + 16 * n, 10, val, prefix);
+#endif
+	for (; n < num; n ++)
+		sph_ripemd128_step10(b + 16 * n, val, prefix, b + 16 * n);
+}
+
+/* see sph_ripemd.h */
+void
+sph_ripemd128_step4_x(void *buf, const sph_u32 val[4],
+	sph_u32 prefix, size_t num)
+{
+	unsigned char *b = buf;
+	size_t n = 0;
+
+#if SPH_RIPEMD128_LANES > 1
+	for (; n + SPH_RIPEMD128_LANES <= num; n += SPH_RIPEMD128_LANES)
+		ripemd128_step_lanes(b + 16 * n, 4, val, prefix);
+#endif
+	for (; n < num; n ++)
+		sph_ripemd128_step4(b + 16 * n, val, prefix, b + 16 * n);
+}
+
 #pragma GCC diagnostic pop
 // /* ===================================================================== */
 // /*
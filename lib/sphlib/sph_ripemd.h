@@ -204,6 +204,73 @@ void sph_ripemd128_close(void *cc, void *dst);
  */
 void sph_ripemd128_comp(const sph_u32 msg[16], sph_u32 val[4]);
 
+/*
+ * Number of messages the multi-buffer functions below hash in lockstep:
+ * 8 with AVX2, 4 with SSE2, 1 (plain loop over the scalar code) otherwise.
+ * Batches that are a multiple of it avoid the scalar tail. Defining it to
+ * 1 builds the scalar loops on any host.
+ */
+#if defined SPH_RIPEMD128_LANES
+#elif defined __GNUC__ && defined __AVX2__
+#define SPH_RIPEMD128_LANES   8
+#elif defined __GNUC__ && defined __SSE2__
+#define SPH_RIPEMD128_LANES   4
+#else
+#define SPH_RIPEMD128_LANES   1
+#endif
+
+/**
+ * Apply the RIPEMD-128 compression function to <code>num</code>
+ * independent (message block, state) pairs; <code>msg[i]</code> and
+ * <code>val[i]</code> are as for <code>sph_ripemd128_comp()</code>.
+ *
+ * @param msg   the message blocks
+ * @param val   the states, updated in place
+ * @param num   the number of pairs
+ */
+void sph_ripemd128_comp_x(const sph_u32 (*msg)[16], sph_u32 (*val)[4], size_t num);
+
+/**
+ * Chain step kernels: write to <code>dst</code> (16 bytes) the RIPEMD-128
+ * digest of a message that ends with the 10 (or 4) bytes at
+ * <code>data</code> (no alignment required), where <code>val</code> is
+ * the state after the <code>prefix</code> bytes before them, a multiple of
+ * 64. With the standard IV and a prefix of 0 this is the plain digest of
+ * the 10 bytes; with a midstate it finishes a keyed hash. The message is
+ * hashed as one block whose padding words are constants, see ripemd.c.
+ *
+ * @param data     the last 10 (or 4) bytes of the message
+ * @param val      the state before them (not modified)
+ * @param prefix   the message bytes absorbed into val
+ * @param dst      the destination buffer
+ */
+void sph_ripemd128_step10(const void *data, const sph_u32 val[4],
+	sph_u32 prefix, void *dst);
+
+/** See <code>sph_ripemd128_step10()</code>. */
+void sph_ripemd128_step4(const void *data, const sph_u32 val[4],
+	sph_u32 prefix, void *dst);
+
+/**
+ * Chain steps of <code>num</code> chains at once: each of the
+ * <code>num</code> 16 byte buffers stored back to back at <code>buf</code>
+ * is replaced by the digest of its first 10 (or 4) bytes, as
+ * <code>sph_ripemd128_step10()</code> computes it from <code>val</code>
+ * and <code>prefix</code>. SPH_RIPEMD128_LANES buffers are stepped in
+ * lockstep, the rest one at a time.
+ *
+ * @param buf      the buffers (16 * num bytes), updated in place
+ * @param val      the state before every message (not modified)
+ * @param prefix   the message bytes absorbed into val
+ * @param num      the number of buffers
+ */
+void sph_ripemd128_step10_x(void *buf, const sph_u32 val[4],
+	sph_u32 prefix, size_t num);
+
+/** See <code>sph_ripemd128_step10_x()</code>. */
+void sph_ripemd128_step4_x(void *buf, const sph_u32 val[4],
+	sph_u32 prefix, size_t num);
+
 /* ===================================================================== */ 
 
 /**
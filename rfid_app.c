@@ -4,12 +4,25 @@
 
 #include <lib/lfrfid/lfrfid_dict_file.h>
 #include <lib/lfrfid/lfrfid_worker.h>
+#include <lib/lfrfid/tools/t5577.h>
 
 #include "lib/worker/helpers/hardware_worker.h"
 
 // #include <lfrfid/protocols/lfrfid_protocols.h>  <- this works but not the one below
 // #include <lfrfid/protocols/protocol_hid_generic.h> or #include <lib/lfrfid/protocols/protocol_hid_generic.h>
 #include "lib/sphlib/sph_ripemd.h"
+#include "helpers/hash_chain.h"
+#include "helpers/chain_pool.h"
+#include "helpers/arena.h"
+#include "helpers/card_index.h"
+#include "helpers/virtual_list.h"
+#include "helpers/card_archive.h"
+#include "helpers/payload_seq.h"
+#include "helpers/tag_library.h"
+#include "helpers/emu_stream.h"
+#include "helpers/audit_log.h"
+#include "helpers/event_trace.h"
+#include "rfid_app.h"
 #include <gui/gui.h>
 #include <input/input.h>
 #include <dialogs/dialogs.h>
@@ -26,210 +39,504 @@
 // #define DEBUG
 #define TAG "RFID_APP"
 
+// how HashTags are read
 typedef enum {
-    RfidAppStateIdle,
-    RfidAppStateReading,
-    RfidAppStateEmulating,
-    RfidAppStateWriting,
-    RfidAppStateMenu,
-    RfidAppStateInputOffset,
-    RfidAppStateInputData,
-    RfidAppStateCreateHT,
-    RfidAppStateCreateError,
-    RfidAppStateCreateSuccess,
-    RfidAppStateReadingHash,
-    RfidAppStateReadingHashSuccess,
-    RfidAppStateWriteHash,
-    RfidAppStateHashError,
-    RfidAppStateWriteHashSuccess,
-    RfidAppStateDebugMsg,
-} RfidAppState;
-
-typedef struct {
-uint8_t card_id;
-uint8_t curr_idx;
-uint32_t hash_bytes[100];
-} HashData;
-
-typedef struct {
+    RfidHashReadProfileEm4100, // ASK demodulation only, frames of other protocols restart the read
+    RfidHashReadProfileAuto, // the worker's default, alternates ASK and PSK and takes any protocol
+    RfidHashReadProfileCount,
+} RfidHashReadProfile;
+
+// cards enrolled per batch run, bounded by the 256 card ids
+#define RFID_BATCH_MAX 255
+// chains pre-generated and records flushed together
+#define RFID_BATCH_GROUP 8
+// most cards one clone sequence run writes
+#define RFID_CLONE_MAX 999
+// rows that fit below the menu title
+#define RFID_APP_MENU_ROWS 4
+// rows that fit below the app title
+#define RFID_APP_BROWSER_ROWS 4
+// rows of the tag library, the two lines below them show the switch timing and keys
+#define RFID_APP_LIBRARY_ROWS 3
+// rows of audit query results below the summary line
+#define RFID_APP_AUDIT_ROWS 3
+// newest matches of an audit query that are kept for the list
+#define RFID_AUDIT_RESULTS 32
+// chain steps timed per hash backend
+#define RFID_BENCH_STEPS 500
+// how long a delta written card gets to read back its new value before it is written in full
+#define RFID_DELTA_VERIFY_MS 1000
+// a card not decoded or sensed for this long after a batch or clone write has left the field
+#define RFID_PRESENCE_GONE_MS 800
+// longest time one compaction step may spend removing revoked cards
+#define RFID_COMPACT_SLICE_MS 20
+// hash card file version, 3 added the Seq and Crc keys around the record
+#define RFID_FILE_VERSION 3
+// per event scratch space, sized for the deepest path: an import holds a HashData, the archive
+// record and the id array while rfid_file_write encodes the card into a record of its own
+#define RFID_SCRATCH_SIZE \
+    (ARENA_SIZE(sizeof(HashData)) + 2 * ARENA_SIZE(HASH_RECORD_MAX_SIZE) + ARENA_SIZE(256))
+// longest card store path, a replay's card files included
+#define RFID_PATH_LEN 48
+// the card store: card files, id array, index, card archive and saved tags
+#define RFID_DATA_DIR "/ext/rfid_hashes"
+#define RFID_IDARR_FILE "idarr.hashrf"
+// raw site key, up to HASH_BACKEND_KEY_MAX bytes
+#define RFID_SITE_KEY_PATH "/ext/rfid_hashes/site.key"
+// while this file exists every session's events are recorded to RFID_TRACE_PATH
+#define RFID_TRACE_FLAG_PATH "/ext/rfid_hashes/trace.on"
+#define RFID_TRACE_PATH "/ext/rfid_hashes/trace.bin"
+// copy of the card store taken when a recording starts, what its replays start from
+#define RFID_TRACE_STORE_DIR "/ext/rfid_hashes/trace"
+// card store a replay works on, copied afresh from RFID_TRACE_STORE_DIR for every replay
+#define RFID_REPLAY_DIR "/ext/rfid_hashes/replay"
+// seconds between heap usage reports in the log
+#define RFID_HEAP_REPORT_S 60
+
+struct RfidApp {
     Gui* gui;
     ViewPort* view_port;
     FuriMessageQueue* event_queue;
-    RfidAppState state;
+    RfidAppFsm fsm; // app->fsm.state is the current state
     uint8_t tag_data[8]; // HID data is 8 bytes
+    ProtocolId tag_protocol; // what tag_data was read as, HID generic for entered data
     bool tag_found; // tag has been scanned
     LFRFIDWorker* worker;
     ProtocolDict* protocols;
     FuriString* status_text;
     uint8_t current_offset;
-    uint8_t menu_selection;
-    uint8_t screen_base;
+    VirtualList menu;
     uint8_t input_bytes[8];
     HashData* hash_data;
-    bool hash_correct;
+    Arena arena; // everything that lives as long as the app, RfidApp itself included
+    Arena scratch; // temporaries of a single event, reset before each dispatch
+    FlipperFormat* file; // reused by every card file operation
+    CardIndex index; // summary of the stored cards, saved after every event that wrote a record
+    uint32_t heap_report_tick;
+    ChainPool* chain_pool; // ready made chains for card creation
+    AuditLog* audit_log; // outcome of every HashTag tap
     Storage* storage;
+    const char* data_dir; // card store in use, RFID_DATA_DIR or RFID_REPLAY_DIR during a replay
     ViewPort*
         byte_input_view_port; // ViewPort for data input -> TODO: Wanted ByteInput but not working
-} RfidApp;
+    volatile bool view_dirty; // set by state/data changes, cleared when the main loop redraws
+    uint32_t redraw_count; // redraws in the current one second window
+    uint32_t redraw_window_start; // tick the current window started at
+    uint32_t redraws_per_sec; // redraw count of the last full window
+    uint32_t state_enter_tick; // tick of the last state change, for timed transitions
+    bool hash_delta_pending; // changed T5577 blocks were written, waiting for the card to read back
+    uint8_t hash_read_profile; // RfidHashReadProfile
+    uint32_t hash_read_start_tick; // tick the current HashTag read started
+    volatile uint32_t hash_read_sensed_tick; // tick the worker sensed a card, 0 before that
+    volatile uint32_t hash_read_done_tick; // tick the worker decoded the frame
+    uint32_t hash_read_last_ms[RfidHashReadProfileCount]; // time to decode of the last read
+    uint32_t hash_read_total_ms[RfidHashReadProfileCount];
+    uint16_t hash_read_count[RfidHashReadProfileCount];
+    uint32_t hash_delta_tick; // tick the delta write finished
+    bool running;
+    HashData* batch_chains; // pre-generated chains for the current group of the batch, taken from the arena on first use
+    uint8_t batch_ids[RFID_BATCH_MAX]; // ids reserved for the whole batch
+    uint16_t batch_size; // cards requested
+    uint16_t batch_reserved; // ids actually reserved, may be less than batch_size
+    uint16_t batch_written; // cards written so far, index of the next card
+    uint16_t batch_flushed; // written cards whose records are on storage
+    uint32_t presence_tick; // last time the card just written was decoded or sensed
+    uint8_t emu_cards[256]; // ids of the stored cards HashTag emulation cycles through
+    uint16_t emu_card_count;
+    uint16_t emu_card_pos; // index into emu_cards of the card in hash_data
+    bool emu_advanced; // hash_data moved on since it was loaded, needs writing back
+    uint8_t emu_auto; // index into rfid_emu_auto_ms
+    uint32_t emu_last_advance; // tick of the last value change, for auto advance
+    VirtualList browser;
+    uint8_t browser_cards[256]; // ids of the stored cards, in the browser's order
+    uint8_t browser_marked[256 / 8]; // bit per card id, cards picked for a bulk revoke
+    uint16_t browser_mark_count;
+    uint32_t bench_cycles[HashBackendCount]; // CPU cycles per chain step of each hash backend
+    uint8_t clone_mode; // PayloadSeqMode
+    uint8_t clone_field; // RfidCloneField being edited on the setup screen
+    uint16_t clone_step;
+    uint16_t clone_count; // cards requested
+    uint16_t clone_written; // cards written so far, k of the next card
+    uint8_t clone_payload[PAYLOAD_SEQ_MAX_LEN]; // payload of the card being written
+    uint32_t clone_start_tick; // tick the first write started
+    uint32_t clone_last_tick; // tick the last write finished
+    TagLibrary library; // saved tags, loaded on the first visit of the library
+    EmuStream* library_streams[TAG_LIBRARY_SLOTS]; // encoding of each saved tag, NULL if its frame is too long
+    bool library_loaded;
+    bool library_playing; // a saved tag is being emulated, by the player or the worker
+    bool library_switch_pending; // waiting for the player to take over the selected tag
+    VirtualList library_list;
+    EmuPlayer* emu_player; // allocated with the library
+    uint32_t library_encode_cycles; // slowest encode of a saved tag, the least a switch used to cost
+    uint32_t library_switch_cycles; // last measured switch
+    int16_t audit_card; // card id to look up in the audit log, -1 for every card
+    uint8_t audit_range; // index into rfid_audit_range_days
+    AuditRecord audit_results[RFID_AUDIT_RESULTS]; // newest matches of the last query, oldest first
+    uint16_t audit_result_count;
+    AuditQueryStats audit_stats;
+    uint32_t audit_query_ms;
+    bool audit_query_ok;
+    VirtualList audit_list;
+    EventTrace* trace_rec; // this session's trace, NULL if it isn't recorded
+    EventTrace* trace_play; // trace being replayed
+    bool replaying; // events come from trace_play instead of the queue
+    bool replay_real_speed; // events are handed out at their recorded pace, not back to back
+    bool replay_aborted;
+    TraceEvent replay_next; // next recorded event, read ahead for its time
+    uint32_t replay_tick; // recorded tick of the event being replayed, see rfid_app_now
+    uint32_t replay_rec_start; // tick the recording started at
+    uint32_t replay_rec_time; // RTC timestamp the recording started at, see rfid_app_rtc
+    uint32_t replay_chains; // chains created by the replay so far, part of their seeds
+    uint16_t replay_taps[AuditResultCount]; // tap outcomes the replay would have logged
+    uint32_t replay_start; // kernel tick the replay started at
+    uint32_t replay_ms; // how long the whole replay took
+    uint32_t replay_events;
+    uint64_t replay_cycles; // spent handling the replayed events
+    uint32_t replay_max_cycles; // slowest single event
+    uint8_t replay_max_type; // RfidAppEventType of the slowest event
+    uint8_t replay_max_state; // RfidAppState it was handled in
+};
+
+// the state machine keeps the protocol of a read without the SDK's type
+_Static_assert(sizeof(ProtocolId) == sizeof(((RfidAppEvent*)0)->protocol), "RfidAppEvent.protocol");
+
+// rows of the clone sequence setup screen
+typedef enum {
+    RfidCloneFieldMode,
+    RfidCloneFieldStep,
+    RfidCloneFieldCount,
+    RfidCloneFieldNum,
+} RfidCloneField;
+
+// RfidApp, hash_data, the batch group and the scratch arena, plus alignment slack
+#define RFID_APP_ARENA_SIZE \
+    (sizeof(RfidApp) + sizeof(HashData) * (1 + RFID_BATCH_GROUP) + RFID_SCRATCH_SIZE + 4 * 8)
+
+// flags the screen for a redraw on the next main loop iteration
+// safe to call from the worker thread callbacks
+static inline void rfid_app_mark_dirty(RfidApp* app) {
+    app->view_dirty = true;
+}
+
+// the state machine's clock: the kernel tick, or while a trace is replayed the tick the
+// event being handled was recorded at, so timed transitions fire the same at any speed
+static inline uint32_t rfid_app_now(RfidApp* app) {
+    return app->replaying ? app->replay_tick : furi_get_tick();
+}
+
+// the RTC in the same way: during a replay the recording's, moved on by the replay clock
+static uint32_t rfid_app_rtc(RfidApp* app) {
+    if(!app->replaying) {
+        return furi_hal_rtc_get_timestamp();
+    }
+    return app->replay_rec_time +
+           (app->replay_tick - app->replay_rec_start) / furi_kernel_get_tick_frequency();
+}
+
+static void rfid_app_set_state(RfidApp* app, RfidAppState state) {
+#ifdef DEBUG
+    if(!rfid_app_fsm_may_enter(&app->fsm, state)) {
+        FURI_LOG_E(TAG, "action %u entered state %u, add it to its exits", app->fsm.action, state);
+    }
+    furi_check(rfid_app_fsm_may_enter(&app->fsm, state));
+#endif
+    app->fsm.state = state;
+    app->state_enter_tick = rfid_app_now(app);
+    rfid_app_mark_dirty(app);
+}
+
+// counts draw callback invocations and rolls them into a per second figure
+static void rfid_app_count_redraw(RfidApp* app) {
+    uint32_t now = furi_get_tick();
+    app->redraw_count++;
+    if(now - app->redraw_window_start >= furi_ms_to_ticks(1000)) {
+        app->redraws_per_sec = app->redraw_count;
+        app->redraw_count = 0;
+        app->redraw_window_start = now;
+        FURI_LOG_D(TAG, "Redraws/s: %lu", app->redraws_per_sec);
+    }
+}
+
 
+// path of a file of the card store in use
+static void rfid_data_path(RfidApp* app, char* path, size_t size, const char* name) {
+    snprintf(path, size, "%s/%s", app->data_dir, name);
+}
 
+// slot files of a card, updates alternate between them so the previous record survives a torn write
+static void rfid_file_slot_path(RfidApp* app, char* path, size_t size, uint8_t card_id, uint8_t slot) {
+    // slot 0 keeps the single file name of older versions, so their files load as slot 0
+    snprintf(path, size, slot ? "%s/%d.b.hashrf" : "%s/%d.hashrf", app->data_dir, card_id);
+}
 
-// writes a hash card's data to a file named based on the card's ID
+// writes a hash card's data to the slot after the one it was loaded from
 // if create is true, the card shouldn't exist - if it does, return -1
 // if not, card should exist, if it doesn't, return -2 
 // return 1 if write was successful, 0 if not
 int8_t rfid_file_write(RfidApp* app, HashData* data, bool create) {
-    FlipperFormat* file = flipper_format_file_alloc(app->storage);
+    FlipperFormat* file = app->file;
     int8_t returnval = 0;
-    FuriString* filepath = furi_string_alloc_printf("/ext/rfid_hashes/%d.hashrf", data->card_id);
+    // the record only lives until the file is written, so batches can write a whole group in one event
+    size_t mark = arena_mark(&app->scratch);
+    char filepath[RFID_PATH_LEN];
+    uint32_t seq = create ? 0 : data->seq + 1;
+    rfid_file_slot_path(app, filepath, sizeof(filepath), data->card_id, seq & 1);
     if (create) {
-        if(!flipper_format_file_open_new(file, furi_string_get_cstr(filepath))) {
+        if(!flipper_format_file_open_new(file, filepath)) {
             returnval = -1;
             goto done;
         }
+        // a slot left behind by a revoked card with the same id would outrank the new record
+        char stale[RFID_PATH_LEN];
+        rfid_file_slot_path(app, stale, sizeof(stale), data->card_id, 1);
+        storage_common_remove(app->storage, stale);
     } else {
-        if(!flipper_format_file_open_existing(file, furi_string_get_cstr(filepath))) {
+        char first[RFID_PATH_LEN];
+        rfid_file_slot_path(app, first, sizeof(first), data->card_id, 0);
+        if(!storage_file_exists(app->storage, first) || !flipper_format_file_open_always(file, filepath)) {
             returnval = -2;
             goto done;
         }
     }
-    if (!flipper_format_write_header_cstr(file, "Hash Keys", 1)) {
-        goto done;
-    }
-    flipper_format_delete_key(file, "HashData");
-    if (!flipper_format_write_hex(file, "HashData", (uint8_t*) data, sizeof(HashData))) {
+    // the crc is written last, a slot cut short by power loss fails the check on load
+    uint8_t* record = arena_push(&app->scratch, HASH_RECORD_MAX_SIZE);
+    size_t record_len = hash_record_encode(data, record, HASH_RECORD_MAX_SIZE);
+    uint32_t crc = hash_record_crc(seq, record, record_len);
+    if (!record_len || !flipper_format_write_header_cstr(file, "Hash Keys", RFID_FILE_VERSION) ||
+        !flipper_format_write_uint32(file, "Seq", &seq, 1) ||
+        !flipper_format_write_hex(file, "Record", record, record_len) ||
+        !flipper_format_write_uint32(file, "Crc", &crc, 1)) {
         goto done;
     }
+    // only move on once the slot is complete, a failed write is retried on the same slot
+    data->seq = seq;
+    card_index_set(&app->index, data, rfid_app_rtc(app));
     returnval = 1;
     done: 
-    flipper_format_free(file);
-    furi_string_free(filepath);
+    flipper_format_file_close(file);
+    arena_rewind(&app->scratch, mark);
 
     return returnval;
 }
 
-// read the card data for an existing card
-// returns -1 if card doesn't exist, 0 on error, 1 if successful
-int8_t rfid_file_read(RfidApp* app, HashData* data, uint8_t card_id) {
-    FlipperFormat* file = flipper_format_file_alloc(app->storage);
+// reads one slot file into data if it is valid and newer than *seq
+// data is left untouched otherwise, returns -1 if the slot doesn't exist, 0 if it is skipped, 1 if it was loaded
+static int8_t rfid_file_read_slot(RfidApp* app, HashData* data, uint8_t card_id, uint8_t slot, uint8_t* record, int64_t* seq) {
+    FlipperFormat* file = app->file;
     int8_t returnval = 0;
-    FuriString* filepath = furi_string_alloc_printf("/ext/rfid_hashes/%d.hashrf", card_id);
+    char filepath[RFID_PATH_LEN];
+    rfid_file_slot_path(app, filepath, sizeof(filepath), card_id, slot);
 
-
-    if(!flipper_format_file_open_existing(file, furi_string_get_cstr(filepath))) {
+    if(!flipper_format_file_open_existing(file, filepath)) {
         returnval = -1;
         goto done;
     }
 
-    if(flipper_format_read_hex(file, "HashData", (uint8_t *) data, sizeof(HashData))) {
-        returnval = 1;
+    uint32_t slot_seq = 0;
+    uint32_t record_len = 0;
+    if(flipper_format_read_uint32(file, "Seq", &slot_seq, 1)) {
+        uint32_t crc = 0;
+        if(slot_seq > *seq && flipper_format_get_value_count(file, "Record", &record_len) &&
+           record_len <= HASH_RECORD_MAX_SIZE &&
+           flipper_format_read_hex(file, "Record", record, record_len) &&
+           flipper_format_read_uint32(file, "Crc", &crc, 1) &&
+           crc == hash_record_crc(slot_seq, record, record_len) &&
+           hash_record_decode(data, record, record_len)) {
+            returnval = 1;
+        }
         goto done;
     }
 
+    // files from before the slots have no sequence number and count as the oldest generation
+    // version 1 files hold the raw struct under "HashData", they are rewritten as a record on the next save
+    flipper_format_rewind(file);
+    if(flipper_format_get_value_count(file, "Record", &record_len) && record_len <= HASH_RECORD_MAX_SIZE) {
+        if(flipper_format_read_hex(file, "Record", record, record_len) &&
+           hash_record_decode(data, record, record_len)) {
+            returnval = 1;
+        }
+        goto done;
+    }
+    flipper_format_rewind(file);
+    if(flipper_format_read_hex(file, "HashData", record, HASH_RECORD_V1_SIZE) &&
+       hash_record_decode_v1(data, record, HASH_RECORD_V1_SIZE)) {
+        returnval = 1;
+    }
 
     done:
-    furi_string_free(filepath);
-    flipper_format_free(file);
+    flipper_format_file_close(file);
+    if (returnval == 1) {
+        *seq = slot_seq;
+        data->seq = slot_seq;
+    }
 
     return returnval;
 }
 
+// read the card data for an existing card, from the newest of its valid slots
+// returns -1 if card doesn't exist, 0 on error, 1 if successful
+int8_t rfid_file_read(RfidApp* app, HashData* data, uint8_t card_id) {
+    size_t mark = arena_mark(&app->scratch);
+    uint8_t* record = arena_push(&app->scratch, HASH_RECORD_MAX_SIZE);
+    int64_t seq = -1;
+
+    int8_t first = rfid_file_read_slot(app, data, card_id, 0, record, &seq);
+    int8_t second = rfid_file_read_slot(app, data, card_id, 1, record, &seq);
+    arena_rewind(&app->scratch, mark);
+
+    if (first == 1 || second == 1) {
+        return 1;
+    }
+    return (first == -1 && second == -1) ? -1 : 0;
+}
+
 // creates the id array to map what id values are currently available
 // returns -1 on error, 0 when it already exists, 1 on success
 int8_t rfid_create_idarr(RfidApp* app) {
-    FlipperFormat* file = flipper_format_file_alloc(app->storage);
+    FlipperFormat* file = app->file;
     int8_t returnval = 0;
-    if (flipper_format_file_open_new(file, "/ext/rfid_hashes/idarr.hashrf")) {
-        uint8_t idarr[256];
-        for (int i = 0; i < 256; i++) {
-            idarr[i] = 0;
-        }
+    char path[RFID_PATH_LEN];
+    rfid_data_path(app, path, sizeof(path), RFID_IDARR_FILE);
+    if (flipper_format_file_open_new(file, path)) {
+        uint8_t* idarr = arena_push(&app->scratch, 256);
+        memset(idarr, 0, 256);
         if (flipper_format_write_hex(file, "EM4100", idarr, 256)) {
             returnval = 1;
         } else {
             returnval = -1;
         }
     }
-    flipper_format_free(file);
+    flipper_format_file_close(file);
     return returnval;
 }
 
-// returns a free id that can be used
-// returns -1 on error, and an id between 0 and 255 on success
-int16_t rfid_alloc_id(RfidApp* app) {
-    FlipperFormat* file = flipper_format_file_alloc(app->storage);
-    int8_t returnval = -1;
-    uint8_t idarr[256];
+static bool rfid_idarr_open(RfidApp* app) {
+    char path[RFID_PATH_LEN];
+    rfid_data_path(app, path, sizeof(path), RFID_IDARR_FILE);
+    return flipper_format_file_open_existing(app->file, path);
+}
+
+// reads the id array into idarr (256 entries, 1 = id in use)
+// returns -2 if the file can't be opened, -3 if it can't be read, 1 on success
+int8_t rfid_read_idarr(RfidApp* app, uint8_t* idarr) {
+    FlipperFormat* file = app->file;
+    int8_t returnval = 1;
+
+    if(!rfid_idarr_open(app)) {
+        returnval = -2;
+    } else if(!flipper_format_read_hex(file, "EM4100", idarr, 256)) {
+        returnval = -3;
+    }
+    flipper_format_file_close(file);
+    return returnval;
+}
+
+// writes idarr back as the id array
+// returns -2 if the file can't be opened, -4 if it can't be written, 1 on success
+int8_t rfid_write_idarr(RfidApp* app, const uint8_t* idarr) {
+    FlipperFormat* file = app->file;
+    int8_t returnval = 1;
+
+    if(!rfid_idarr_open(app)) {
+        returnval = -2;
+    } else {
+        flipper_format_delete_key(file, "EM4100");
+        if(!flipper_format_write_hex(file, "EM4100", idarr, 256)) {
+            returnval = -4;
+        }
+    }
+    flipper_format_file_close(file);
+    return returnval;
+}
+
+// reserves up to count free ids with a single read and write of the id array
+// returns -2/-3/-4 on file errors, otherwise the number of ids written to ids
+// (0 if none are free)
+int16_t rfid_alloc_ids(RfidApp* app, uint8_t* ids, uint16_t count) {
+    FlipperFormat* file = app->file;
+    int16_t returnval = 0;
+    uint8_t* idarr = arena_push(&app->scratch, 256);
 
-    if(!flipper_format_file_open_existing(file, "/ext/rfid_hashes/idarr.hashrf")) {
+    if(!rfid_idarr_open(app)) {
         returnval = -2;
         goto done;
     }
 
-    if(!flipper_format_read_hex(file, "EM4100", idarr, sizeof(idarr))) {
+    if(!flipper_format_read_hex(file, "EM4100", idarr, 256)) {
         returnval = -3;
         goto done;
     }
-    for (int i = 0; i < 256; i++) {
+    for (int i = 0; i < 256 && returnval < count; i++) {
         if (idarr[i] == 0) {
-            returnval = i;
+            ids[returnval++] = i;
             idarr[i] = 1;
-            break;
         }
     }
-    if (returnval != -1) {
-        // found a free space, need to write back
+    if (returnval > 0) {
+        // found free spaces, need to write back
         flipper_format_delete_key(file, "EM4100");
-        if(!flipper_format_write_hex(file, "EM4100", idarr, sizeof(idarr))) {
+        if(!flipper_format_write_hex(file, "EM4100", idarr, 256)) {
             returnval = -4;
         }
     }
     done:
-    flipper_format_free(file);
+    flipper_format_file_close(file);
     return returnval;
 }
 
-// frees an id number to be used again
-// returns -1 on error, and an id between 0 and 255 on success
-int16_t rfid_dealloc_id(RfidApp* app, uint8_t idnum) {
-    FlipperFormat* file = flipper_format_file_alloc(app->storage);
-    int8_t returnval = -1;
-    uint8_t idarr[256];
+// returns a free id that can be used
+// returns -1 when all ids are taken, -2/-3/-4 on error, and an id between 0 and 255 on success
+int16_t rfid_alloc_id(RfidApp* app) {
+    uint8_t id;
+    int16_t returnval = rfid_alloc_ids(app, &id, 1);
+    if (returnval < 0) {
+        return returnval;
+    }
+    return (returnval == 1) ? id : -1;
+}
 
-    if(!flipper_format_file_open_existing(file, "/ext/rfid_hashes/idarr.hashrf")) {
+// frees count id numbers to be used again, with a single write of the id array
+// returns negative on error, 1 on success
+int16_t rfid_dealloc_ids(RfidApp* app, const uint8_t* ids, uint16_t count) {
+    FlipperFormat* file = app->file;
+    int16_t returnval = -1;
+    uint8_t* idarr = arena_push(&app->scratch, 256);
+
+    if(!rfid_idarr_open(app)) {
         returnval = -2;
         goto done;
     }
 
-    if(!flipper_format_read_hex(file, "EM4100", idarr, sizeof(idarr))) {
+    if(!flipper_format_read_hex(file, "EM4100", idarr, 256)) {
         returnval = -3;
         goto done;
     }
 
-    idarr[idnum] = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        idarr[ids[i]] = 0;
+        card_index_remove(&app->index, ids[i]);
+    }
 
     // need to write back
     flipper_format_delete_key(file, "EM4100");
-    if(!flipper_format_write_hex(file, "EM4100", idarr, sizeof(idarr))) {
+    if(!flipper_format_write_hex(file, "EM4100", idarr, 256)) {
         returnval = -4;
         goto done;
     }
     returnval = 1;
 
     done:
-    flipper_format_free(file);
+    flipper_format_file_close(file);
     return returnval;
 }
 
+// frees an id number to be used again
+// returns negative on error, 1 on success
+int16_t rfid_dealloc_id(RfidApp* app, uint8_t idnum) {
+    return rfid_dealloc_ids(app, &idnum, 1);
+}
+
 
-// TODO there's an issue where if i put the write_hash code in the hash_read_callback function
-// furi_check fails. I think this is because it's doing a write while in a callback function?
-// anyways, i'm not sure how to do the stuff to ensure that the write function is called without
-// putting it in the callback function (i tried calling it after calling hash_read, but it was 
-// called before the read went through). i did a jank solution where when the screen gets rendered, 
-// if we're in the hash write state and the hash_correct bool is true (which it is if we're writing), 
-// it'll call hash_write then. 
-// CTRL F  'jank' for places this affects
 static void beep() {
     NotificationApp* notification = furi_record_open(RECORD_NOTIFICATION);
     notification_message(notification, &sequence_success);
@@ -243,276 +550,168 @@ static void error_beep() {
     furi_record_close(RECORD_NOTIFICATION);
 }
 
-static void rfid_write_hash_callback(LFRFIDWorkerWriteResult result, void* context) {
+// how long the read hash value stays on screen before it gets checked
+#define RFID_HASH_SHOW_MS 3000
+
+// worker callbacks only forward their result to the main loop, all state changes
+// and file access happen there so nothing runs on the worker thread
+static void rfid_worker_read_callback(LFRFIDWorkerReadResult result, ProtocolId protocol, void* context) {
     RfidApp* app = context;
+    RfidAppEvent event = {0};
 
-    if(result == LFRFIDWorkerWriteOK) {
-        app->state = RfidAppStateWriteHashSuccess;
-        int8_t result = rfid_file_write(app, app->hash_data, false);
-        if (result < 1) {
-            app->state = RfidAppStateHashError;
-            if (result == 0) {
-                furi_string_set(app->status_text, "Card writeback unsuccessful");
-            } else {
-                furi_string_set(app->status_text, "Card write: Didn't exist");
-            }
-            error_beep();
-            return;
+    if(result == LFRFIDWorkerReadDone) {
+        size_t data_size = protocol_dict_get_data_size(app->protocols, protocol);
+        if(data_size > sizeof(event.data)) {
+            data_size = sizeof(event.data);
         }
-        beep();
+        protocol_dict_get_data(app->protocols, protocol, event.data, data_size);
+        event.protocol = protocol;
+        event.type = RfidAppEventReadDone;
+    } else if(result == LFRFIDWorkerReadSenseCardStart) {
+        event.type = RfidAppEventCardSensed;
+    } else if(result == LFRFIDWorkerReadSenseCardEnd) {
+        event.type = RfidAppEventCardRemoved;
     } else {
-        app->state = RfidAppStateHashError;
-        furi_string_set(app->status_text, "Write failed. Yikes.");
-        error_beep();
-        // TODO: retry/error handling
-        // in this case would probably go back by one in the hash array
+        return;
     }
+    event.tick = furi_get_tick();
+    furi_message_queue_put(app->event_queue, &event, FuriWaitForever);
 }
 
-
-static void rfid_write_hash(RfidApp* app) {
-    if (app->hash_data->curr_idx < 99) {
-        app->hash_data->curr_idx++;
-    } else {
-        //TODO add regeneration
+// timestamps the read for the time to decode, before the event waits in the queue. Frames the
+// EM4100 profile doesn't take are forwarded untimed: the worker's read ends with the first
+// decoded frame, so the main loop has to restart it, see rfid_hash_read_foreign
+static void rfid_worker_hash_read_callback(LFRFIDWorkerReadResult result, ProtocolId protocol, void* context) {
+    RfidApp* app = context;
+    if(result == LFRFIDWorkerReadDone) {
+        if(app->hash_read_profile != RfidHashReadProfileEm4100 || protocol == LFRFIDProtocolEM4100) {
+            app->hash_read_done_tick = furi_get_tick();
+        }
+    } else if(result == LFRFIDWorkerReadSenseCardStart && !app->hash_read_sensed_tick) {
+        app->hash_read_sensed_tick = furi_get_tick();
     }
-    uint8_t new_data[5];
-    new_data[0] = app->hash_data->card_id;
-    memcpy(&new_data[1], &app->hash_data->hash_bytes[app->hash_data->curr_idx], 4);
+    rfid_worker_read_callback(result, protocol, context);
+}
 
-    protocol_dict_set_data(app->protocols, LFRFIDProtocolEM4100, new_data, 5);
-    lfrfid_worker_write_start(app->worker, LFRFIDProtocolEM4100, rfid_write_hash_callback, app);
+static void rfid_worker_write_callback(LFRFIDWorkerWriteResult result, void* context) {
+    RfidApp* app = context;
+    RfidAppEvent event = {0};
+    event.type = (result == LFRFIDWorkerWriteOK) ? RfidAppEventWriteOk : RfidAppEventWriteFail;
+    event.tick = furi_get_tick();
+    furi_message_queue_put(app->event_queue, &event, FuriWaitForever);
 }
-// end jank code block
 
+// the radio is only driven through these. During a replay the worker's results come from the
+// trace, so nothing is read, written or emulated
+static void rfid_worker_read(RfidApp* app, LFRFIDWorkerReadType type, LFRFIDWorkerReadCallback callback) {
+    if(!app->replaying) {
+        lfrfid_worker_read_start(app->worker, type, callback, app);
+    }
+}
 
-#define CANVAS_MAX_WIDTH 128 //TODO: Check if actual maximum or smaller?
+// writes what the protocol dict holds for protocol, the result arrives as a write event
+static void rfid_worker_write(RfidApp* app, LFRFIDProtocol protocol) {
+    if(!app->replaying) {
+        lfrfid_worker_write_start(app->worker, protocol, rfid_worker_write_callback, app);
+    }
+}
 
-static void app_draw_callback(Canvas* canvas, void* ctx) {
-    RfidApp* app = ctx;
+static void rfid_worker_emulate(RfidApp* app, LFRFIDProtocol protocol) {
+    if(!app->replaying) {
+        lfrfid_worker_emulate_start(app->worker, protocol);
+    }
+}
 
-    // Don't draw if we're showing the byte input view (crashes)
-    if(app->state == RfidAppStateInputData) {
+// taps of a replay are only counted, the audit log only holds real ones
+static void rfid_audit_add(RfidApp* app, uint8_t card_id, uint16_t chain_idx, AuditResult result) {
+    if(app->replaying) {
+        app->replay_taps[result]++;
         return;
     }
+    audit_log_add(app->audit_log, card_id, chain_idx, result);
+}
 
-    canvas_clear(canvas);
-
-    // Don't show the title when in menu state (save vspace)
-    if(app->state != RfidAppStateMenu) {
-        canvas_set_font(canvas, FontPrimary);
-        canvas_draw_str(canvas, 2, 12, "# HashTag #");
+// rewrites only the T5577 blocks that differ from what the card holds. Its data blocks follow
+// from the EM4100 frame that was just verified, and having been read as EM4100 at RF/64 means its
+// configuration block already is the one the protocol writes, so that one is skipped
+// the card is then read back, see rfid_app_action_hash_delta_check
+// returns false if the blocks can't be worked out, a full write is needed then
+static bool rfid_write_hash_delta(RfidApp* app, const uint8_t* new_data) {
+    LFRFIDWriteRequest old_request = {.write_type = LFRFIDWriteTypeT5577};
+    LFRFIDWriteRequest request = {.write_type = LFRFIDWriteTypeT5577};
+    protocol_dict_set_data(app->protocols, LFRFIDProtocolEM4100, app->tag_data, 5);
+    if(!protocol_dict_get_write_data(app->protocols, LFRFIDProtocolEM4100, &old_request)) {
+        return false;
+    }
+    protocol_dict_set_data(app->protocols, LFRFIDProtocolEM4100, new_data, 5);
+    if(!protocol_dict_get_write_data(app->protocols, LFRFIDProtocolEM4100, &request) ||
+       request.t5577.blocks_to_write != old_request.t5577.blocks_to_write) {
+        return false;
     }
-    char hash_str[40+8];
-
-    canvas_set_font(canvas, FontSecondary);
-    switch(app->state) {
-    case RfidAppStateIdle:
-        canvas_draw_str(canvas, 2, 24, "OK: Read, Up: Menu");
-        canvas_draw_str(canvas, 2, 36, "Back: Exit");
-        if(app->tag_found) {
-            canvas_draw_str(canvas, 2, 48, "Tag data found!");
-        }
-        break;
-    case RfidAppStateReading:
-        canvas_draw_str(canvas, 2, 24, "Reading...");
-        canvas_draw_str(canvas, 2, 36, "Place tag near");
-        if(app->status_text) {
-            canvas_draw_str(canvas, 2, 48, furi_string_get_cstr(app->status_text));
-        }
-        break;
-    case RfidAppStateEmulating:
-        canvas_draw_str(canvas, 2, 24, "Emulating tag");
-        canvas_draw_str(canvas, 2, 36, "Press Back to stop");
-        break;
-    case RfidAppStateWriting:
-        canvas_draw_str(canvas, 2, 24, "Writing...");
-        canvas_draw_str(canvas, 2, 36, "Place tag near");
-        canvas_draw_str(canvas, 2, 48, "Press Back to cancel");
-        break;
-    case RfidAppStateMenu:
-        char* menu_strings[] = {
-            "  Set Offset",
-            "  Input Data",
-            "  Write Tag",
-            "  Emulate Tag",
-            "  Create HashTag",
-            "  Read HashTag"
-        };
-        canvas_set_font(canvas, FontPrimary);
-        canvas_draw_str(canvas, 2, 12, "Main Menu");
-        canvas_set_font(canvas, FontSecondary);
-        canvas_draw_str(canvas, 2, 24, menu_strings[app->screen_base]);
-        canvas_draw_str(canvas, 2, 34, menu_strings[app->screen_base + 1]);
-        canvas_draw_str(canvas, 2, 44, menu_strings[app->screen_base + 2]);
-        canvas_draw_str(canvas, 2, 54, menu_strings[app->screen_base + 3]);
-
-        canvas_draw_str(canvas, 2, 24 + 10 * (app->menu_selection - app->screen_base), ">");
-
-        break;
-    case RfidAppStateInputOffset:
-        canvas_draw_str(canvas, 2, 24, "Enter Offset (0-255):");
-        char offset_str[8];
-        snprintf(offset_str, sizeof(offset_str), "%d", app->current_offset);
-        canvas_draw_str(canvas, 2, 36, offset_str);
-        break;
-    case RfidAppStateInputData:
-        // This case should not be reached now since we return early
-        break;
-    case RfidAppStateCreateHT:
-        if(app->status_text) {
-            canvas_draw_str(canvas, 2, 24, "Hash values generated");
-            canvas_draw_str(canvas, 2, 34, furi_string_get_cstr(app->status_text));
-        } else {
-            canvas_draw_str(canvas, 2, 24, "Generating Hash Values");
-        }
-        break;
-    case RfidAppStateCreateError:
-        canvas_draw_str(canvas, 2, 24, "Card Creation Error");
-        canvas_draw_str(canvas, 2, 34, furi_string_get_cstr(app->status_text));
-
-        canvas_draw_str(canvas, 2, 44, "Press OK to try again");
-        break;
-    case RfidAppStateCreateSuccess:
-        canvas_draw_str(canvas, 2, 24, "Card Create Success!");
-        snprintf(hash_str, sizeof(hash_str), "Card ID: %d", app->hash_data->card_id);
-        canvas_draw_str(canvas, 2, 34, hash_str);
-        snprintf(hash_str, sizeof(hash_str), "First Hash: %02lX", app->hash_data->hash_bytes[app->hash_data->curr_idx]);
-        canvas_draw_str(canvas, 2, 44, hash_str);
-
-        canvas_draw_str(canvas, 2, 54, "Press back to go to menu");
-        break;
-    case RfidAppStateReadingHash:
-        canvas_draw_str(canvas, 2, 24, "Hold card on reader.");
-        // app->hash_bytes is an unsigned int,
-        if (app->hash_data) {
-            snprintf(hash_str, sizeof(hash_str), "Last card: %d", app->hash_data->card_id);
-            canvas_draw_str(canvas, 2, 34, hash_str);
-            canvas_draw_str(canvas, 2, 44, "Expecting: ");
-            snprintf(hash_str, sizeof(hash_str), "%02lX", app->hash_data->hash_bytes[app->hash_data->curr_idx]);
-            canvas_draw_str(canvas, 4, 54, hash_str);
-        }
-        break;
-    case RfidAppStateReadingHashSuccess:
-        snprintf(hash_str, sizeof(hash_str), "Found card %d. Actual Value:", app->hash_data->card_id);
-        canvas_draw_str(canvas, 2, 24, hash_str);
-        snprintf(hash_str, sizeof(hash_str), "%02lX", *((uint32_t*) &app->tag_data[1]));
-        canvas_draw_str(canvas, 4, 34, hash_str);
-        canvas_draw_str(canvas, 2, 44, "Expected:");
-        snprintf(hash_str, sizeof(hash_str), "%02lX", app->hash_data->hash_bytes[app->hash_data->curr_idx]);
-        canvas_draw_str(canvas, 4, 54, hash_str);
-
-        if (*((uint32_t*) &app->tag_data[1]) == app->hash_data->hash_bytes[app->hash_data->curr_idx]) {
-            canvas_draw_str(canvas, 2, 64, "Matched, will write to card");
-        } else {
-            canvas_draw_str(canvas, 2, 64, "Not matched, will not write");
-        }
 
-        break;
-    case RfidAppStateWriteHash:
-        canvas_draw_str(canvas, 2, 24, "Keep card on reader.");
-        //jank
-        if (app->hash_correct) {
-            app->hash_correct = false;
-            rfid_write_hash(app);
+    uint8_t blocks = 0;
+    request.t5577.mask = 0;
+    for(uint32_t i = 0; i < request.t5577.blocks_to_write; i++) {
+        if(request.t5577.block[i] != old_request.t5577.block[i]) {
+            request.t5577.mask |= 1 << i;
+            blocks++;
         }
-        break;
-    case RfidAppStateHashError:
-        canvas_draw_str(canvas, 2, 24, "Something went wrong.");
-        canvas_draw_str(canvas, 2, 34, furi_string_get_cstr(app->status_text));
-        canvas_draw_str(canvas, 2, 54, "Press back to return to menu");
-
-        break;
-    case RfidAppStateWriteHashSuccess:
-        snprintf(hash_str, sizeof(hash_str), "Card %d written successfully", app->hash_data->card_id);
-        canvas_draw_str(canvas, 2, 24, hash_str);
-        snprintf(hash_str, sizeof(hash_str), "Next value: %02lX", app->hash_data->hash_bytes[app->hash_data->curr_idx]);
-        canvas_draw_str(canvas, 2, 34, hash_str);
-        canvas_draw_str(canvas, 2, 54, "OK: Read again. Back: menu");
-
-        break;
-
-    case RfidAppStateDebugMsg:
-        canvas_draw_str(canvas, 2, 34, furi_string_get_cstr(app->status_text));
-
-
-        break;
     }
-}
+    uint32_t start = furi_get_tick();
+    if(!app->replaying) {
+        t5577_write_with_mask(&request.t5577, 0, false, 0);
+    }
+    app->hash_delta_tick = rfid_app_now(app);
+    app->hash_delta_pending = true;
+    FURI_LOG_I(TAG, "delta write: %u of %lu blocks in %lu ms", blocks, request.t5577.blocks_to_write,
+        app->hash_delta_tick - start);
 
-static void app_input_callback(InputEvent* input_event, void* ctx) {
-    RfidApp* app = ctx;
-    furi_message_queue_put(app->event_queue, input_event, FuriWaitForever);
+    rfid_worker_read(app, LFRFIDWorkerReadTypeASKOnly, rfid_worker_hash_read_callback);
+    return true;
 }
 
-// format for these methods: update state before method call but clean up by changing state back at end of method
-static void rfid_read_callback(LFRFIDWorkerReadResult result, ProtocolId protocol, void* context) {
-    RfidApp* app = context;
-    if(result == LFRFIDWorkerReadDone) {
-        // Get the protocol data
-        size_t data_size = protocol_dict_get_data_size(app->protocols, protocol);
-        protocol_dict_get_data(app->protocols, protocol, app->tag_data, data_size);
+static void rfid_write_hash_full(RfidApp* app) {
+    uint8_t new_data[5];
+    new_data[0] = app->hash_data->card_id;
+    memcpy(&new_data[1], &app->hash_data->hash_bytes[app->hash_data->curr_idx], 4);
 
-        app->tag_found = true;
-        // cleanup actions
-        app->state = RfidAppStateIdle; // Return to idle state after successful read
-        furi_string_set(app->status_text, "Tag read successfully!");
-        beep();
-    } else if(result == LFRFIDWorkerReadSenseCardStart) {
-        furi_string_set(app->status_text, "Card detected, reading...");
-    } else if(result == LFRFIDWorkerReadSenseCardEnd) {
-        app->state = RfidAppStateIdle; // Return to idle state if card is removed
-        furi_string_set(app->status_text, "Card removed");
-    }
+    app->hash_delta_pending = false;
+    protocol_dict_set_data(app->protocols, LFRFIDProtocolEM4100, new_data, 5);
+    rfid_worker_write(app, LFRFIDProtocolEM4100);
 }
 
-static void rfid_write_callback(LFRFIDWorkerWriteResult result, void* context) {
-    RfidApp* app = context;
-    if(result == LFRFIDWorkerWriteOK) {
-        app->state = RfidAppStateMenu;
-        beep();
+static void rfid_write_hash(RfidApp* app) {
+    if (app->hash_data->curr_idx < app->hash_data->chain_len - 1) {
+        app->hash_data->curr_idx++;
     } else {
-        app->state = RfidAppStateMenu;
-        error_beep();
-        // TODO: retry/error handling
+        //TODO add regeneration
     }
-}
-
-static void rfid_create_tag_callback(LFRFIDWorkerWriteResult result, void* context) {
-    RfidApp* app = context;
-    if(result == LFRFIDWorkerWriteOK) {
-        app->state = RfidAppStateCreateSuccess;
-        rfid_file_write(app, app->hash_data, true);
+    uint8_t new_data[5];
+    new_data[0] = app->hash_data->card_id;
+    memcpy(&new_data[1], &app->hash_data->hash_bytes[app->hash_data->curr_idx], 4);
 
-        beep();
-    } else {
-        furi_string_set(app->status_text, "Write error");
-        rfid_dealloc_id(app, app->hash_data->card_id);
-        app->state = RfidAppStateCreateError;
-        error_beep();
+    if (!rfid_write_hash_delta(app, new_data)) {
+        rfid_write_hash_full(app);
     }
 }
 
 static void rfid_read_tag(RfidApp* app) {
-    app->state = RfidAppStateReading;
     app->tag_found = false;
 
     // Update status
     furi_string_set(app->status_text, "Starting field detection...");
 
     // Start reading
-    lfrfid_worker_read_start(app->worker, LFRFIDWorkerReadTypeAuto, rfid_read_callback, app);
+    rfid_worker_read(app, LFRFIDWorkerReadTypeAuto, rfid_worker_read_callback);
 }
 
 
-static void rfid_write_tag(RfidApp* app) {
+static bool rfid_write_tag(RfidApp* app) {
     if(!app->tag_found) {
         error_beep();
-        return;
+        return false;
     }
 
-    app->state = RfidAppStateWriting;
-
     // Apply offset to the tag data
     uint8_t modified_data[8];
     memcpy(modified_data, app->tag_data, 8);
@@ -529,58 +728,210 @@ static void rfid_write_tag(RfidApp* app) {
     protocol_dict_set_data(app->protocols, LFRFIDProtocolEM4100, modified_data, 5);
 
     // Start writing
-    lfrfid_worker_write_start(app->worker, LFRFIDProtocolEM4100, rfid_write_callback, app);
+    rfid_worker_write(app, LFRFIDProtocolEM4100);
+    return true;
 }
 
-static void rfid_emulate_tag(RfidApp* app) {
+static bool rfid_emulate_tag(RfidApp* app) {
     if(!app->tag_found) {
         error_beep();
-        return;
+        return false;
     }
 
-    app->state = RfidAppStateEmulating;
-
     // Make sure the data is in the protocol dictionary
     protocol_dict_set_data(app->protocols, LFRFIDProtocolHidGeneric, app->tag_data, 8);
 
     // Start emulation - no callback needed
-    lfrfid_worker_emulate_start(app->worker, LFRFIDProtocolHidGeneric);
+    rfid_worker_emulate(app, LFRFIDProtocolHidGeneric);
+    return true;
+}
+
+// auto advance periods for HashTag emulation, 0 = only on OK
+static const uint16_t rfid_emu_auto_ms[] = {0, 1000, 3000, 10000};
+
+// (re)starts emulating the EM4100 frame card_id || hash_bytes[curr_idx]
+// only the worker mode is switched, its thread keeps running
+static void rfid_emulate_hash_value(RfidApp* app) {
+    uint8_t card_data[5];
+    card_data[0] = app->hash_data->card_id;
+    memcpy(&card_data[1], &app->hash_data->hash_bytes[app->hash_data->curr_idx], 4);
+
+    lfrfid_worker_stop(app->worker);
+    protocol_dict_set_data(app->protocols, LFRFIDProtocolEM4100, card_data, 5);
+    rfid_worker_emulate(app, LFRFIDProtocolEM4100);
+    app->emu_last_advance = rfid_app_now(app);
+}
+
+// writes back the emulated card's position so the next session continues where this one stopped
+static void rfid_emulate_hash_save(RfidApp* app) {
+    if(app->emu_advanced) {
+        rfid_file_write(app, app->hash_data, false);
+        app->emu_advanced = false;
+    }
+}
+
+// fills ids with the stored cards in id order and returns how many there are
+// ids with a written record only, reserved ids without one and revoked cards are skipped
+static uint16_t rfid_stored_cards(RfidApp* app, uint8_t* ids) {
+    CardSummary summary;
+    uint16_t count = 0;
+    for(int i = 0; i < 256; i++) {
+        if(card_index_get(&app->index, i, &summary) && !(summary.flags & HashRecordFlagRevoked)) {
+            ids[count++] = i;
+        }
+    }
+    return count;
+}
+
+// loads the stored card at emu_cards[pos], skipping cards whose file can't be read
+// and verifier records, which don't know the values ahead of them
+// returns false if none of the cards could be loaded
+static bool rfid_emulate_hash_load(RfidApp* app, uint16_t pos, int8_t step) {
+    HashData* temp_hash = arena_push(&app->scratch, sizeof(HashData));
+    for(uint16_t tries = 0; tries < app->emu_card_count; tries++) {
+        if(rfid_file_read(app, temp_hash, app->emu_cards[pos]) == 1 &&
+           !(temp_hash->flags & HashRecordFlagVerifier)) {
+            memcpy(app->hash_data, temp_hash, sizeof(HashData));
+            app->emu_card_pos = pos;
+            return true;
+        }
+        pos = (pos + app->emu_card_count + step) % app->emu_card_count;
+    }
+    return false;
+}
+
+static bool rfid_emulate_hash_start(RfidApp* app) {
+    app->emu_card_count = rfid_stored_cards(app, app->emu_cards);
+
+    if (!app->hash_data) {
+        app->hash_data = arena_push(&app->arena, sizeof(HashData));
+    }
+    if(app->emu_card_count == 0 || !rfid_emulate_hash_load(app, 0, 1)) {
+        furi_string_set(app->status_text, "No stored cards");
+        rfid_app_set_state(app, RfidAppStateHashError);
+        return false;
+    }
+    app->emu_advanced = false;
+    rfid_emulate_hash_value(app);
+    return true;
+}
+
+static void rfid_emulate_hash_advance(RfidApp* app) {
+    if(app->hash_data->curr_idx < app->hash_data->chain_len - 1) {
+        app->hash_data->curr_idx++;
+        app->emu_advanced = true;
+    }
+    rfid_emulate_hash_value(app);
+}
+
+static void rfid_emulate_hash_switch(RfidApp* app, int8_t step) {
+    rfid_emulate_hash_save(app);
+    uint16_t pos = (app->emu_card_pos + app->emu_card_count + step) % app->emu_card_count;
+    if(rfid_emulate_hash_load(app, pos, step)) {
+        rfid_emulate_hash_value(app);
+    }
+}
+
+// encodes a saved tag once, so switching to it later is only a pointer swap
+static void rfid_library_encode(RfidApp* app, uint8_t index) {
+    const SavedTag* tag = &app->library.tags[index];
+    uint32_t start = DWT->CYCCNT;
+    tag_library_set_data(tag, app->protocols);
+    app->library_streams[index] = emu_stream_encode(app->protocols, tag->protocol);
+    uint32_t cycles = DWT->CYCCNT - start;
+    if(cycles > app->library_encode_cycles) {
+        app->library_encode_cycles = cycles;
+    }
+    if(!app->library_streams[index]) {
+        FURI_LOG_W(TAG, "saved tag %u not cached, frame too long", tag->slot);
+    }
+}
+
+static void rfid_library_open(RfidApp* app) {
+    if(!app->library_loaded) {
+        tag_library_load(&app->library, app->storage, app->protocols, app->data_dir);
+        for(uint8_t i = 0; i < app->library.count; i++) {
+            rfid_library_encode(app, i);
+        }
+        app->emu_player = emu_player_alloc();
+        app->library_loaded = true;
+    }
+    virtual_list_init(&app->library_list, app->library.count, RFID_APP_LIBRARY_ROWS);
+}
+
+static void rfid_library_stop(RfidApp* app) {
+    emu_player_stop(app->emu_player);
+    lfrfid_worker_stop(app->worker);
+    app->library_playing = false;
+    app->library_switch_pending = false;
+}
+
+// emulates the selected tag. While a cached tag plays, another cached one only replaces the
+// stream the DMA refills copy from. Tags that couldn't be cached go through the worker
+static void rfid_library_play(RfidApp* app) {
+    uint16_t index = app->library_list.selected;
+    const EmuStream* stream = app->library_streams[index];
+    if(stream && emu_player_is_playing(app->emu_player)) {
+        emu_player_switch(app->emu_player, stream);
+        app->library_switch_pending = true;
+        return;
+    }
+
+    rfid_library_stop(app);
+    if(app->replaying) {
+        // nothing is emulated during a replay
+    } else if(stream) {
+        emu_player_start(app->emu_player, stream);
+    } else {
+        const SavedTag* tag = &app->library.tags[index];
+        tag_library_set_data(tag, app->protocols);
+        rfid_worker_emulate(app, (LFRFIDProtocol)tag->protocol);
+    }
+    app->library_playing = true;
+}
+
+static void rfid_library_free(RfidApp* app) {
+    if(!app->library_loaded) return;
+    emu_player_free(app->emu_player);
+    for(uint8_t i = 0; i < app->library.count; i++) {
+        emu_stream_free(app->library_streams[i]);
+    }
+    app->library_loaded = false;
+}
+
+// a replay can't take the pool's chains, they are seeded with random bytes. It derives them
+// from the replay clock instead, so every run of a trace creates the same cards
+static void rfid_next_chain(RfidApp* app, HashData* data) {
+    if(app->replaying) {
+        static const uint8_t nonce[CHAIN_POOL_NONCE_LEN] = {0};
+        chain_pool_generate_from(data, rfid_app_rtc(app), app->replay_chains++, nonce);
+    } else if(!chain_pool_pop(app->chain_pool, data)) {
+        chain_pool_generate(data);
+    }
 }
 
-static void rfid_create_hash_tag(RfidApp* app) {
-    // fill hash array with keys, with first generated key at end 
+// returns false if the card could not be set up, the state is already set to the error screen then
+static bool rfid_create_hash_tag(RfidApp* app) {
     if (!app->hash_data) {
-        app->hash_data = malloc(sizeof(HashData));
-    }
-    uint8_t buff[16];
-    DateTime datetime;
-    furi_hal_rtc_get_datetime(&datetime);
-    memcpy(buff, &datetime, sizeof(DateTime));
-    for (int i = 99; i >= 0; i--) {
-        // hash function gives 128 bits of data
-        // char outp[16];
-        sph_ripemd128_context* ctx = malloc(sizeof(sph_ripemd128_context));
-        sph_ripemd128_init(ctx); 	
-        sph_ripemd128(ctx, buff, sizeof(DateTime));
-        sph_ripemd128_close(ctx, buff);
-        free(ctx);
-        memcpy(&app->hash_data->hash_bytes[i], buff, 4);
-    }
-    app->hash_data->curr_idx = 0;
+        app->hash_data = arena_push(&app->arena, sizeof(HashData));
+    }
+    // a pre-generated chain skips hashing on the way to the write
+    rfid_next_chain(app, app->hash_data);
     int returnval = rfid_alloc_id(app);
     if (returnval < 0) {
         furi_string_printf(app->status_text, "ID alloc error %d", returnval);
-        app->state = RfidAppStateCreateError;
-        return;
+        rfid_app_set_state(app, RfidAppStateCreateError);
+        return false;
     }
     app->hash_data->card_id = (uint8_t) returnval;
     
     uint8_t card_data[5];
     card_data[0] = app->hash_data->card_id;
     #ifdef DEBUG
-    app->state = RfidAppStateDebugMsg;
+    rfid_app_set_state(app, RfidAppStateDebugMsg);
     furi_string_printf(app->status_text, "New Card %d", app->hash_data->card_id);
     furi_delay_ms(5000);
+    rfid_app_set_state(app, RfidAppStateCreateHT);
     #endif
     memcpy(&card_data[1], &app->hash_data->hash_bytes[app->hash_data->curr_idx], 4);
     furi_string_set(app->status_text, "Place card to write");
@@ -589,207 +940,2102 @@ static void rfid_create_hash_tag(RfidApp* app) {
     protocol_dict_set_data(app->protocols, LFRFIDProtocolEM4100, card_data, 5);
 
     // Start writing
-    lfrfid_worker_write_start(app->worker, LFRFIDProtocolEM4100, rfid_create_tag_callback, app);
+    rfid_worker_write(app, LFRFIDProtocolEM4100);
+    return true;
 }
 
+// fills the next group of batch cards, from the chain pool where it has chains ready
+static void rfid_batch_generate_group(RfidApp* app) {
+    for (uint16_t i = app->batch_written;
+        i < app->batch_reserved && i < app->batch_written + RFID_BATCH_GROUP; i++) {
+        HashData* data = &app->batch_chains[i % RFID_BATCH_GROUP];
+        rfid_next_chain(app, data);
+        data->card_id = app->batch_ids[i];
+    }
+}
 
-/*
-jank: original write_hash location
-static void rfid_write_hash_callback(LFRFIDWorkerWriteResult result, void* context) {
-    RfidApp* app = context;
-
-    if(result == LFRFIDWorkerWriteOK) {
-        app->state = RfidAppStateWriteHashSuccess;
-        beep();
-    } else {
-        app->state = RfidAppStateHashError;
-        furi_string_set(app->status_text, "Write failed. Yikes.");
-        error_beep();
-        // TODO: retry/error handling
-        // in this case would probably go back by one in the hash array
+// writes the records of all written cards that are not on storage yet
+// returns the number of records that could not be written
+static uint16_t rfid_batch_flush(RfidApp* app) {
+    uint16_t failed = 0;
+    for (; app->batch_flushed < app->batch_written; app->batch_flushed++) {
+        if (rfid_file_write(app, &app->batch_chains[app->batch_flushed % RFID_BATCH_GROUP], true) < 1) {
+            failed++;
+        }
     }
+    return failed;
 }
 
+// starts writing the next card of the batch, generating the next group of chains when needed
+static void rfid_batch_write_next(RfidApp* app) {
+    if (app->batch_written % RFID_BATCH_GROUP == 0) {
+        rfid_batch_generate_group(app);
+    }
+    HashData* data = &app->batch_chains[app->batch_written % RFID_BATCH_GROUP];
+    uint8_t card_data[5];
+    card_data[0] = data->card_id;
+    memcpy(&card_data[1], &data->hash_bytes[data->curr_idx], 4);
+    furi_string_set(app->status_text, "Place card to write");
+
+    protocol_dict_set_data(app->protocols, LFRFIDProtocolEM4100, card_data, 5);
+    rfid_worker_write(app, LFRFIDProtocolEM4100);
+}
+
+// flushes what was written and hands unused ids back to the allocator
+static void rfid_batch_finish(RfidApp* app) {
+    lfrfid_worker_stop(app->worker);
+    uint16_t failed = rfid_batch_flush(app);
+    if (app->batch_written < app->batch_reserved) {
+        rfid_dealloc_ids(
+            app, &app->batch_ids[app->batch_written], app->batch_reserved - app->batch_written);
+    }
+    if (failed) {
+        furi_string_printf(app->status_text, "%u records not saved", failed);
+    } else {
+        furi_string_reset(app->status_text);
+    }
+}
+
+// starts writing payload number clone_written of the sequence based on the captured tag
+static void rfid_clone_write_next(RfidApp* app) {
+    size_t len = protocol_dict_get_data_size(app->protocols, LFRFIDProtocolEM4100);
+    if(len > PAYLOAD_SEQ_MAX_LEN) {
+        len = PAYLOAD_SEQ_MAX_LEN;
+    }
+    payload_seq_get(app->clone_mode, app->tag_data, len, app->clone_step, app->clone_written, app->clone_payload);
+    furi_string_set(app->status_text, "Place card to write");
+
+    protocol_dict_set_data(app->protocols, LFRFIDProtocolEM4100, app->clone_payload, len);
+    rfid_worker_write(app, LFRFIDProtocolEM4100);
+}
+
+static void rfid_read_hash_tag(RfidApp* app) {
+    app->tag_found = false;
+    app->hash_read_start_tick = furi_get_tick();
+    app->hash_read_sensed_tick = 0;
+    if(app->hash_read_profile == RfidHashReadProfileEm4100) {
+        rfid_worker_read(app, LFRFIDWorkerReadTypeASKOnly, rfid_worker_hash_read_callback);
+    } else {
+        rfid_worker_read(app, LFRFIDWorkerReadTypeAuto, rfid_worker_hash_read_callback);
+    }
+}
+
+// time to decode of the read that just finished, counted from when the card was sensed
+// (from the start of the read if the worker never reported it)
+static void rfid_read_hash_stats(RfidApp* app) {
+    uint8_t profile = app->hash_read_profile;
+    uint32_t start = app->hash_read_sensed_tick ? app->hash_read_sensed_tick : app->hash_read_start_tick;
+    uint32_t ms = app->hash_read_done_tick - start;
+    app->hash_read_last_ms[profile] = ms;
+    app->hash_read_total_ms[profile] += ms;
+    app->hash_read_count[profile]++;
+    FURI_LOG_I(TAG, "%s read decoded in %lu ms, average %lu ms over %u reads",
+        profile == RfidHashReadProfileEm4100 ? "EM4100" : "Auto", ms,
+        app->hash_read_total_ms[profile] / app->hash_read_count[profile], app->hash_read_count[profile]);
+}
+
+
+// marks the picked cards revoked with a regular record write, so it survives a lost index
+// their files and ids are reclaimed later by rfid_compact_step
+// returns the number of cards that couldn't be revoked
+static uint16_t rfid_revoke_cards(RfidApp* app) {
+    HashData* temp_hash = arena_push(&app->scratch, sizeof(HashData));
+    uint16_t failed = 0;
+    for(uint16_t i = 0; i < 256; i++) {
+        if(!(app->browser_marked[i / 8] & (1 << (i % 8)))) {
+            continue;
+        }
+        if(rfid_file_read(app, temp_hash, i) != 1) {
+            failed++;
+            continue;
+        }
+        temp_hash->flags |= HashRecordFlagRevoked;
+        if(rfid_file_write(app, temp_hash, false) != 1) {
+            failed++;
+        }
+    }
+    memset(app->browser_marked, 0, sizeof(app->browser_marked));
+    app->browser_mark_count = 0;
+    return failed;
+}
+
+static bool rfid_index_save(RfidApp* app) {
+    char path[RFID_PATH_LEN];
+    rfid_data_path(app, path, sizeof(path), CARD_INDEX_FILE);
+    return card_index_save(&app->index, app->storage, path);
+}
+
+// slow path for a missing or damaged index, opens every stored card once
+// it can run inside an action (a replay opening its store), so only its own buffers are released
+static void rfid_index_rebuild(RfidApp* app) {
+    size_t mark = arena_mark(&app->scratch);
+    uint8_t* idarr = arena_push(&app->scratch, 256);
+    HashData* temp_hash = arena_push(&app->scratch, sizeof(HashData));
+    uint16_t orphans = 0;
+    card_index_clear(&app->index);
+    if (rfid_read_idarr(app, idarr) == 1) {
+        for (uint16_t i = 0; i < 256; i++) {
+            if (!idarr[i]) {
+                continue;
+            }
+            int8_t result = rfid_file_read(app, temp_hash, i);
+            if (result == 1) {
+                // when the card was last seen isn't stored in its files
+                card_index_set(&app->index, temp_hash, 0);
+            } else if (result == -1) {
+                // reserved without a file, left by a compaction or batch cut short
+                // orphans never passes i, so idarr doubles as the list of them
+                idarr[orphans++] = i;
+            }
+        }
+        if (orphans) {
+            rfid_dealloc_ids(app, idarr, orphans);
+        }
+    }
+    rfid_index_save(app);
+    arena_rewind(&app->scratch, mark);
+    FURI_LOG_I(TAG, "index rebuilt, %u cards", app->index.count);
+}
+
+// opens the card store in app->data_dir: a new store gets its id array, the index of an existing
+// one is loaded, or rebuilt from the card files
+static void rfid_store_open(RfidApp* app) {
+    char path[RFID_PATH_LEN];
+    rfid_data_path(app, path, sizeof(path), CARD_INDEX_FILE);
+    if (rfid_create_idarr(app) == 1) {
+        card_index_clear(&app->index);
+    } else if (!card_index_load(&app->index, app->storage, path)) {
+        rfid_index_rebuild(app);
+    }
+}
+
+// card records and the id array end in .hashrf
+static bool rfid_store_file(const char* name) {
+    size_t len = strlen(name);
+    return (len > 7 && strcmp(&name[len - 7], ".hashrf") == 0) || strcmp(name, CARD_INDEX_FILE) == 0 ||
+           strcmp(name, CARD_ARCHIVE_FILE) == 0;
+}
+
+// copies the files of the folder from into to, only those of the card store unless all is set
+static bool rfid_copy_files(RfidApp* app, const char* from, const char* to, bool all) {
+    File* dir = storage_file_alloc(app->storage);
+    FileInfo info;
+    char name[32];
+    char src[RFID_PATH_LEN];
+    char dst[RFID_PATH_LEN];
+    bool copied = storage_dir_open(dir, from);
+    while(copied && storage_dir_read(dir, &info, name, sizeof(name))) {
+        if(file_info_is_dir(&info) || !(all || rfid_store_file(name))) continue;
+        snprintf(src, sizeof(src), "%s/%s", from, name);
+        snprintf(dst, sizeof(dst), "%s/%s", to, name);
+        copied = storage_common_copy(app->storage, src, dst) == FSE_OK;
+    }
+    storage_dir_close(dir);
+    storage_file_free(dir);
+    return copied;
+}
+
+// replaces the card store in to with a copy of the one in from, saved tags included
+static bool rfid_store_copy(RfidApp* app, const char* from, const char* to) {
+    char from_tags[RFID_PATH_LEN];
+    char to_tags[RFID_PATH_LEN];
+    snprintf(from_tags, sizeof(from_tags), "%s/" TAG_LIBRARY_DIR, from);
+    snprintf(to_tags, sizeof(to_tags), "%s/" TAG_LIBRARY_DIR, to);
+    storage_simply_remove_recursive(app->storage, to);
+    if(!storage_simply_mkdir(app->storage, to) || !storage_simply_mkdir(app->storage, to_tags) ||
+       !rfid_copy_files(app, from, to, false)) {
+        return false;
+    }
+    // the tags folder only exists once the library was opened
+    return storage_common_stat(app->storage, from_tags, NULL) != FSE_OK ||
+           rfid_copy_files(app, from_tags, to_tags, true);
+}
+
+// removes the slot files of revoked cards and frees their ids with one id array write
+// stops picking up cards after RFID_COMPACT_SLICE_MS, the rest is left for the next step
+static void rfid_compact_step(RfidApp* app) {
+    uint8_t* ids = arena_push(&app->scratch, 256);
+    uint16_t count = 0;
+    uint32_t start = furi_get_tick();
+    CardSummary summary;
+    char path[RFID_PATH_LEN];
+
+    for(uint16_t i = 0; i < 256 && furi_get_tick() - start < furi_ms_to_ticks(RFID_COMPACT_SLICE_MS); i++) {
+        if(!card_index_get(&app->index, i, &summary) || !(summary.flags & HashRecordFlagRevoked)) {
+            continue;
+        }
+        // slot 0 goes last, it is what marks the card as existing
+        for(int8_t slot = 1; slot >= 0; slot--) {
+            rfid_file_slot_path(app, path, sizeof(path), i, slot);
+            storage_common_remove(app->storage, path);
+        }
+        ids[count++] = i;
+    }
+    // the index entries stay revoked until the ids are free, a failure is retried on the next step
+    if(count && rfid_dealloc_ids(app, ids, count) == 1) {
+        FURI_LOG_I(TAG, "compacted %u revoked cards", count);
+    }
+}
+
+// streams every stored card into the archive, holding one record in RAM at a time
+// returns the number of cards exported, -1 if the archive can't be written
+static int16_t rfid_export_cards(RfidApp* app) {
+    HashData* temp_hash = arena_push(&app->scratch, sizeof(HashData));
+    uint8_t* record = arena_push(&app->scratch, HASH_RECORD_MAX_SIZE);
+    CardArchive archive;
+    CardSummary summary;
+    int16_t exported = 0;
+
+    char path[RFID_PATH_LEN];
+    rfid_data_path(app, path, sizeof(path), CARD_ARCHIVE_FILE);
+    if(!card_archive_create(&archive, app->storage, path)) {
+        return -1;
+    }
+    for(uint16_t i = 0; i < 256; i++) {
+        if(!card_index_get(&app->index, i, &summary) || (summary.flags & HashRecordFlagRevoked) ||
+           rfid_file_read(app, temp_hash, i) != 1) {
+            continue;
+        }
+        size_t len = hash_record_encode(temp_hash, record, HASH_RECORD_MAX_SIZE);
+        if(!card_archive_write(&archive, record, len)) {
+            card_archive_close(&archive);
+            return -1;
+        }
+        exported++;
+    }
+    return card_archive_finish(&archive) ? exported : -1;
+}
+
+// adds the archived cards whose ids are free on this device, cards already here are skipped
+// the whole archive is checked against its CRC first, so a damaged one imports nothing
+// with verifier set every card is stored as a verifier record, cards a verifier can't walk are skipped
+// returns the number of cards imported, -1 if the archive is missing or damaged, -2 on an id array error
+static int16_t rfid_import_cards(RfidApp* app, bool verifier, uint16_t* skipped) {
+    HashData* temp_hash = arena_push(&app->scratch, sizeof(HashData));
+    uint8_t* record = arena_push(&app->scratch, HASH_RECORD_MAX_SIZE);
+    uint8_t* idarr = arena_push(&app->scratch, 256);
+    CardArchive archive;
+    int32_t len;
+    int16_t imported = 0;
+    *skipped = 0;
+    char path[RFID_PATH_LEN];
+    rfid_data_path(app, path, sizeof(path), CARD_ARCHIVE_FILE);
+
+    if(!card_archive_open(&archive, app->storage, path)) {
+        return -1;
+    }
+    // the first pass only runs the CRC over the whole archive
+    while((len = card_archive_read(&archive, record, HASH_RECORD_MAX_SIZE)) > 0) {
+    }
+    card_archive_close(&archive);
+    if(len < 0 || !archive.ended) {
+        return -1;
+    }
+
+    if(rfid_read_idarr(app, idarr) != 1 || !card_archive_open(&archive, app->storage, path)) {
+        return -2;
+    }
+    while((len = card_archive_read(&archive, record, HASH_RECORD_MAX_SIZE)) > 0) {
+        if(!hash_record_decode(temp_hash, record, len) || idarr[temp_hash->card_id] ||
+           (verifier && !(temp_hash->flags & HashRecordFlagVerifier) && !hash_chain_to_verifier(temp_hash)) ||
+           rfid_file_write(app, temp_hash, true) != 1) {
+            (*skipped)++;
+            continue;
+        }
+        idarr[temp_hash->card_id] = 1;
+        imported++;
+    }
+    card_archive_close(&archive);
+
+    if(imported && rfid_write_idarr(app, idarr) != 1) {
+        return -2;
+    }
+    return imported;
+}
+
+/*
+ * State machine actions. Each one runs on the main thread when its transition fires.
+ * Returning false rejects the transition, so the table's next state is not applied
+ * (either nothing happened or the action already picked a state itself).
+ */
+static bool rfid_app_action_exit(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    app->running = false;
+    return true;
+}
+
+static bool rfid_app_action_read_tag(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    rfid_read_tag(app);
+    return true;
+}
+
+static bool rfid_app_action_read_done(RfidApp* app, const RfidAppEvent* event) {
+    lfrfid_worker_stop(app->worker);
+    memcpy(app->tag_data, event->data, sizeof(app->tag_data));
+    app->tag_protocol = event->protocol;
+    app->tag_found = true;
+    furi_string_set(app->status_text, "Tag read successfully!");
+    beep();
+    return true;
+}
+
+static bool rfid_app_action_card_sensed(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    furi_string_set(app->status_text, "Card detected, reading...");
+    rfid_app_mark_dirty(app);
+    return true;
+}
+
+static bool rfid_app_action_card_removed(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    furi_string_set(app->status_text, "Card removed");
+    return true;
+}
+
+static bool rfid_app_action_stop_worker(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    return true;
+}
+
+static bool rfid_app_action_stop_emulate(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    beep(); // Notify user emulation has ended
+    return true;
+}
+
+static bool rfid_app_action_cancel_write(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    furi_string_set(app->status_text, "Writing cancelled");
+    error_beep();
+    return true;
+}
+
+static bool rfid_app_action_write_tag(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    return rfid_write_tag(app);
+}
+
+static bool rfid_app_action_write_done(RfidApp* app, const RfidAppEvent* event) {
+    lfrfid_worker_stop(app->worker);
+    if(event->type == RfidAppEventWriteOk) {
+        beep();
+    } else {
+        error_beep();
+        // TODO: retry/error handling
+    }
+    return true;
+}
+
+static bool rfid_app_action_emulate_tag(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    return rfid_emulate_tag(app);
+}
+
+static bool rfid_app_action_menu_up(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    virtual_list_move(&app->menu, -1);
+    return true;
+}
+
+static bool rfid_app_action_menu_down(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    virtual_list_move(&app->menu, 1);
+    return true;
+}
+
+static bool rfid_app_action_menu_select(RfidApp* app, const RfidAppEvent* event);
+static void rfid_app_reset(RfidApp* app);
+
+static bool rfid_app_action_offset_up(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    app->current_offset++; // wraps from 255 to 0
+    return true;
+}
+
+static bool rfid_app_action_offset_down(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    app->current_offset--; // wraps from 0 to 255
+    return true;
+}
+
+static bool rfid_app_action_input_load(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    // Initialize input data
+    if(app->tag_found) {
+        memcpy(app->input_bytes, app->tag_data, 8);
+    } else {
+        memset(app->input_bytes, 0, 8);
+    }
+    return true;
+}
+
+static bool rfid_app_action_input_byte_up(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    app->input_bytes[app->current_offset % 8]++;
+    return true;
+}
+
+static bool rfid_app_action_input_byte_down(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    app->input_bytes[app->current_offset % 8]--;
+    return true;
+}
+
+static bool rfid_app_action_input_prev(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    // Move to previous byte, wrapping around to the last one
+    app->current_offset = (app->current_offset > 0) ? app->current_offset - 1 : 7;
+    return true;
+}
+
+static bool rfid_app_action_input_next(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    // Move to next byte, wrapping around to the first one
+    app->current_offset = (app->current_offset < 7) ? app->current_offset + 1 : 0;
+    return true;
+}
+
+static bool rfid_app_action_input_commit(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    memcpy(app->tag_data, app->input_bytes, 8);
+    app->tag_protocol = LFRFIDProtocolHidGeneric; // what Emulate Tag presents it as
+    app->tag_found = true; // We now have valid data
+    return true;
+}
+
+static bool rfid_app_action_create_hash_tag(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    return rfid_create_hash_tag(app);
+}
+
+static bool rfid_app_action_create_done(RfidApp* app, const RfidAppEvent* event) {
+    lfrfid_worker_stop(app->worker);
+    if(event->type == RfidAppEventWriteOk) {
+        rfid_app_set_state(app, RfidAppStateCreateSuccess);
+        rfid_file_write(app, app->hash_data, true);
+        beep();
+    } else {
+        furi_string_set(app->status_text, "Write error");
+        rfid_dealloc_id(app, app->hash_data->card_id);
+        rfid_app_set_state(app, RfidAppStateCreateError);
+        error_beep();
+    }
+    return false;
+}
+
+static bool rfid_app_action_create_cancel(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    rfid_dealloc_id(app, app->hash_data->card_id);
+    return true;
+}
+
+static bool rfid_app_action_read_hash_tag(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    rfid_read_hash_tag(app);
+    return true;
+}
+
+static bool rfid_app_action_hash_read_profile(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    app->hash_read_profile = (app->hash_read_profile + 1) % RfidHashReadProfileCount;
+    rfid_read_hash_tag(app);
+    return true;
+}
+
+// HashTags are always EM4100. Under the EM4100 profile another tag's frame (a building fob in
+// the field next to the card) restarts the read and is otherwise ignored
+static bool rfid_hash_read_foreign(RfidApp* app, const RfidAppEvent* event) {
+    if(app->hash_read_profile != RfidHashReadProfileEm4100 || event->protocol == LFRFIDProtocolEM4100) {
+        return false;
+    }
+    lfrfid_worker_stop(app->worker);
+    rfid_worker_read(app, LFRFIDWorkerReadTypeASKOnly, rfid_worker_hash_read_callback);
+    return true;
+}
+
+static bool rfid_app_action_hash_read_done(RfidApp* app, const RfidAppEvent* event) {
+    if(rfid_hash_read_foreign(app, event)) {
+        return true;
+    }
+    lfrfid_worker_stop(app->worker);
+    rfid_read_hash_stats(app);
+    memcpy(app->tag_data, event->data, sizeof(app->tag_data));
+    app->tag_protocol = event->protocol;
+
+    // unknown, revoked and stale values are turned away by the index without opening a file
+    uint32_t start = DWT->CYCCNT;
+    bool may_match = card_index_may_match(&app->index, app->tag_data[0], &app->tag_data[1]);
+    uint32_t cycles = DWT->CYCCNT - start;
+    HashData* temp_hash = arena_push(&app->scratch, sizeof(HashData));
+    int8_t read_result = 0;
+    bool file_read = false;
+    if (!may_match && !card_index_is_checked(&app->index, app->tag_data[0])) {
+        // the entry may be from before the last record write, the file has the final word
+        read_result = rfid_file_read(app, temp_hash, app->tag_data[0]);
+        file_read = true;
+        if (read_result != 0) {
+            card_index_check(&app->index, app->tag_data[0], read_result == 1 ? temp_hash : NULL);
+        }
+        may_match = card_index_may_match(&app->index, app->tag_data[0], &app->tag_data[1]);
+    }
+    if (!may_match) {
+        CardSummary summary;
+        if (!card_index_get(&app->index, app->tag_data[0], &summary)) {
+            furi_string_set(app->status_text, "Card does not exist");
+            rfid_audit_add(app, app->tag_data[0], 0, AuditResultUnknown);
+        } else if (summary.flags & HashRecordFlagRevoked) {
+            furi_string_set(app->status_text, "Card revoked");
+            rfid_audit_add(app, app->tag_data[0], summary.curr_idx, AuditResultRevoked);
+        } else {
+            furi_string_set(app->status_text, "Card key did not match expected");
+            rfid_audit_add(app, app->tag_data[0], summary.curr_idx, AuditResultStale);
+            error_beep();
+        }
+        FURI_LOG_I(TAG, "card %u rejected by the index in %lu cycles", app->tag_data[0], cycles);
+        rfid_app_set_state(app, RfidAppStateHashError);
+        return false;
+    }
+
+    if (!file_read) {
+        read_result = rfid_file_read(app, temp_hash, app->tag_data[0]);
+    }
+
+    if (read_result != 1){
+        if (read_result == -1) {
+            furi_string_set(app->status_text, "Card does not exist");
+            rfid_audit_add(app, app->tag_data[0], 0, AuditResultUnknown);
+        } else {
+            furi_string_set(app->status_text, "File read error");
+            rfid_audit_add(app, app->tag_data[0], 0, AuditResultStorageError);
+        }
+        rfid_app_set_state(app, RfidAppStateHashError);
+        return false;
+    }
+    if (temp_hash->flags & HashRecordFlagRevoked) {
+        furi_string_set(app->status_text, "Card revoked");
+        rfid_audit_add(app, temp_hash->card_id, temp_hash->curr_idx, AuditResultRevoked);
+        rfid_app_set_state(app, RfidAppStateHashError);
+        return false;
+    }
+    if (!app->hash_data) {
+        app->hash_data = arena_push(&app->arena, sizeof(HashData));
+    }
+    memcpy(app->hash_data, temp_hash, sizeof(HashData));
+    // the value stays on screen for RFID_HASH_SHOW_MS, the tick transition then checks it
+    // TODO: Switch to input key to let person abort?
+    rfid_app_set_state(app, RfidAppStateReadingHashSuccess);
+    return false;
+}
+
+// verifier records can't write the card, they accept the value it presents if it leads to the
+// anchor within HASH_VERIFY_RESYNC steps and keep it as the new anchor
+static void rfid_verify_anchor(RfidApp* app) {
+    uint8_t steps = hash_chain_verify(app->hash_data, &app->tag_data[1]);
+    if (!steps) {
+        furi_string_set(app->status_text, "Card value stale or unknown");
+        rfid_audit_add(app, app->hash_data->card_id, app->hash_data->curr_idx, AuditResultStale);
+        app->tag_found = false;
+        rfid_app_set_state(app, RfidAppStateHashError);
+        error_beep();
+        return;
+    }
+    if (rfid_file_write(app, app->hash_data, false) < 1) {
+        furi_string_set(app->status_text, "Card writeback unsuccessful");
+        rfid_audit_add(app, app->hash_data->card_id, app->hash_data->curr_idx, AuditResultStorageError);
+        rfid_app_set_state(app, RfidAppStateHashError);
+        error_beep();
+        return;
+    }
+    rfid_audit_add(app, app->hash_data->card_id, app->hash_data->curr_idx, AuditResultAccepted);
+    if (steps > 1) {
+        furi_string_printf(app->status_text, "Caught up %u values", steps - 1);
+    } else {
+        furi_string_reset(app->status_text);
+    }
+    app->tag_found = true;
+    rfid_app_set_state(app, RfidAppStateWriteHashSuccess);
+    beep();
+}
+
+static bool rfid_app_action_hash_verify(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    if(rfid_app_now(app) - app->state_enter_tick < furi_ms_to_ticks(RFID_HASH_SHOW_MS)) {
+        return false;
+    }
+
+    if (app->hash_data->flags & HashRecordFlagVerifier) {
+        rfid_verify_anchor(app);
+        return false;
+    }
+
+    // validate that read value matches what's expected
+    if (memcmp(&app->hash_data->hash_bytes[app->hash_data->curr_idx], &app->tag_data[1], 4) == 0) {
+        // card hash matches what's expected, now to write the new value to the card
+        app->tag_found = true;
+        rfid_app_set_state(app, RfidAppStateWriteHash);
+        rfid_write_hash(app);
+    } else {
+        //TODO may add code to check future vals
+        furi_string_set(app->status_text, "Card key did not match expected");
+        rfid_audit_add(app, app->hash_data->card_id, app->hash_data->curr_idx, AuditResultStale);
+        app->tag_found = false;
+        rfid_app_set_state(app, RfidAppStateHashError);
+        error_beep();
+    }
+    return false;
+}
+
+static bool rfid_app_action_hash_write_done(RfidApp* app, const RfidAppEvent* event) {
+    lfrfid_worker_stop(app->worker);
+    app->hash_delta_pending = false;
+    FURI_LOG_I(TAG, "card write finished after %lu ms", rfid_app_now(app) - app->state_enter_tick);
+    if(event->type != RfidAppEventWriteOk) {
+        furi_string_set(app->status_text, "Write failed. Yikes.");
+        rfid_audit_add(app, app->hash_data->card_id, app->hash_data->curr_idx, AuditResultWriteFailed);
+        rfid_app_set_state(app, RfidAppStateHashError);
+        error_beep();
+        // TODO: retry/error handling
+        // in this case would probably go back by one in the hash array
+        return false;
+    }
+
+    int8_t result = rfid_file_write(app, app->hash_data, false);
+    if (result < 1) {
+        if (result == 0) {
+            furi_string_set(app->status_text, "Card writeback unsuccessful");
+        } else {
+            furi_string_set(app->status_text, "Card write: Didn't exist");
+        }
+        rfid_audit_add(app, app->hash_data->card_id, app->hash_data->curr_idx, AuditResultStorageError);
+        rfid_app_set_state(app, RfidAppStateHashError);
+        error_beep();
+        return false;
+    }
+    rfid_audit_add(app, app->hash_data->card_id, app->hash_data->curr_idx, AuditResultAccepted);
+    rfid_app_set_state(app, RfidAppStateWriteHashSuccess);
+    beep();
+    return false;
+}
+
+// the read back after a delta write: the new frame completes the write like the worker's write
+// would, the old frame of a card that didn't take it falls back to a full write. Another
+// protocol's frame restarts the read, RFID_DELTA_VERIFY_MS still bounds the wait
+static bool rfid_app_action_hash_delta_check(RfidApp* app, const RfidAppEvent* event) {
+    if (!app->hash_delta_pending) {
+        return false;
+    }
+    if (event->protocol != LFRFIDProtocolEM4100) {
+        lfrfid_worker_stop(app->worker);
+        rfid_worker_read(app, LFRFIDWorkerReadTypeASKOnly, rfid_worker_hash_read_callback);
+        return false;
+    }
+    if (event->data[0] == app->hash_data->card_id &&
+        memcmp(&event->data[1], &app->hash_data->hash_bytes[app->hash_data->curr_idx], 4) == 0) {
+        const RfidAppEvent done = {.type = RfidAppEventWriteOk};
+        return rfid_app_action_hash_write_done(app, &done);
+    }
+    FURI_LOG_W(TAG, "delta write not taken, writing all blocks");
+    lfrfid_worker_stop(app->worker);
+    rfid_write_hash_full(app);
+    return false;
+}
+
+static bool rfid_app_action_hash_delta_tick(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    if (!app->hash_delta_pending ||
+        rfid_app_now(app) - app->hash_delta_tick < furi_ms_to_ticks(RFID_DELTA_VERIFY_MS)) {
+        return false;
+    }
+    FURI_LOG_W(TAG, "no read back after delta write, writing all blocks");
+    lfrfid_worker_stop(app->worker);
+    rfid_write_hash_full(app);
+    return false;
+}
+
+static bool rfid_app_action_batch_count_up(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    app->batch_size = (app->batch_size < RFID_BATCH_MAX) ? app->batch_size + 1 : 1;
+    return true;
+}
+
+static bool rfid_app_action_batch_count_down(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    app->batch_size = (app->batch_size > 1) ? app->batch_size - 1 : RFID_BATCH_MAX;
+    return true;
+}
+
+static bool rfid_app_action_batch_start(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    int16_t reserved = rfid_alloc_ids(app, app->batch_ids, app->batch_size);
+    if (reserved < 1) {
+        furi_string_printf(app->status_text, "ID alloc error %d", reserved);
+        rfid_app_set_state(app, RfidAppStateHashError);
+        return false;
+    }
+    app->batch_reserved = reserved;
+    app->batch_written = 0;
+    app->batch_flushed = 0;
+    if (!app->batch_chains) {
+        app->batch_chains = arena_push(&app->arena, sizeof(HashData) * RFID_BATCH_GROUP);
+    }
+    rfid_batch_write_next(app);
+    return true;
+}
+
+// the worker's read mode ends with the first decoded frame, so the card that was just written
+// keeps being read from scratch until nothing has come from it for RFID_PRESENCE_GONE_MS
+static void rfid_presence_start(RfidApp* app) {
+    app->presence_tick = rfid_app_now(app);
+    rfid_worker_read(app, LFRFIDWorkerReadTypeASKOnly, rfid_worker_read_callback);
+}
+
+static bool rfid_presence_gone(RfidApp* app) {
+    return rfid_app_now(app) - app->presence_tick >= furi_ms_to_ticks(RFID_PRESENCE_GONE_MS);
+}
+
+static bool rfid_app_action_presence_seen(RfidApp* app, const RfidAppEvent* event) {
+    if(event->type == RfidAppEventReadDone) {
+        lfrfid_worker_stop(app->worker);
+        rfid_presence_start(app);
+    } else {
+        app->presence_tick = rfid_app_now(app);
+    }
+    return true;
+}
 
+static bool rfid_app_action_batch_written(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    beep();
+    app->batch_written++;
+    if (app->batch_written == app->batch_reserved) {
+        rfid_batch_finish(app);
+        rfid_app_set_state(app, RfidAppStateBatchDone);
+        return false;
+    }
+    if (app->batch_written % RFID_BATCH_GROUP == 0) {
+        rfid_batch_flush(app);
+    }
+    // read mode only serves as presence detection, the next write starts once the card is gone
+    rfid_presence_start(app);
+    return true;
+}
+
+static bool rfid_app_action_batch_write_failed(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    // the worker keeps trying, just let the user know the card is not taking it yet
+    furi_string_set(app->status_text, "Write failed, retrying");
+    return true;
+}
+
+static bool rfid_app_action_batch_next(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    rfid_batch_write_next(app);
+    return true;
+}
+
+static bool rfid_app_action_batch_gone(RfidApp* app, const RfidAppEvent* event) {
+    if(!rfid_presence_gone(app)) {
+        return false;
+    }
+    return rfid_app_action_batch_next(app, event);
+}
+
+static bool rfid_app_action_batch_finish(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    rfid_batch_finish(app);
+    return true;
+}
+
+static bool rfid_app_action_emulate_hash(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    return rfid_emulate_hash_start(app);
+}
+
+static bool rfid_app_action_emulate_hash_next(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    rfid_emulate_hash_advance(app);
+    return true;
+}
+
+static bool rfid_app_action_emulate_hash_auto(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    app->emu_auto = (app->emu_auto + 1) % COUNT_OF(rfid_emu_auto_ms);
+    app->emu_last_advance = rfid_app_now(app);
+    return true;
+}
+
+static bool rfid_app_action_emulate_hash_tick(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    uint16_t period = rfid_emu_auto_ms[app->emu_auto];
+    if(period == 0 || rfid_app_now(app) - app->emu_last_advance < furi_ms_to_ticks(period)) {
+        return false;
+    }
+    rfid_emulate_hash_advance(app);
+    rfid_app_mark_dirty(app);
+    return true;
+}
+
+static bool rfid_app_action_emulate_hash_card_prev(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    rfid_emulate_hash_switch(app, -1);
+    return true;
+}
+
+static bool rfid_app_action_emulate_hash_card_next(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    rfid_emulate_hash_switch(app, 1);
+    return true;
+}
+
+static bool rfid_app_action_emulate_hash_stop(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    rfid_emulate_hash_save(app);
+    return true;
+}
+
+static bool rfid_app_action_library_open(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    rfid_library_open(app);
+    return true;
+}
+
+static bool rfid_app_action_library_move(RfidApp* app, const RfidAppEvent* event) {
+    if(virtual_list_move(&app->library_list, event->type == RfidAppEventUp ? -1 : 1) &&
+       app->library_playing) {
+        rfid_library_play(app);
+    }
+    return true;
+}
+
+static bool rfid_app_action_library_play(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    if(app->library_playing) {
+        rfid_library_stop(app);
+    } else if(app->library.count) {
+        rfid_library_play(app);
+    } else {
+        error_beep();
+    }
+    return true;
+}
+
+// saves the tag last read or entered
+static bool rfid_app_action_library_save(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    if(!app->tag_found) {
+        error_beep();
+        return false;
+    }
+    size_t data_size = protocol_dict_get_data_size(app->protocols, app->tag_protocol);
+    if(data_size > sizeof(app->tag_data)) {
+        // the read kept only the first bytes of this protocol's payload
+        FURI_LOG_W(TAG, "not saving a %zu byte tag, only %zu bytes were kept", data_size, sizeof(app->tag_data));
+        error_beep();
+        return false;
+    }
+    rfid_library_stop(app);
+    int8_t index = tag_library_add(
+        &app->library, app->protocols, app->tag_protocol, app->tag_data, data_size);
+    if(index < 0) {
+        error_beep();
+        return false;
+    }
+    memmove(
+        &app->library_streams[index + 1],
+        &app->library_streams[index],
+        sizeof(EmuStream*) * (app->library.count - 1 - index));
+    rfid_library_encode(app, index);
+    virtual_list_init(&app->library_list, app->library.count, RFID_APP_LIBRARY_ROWS);
+    virtual_list_move(&app->library_list, index);
+    beep();
+    return true;
+}
+
+static bool rfid_app_action_library_remove(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    uint16_t index = app->library_list.selected;
+    rfid_library_stop(app);
+    if(!app->library.count || !tag_library_remove(&app->library, app->storage, index)) {
+        error_beep();
+        return false;
+    }
+    emu_stream_free(app->library_streams[index]);
+    memmove(
+        &app->library_streams[index],
+        &app->library_streams[index + 1],
+        sizeof(EmuStream*) * (app->library.count - index));
+    virtual_list_init(&app->library_list, app->library.count, RFID_APP_LIBRARY_ROWS);
+    virtual_list_move(&app->library_list, index);
+    return true;
+}
+
+// picks up the timing once the player has taken over the new tag
+static bool rfid_app_action_library_tick(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    uint32_t cycles = emu_player_switch_cycles(app->emu_player);
+    if(app->library_switch_pending && cycles) {
+        app->library_switch_pending = false;
+        app->library_switch_cycles = cycles;
+        FURI_LOG_I(
+            TAG,
+            "tag switch in %lu us, encoding took %lu us",
+            cycles / furi_hal_cortex_instructions_per_microsecond(),
+            app->library_encode_cycles / furi_hal_cortex_instructions_per_microsecond());
+        rfid_app_mark_dirty(app);
+    }
+    return true;
+}
+
+static bool rfid_app_action_library_close(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    rfid_library_stop(app);
+    return true;
+}
+
+// audit query ranges, 0 = the whole log
+static const uint16_t rfid_audit_range_days[] = {1, 7, 30, 0};
+
+static bool rfid_app_action_audit_card(RfidApp* app, const RfidAppEvent* event) {
+    // -1 (every card) sits before card 0 and wraps around to 255
+    int16_t step = event->type == RfidAppEventUp ? 1 : -1;
+    app->audit_card = (app->audit_card + 1 + step + 257) % 257 - 1;
+    return true;
+}
+
+static bool rfid_app_action_audit_range(RfidApp* app, const RfidAppEvent* event) {
+    int8_t step = event->type == RfidAppEventRight ? 1 : -1;
+    app->audit_range = (app->audit_range + COUNT_OF(rfid_audit_range_days) + step) %
+                       COUNT_OF(rfid_audit_range_days);
+    return true;
+}
+
+// keeps the newest RFID_AUDIT_RESULTS matches, they arrive oldest first
+static void rfid_audit_result_callback(const AuditRecord* record, void* context) {
+    RfidApp* app = context;
+    if(app->audit_result_count == RFID_AUDIT_RESULTS) {
+        memmove(&app->audit_results[0], &app->audit_results[1], sizeof(AuditRecord) * (RFID_AUDIT_RESULTS - 1));
+        app->audit_result_count--;
+    }
+    app->audit_results[app->audit_result_count++] = *record;
+}
+
+static bool rfid_app_action_audit_search(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    uint32_t to = rfid_app_rtc(app);
+    uint32_t days = rfid_audit_range_days[app->audit_range];
+    uint32_t from = (days && to > days * 24 * 60 * 60) ? to - days * 24 * 60 * 60 : 0;
+
+    app->audit_result_count = 0;
+    uint32_t start = furi_get_tick();
+    if(app->replaying) {
+        // the real log isn't part of a replay, its queries come back empty
+        memset(&app->audit_stats, 0, sizeof(app->audit_stats));
+        app->audit_query_ok = true;
+    } else {
+        app->audit_query_ok = audit_log_query(
+            app->audit_log, app->audit_card, from, to, rfid_audit_result_callback, app, &app->audit_stats);
+    }
+    app->audit_query_ms = furi_get_tick() - start;
+    FURI_LOG_I(TAG, "audit query: %lu matches, %u of %u blocks read in %lu ms",
+        app->audit_stats.matched, app->audit_stats.blocks_read, app->audit_stats.blocks_total, app->audit_query_ms);
+    virtual_list_init(&app->audit_list, app->audit_result_count, RFID_APP_AUDIT_ROWS);
+    return true;
+}
+
+static bool rfid_app_action_audit_up(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    virtual_list_move(&app->audit_list, -1);
+    return true;
+}
+
+static bool rfid_app_action_audit_down(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    virtual_list_move(&app->audit_list, 1);
+    return true;
+}
+
+static bool rfid_app_action_replay_start(RfidApp* app, const RfidAppEvent* event) {
+    if(app->trace_rec) {
+        // the trace file is this session's recording
+        error_beep();
+        return false;
+    }
+    app->trace_play = event_trace_alloc(app->storage);
+    if(!event_trace_replay(app->trace_play, RFID_TRACE_PATH) ||
+       !event_trace_next(app->trace_play, &app->replay_next) ||
+       !rfid_store_copy(app, RFID_TRACE_STORE_DIR, RFID_REPLAY_DIR)) {
+        event_trace_free(app->trace_play);
+        app->trace_play = NULL;
+        error_beep();
+        return false;
+    }
+    lfrfid_worker_stop(app->worker);
+    if(app->library_loaded) {
+        rfid_library_stop(app);
+        rfid_library_free(app);
+    }
+    // a copy of the card store as it was when the recording started and the state a session
+    // starts in, so every run of a trace ends the same way and the real cards stay untouched
+    app->data_dir = RFID_REPLAY_DIR;
+    rfid_store_open(app);
+    rfid_app_reset(app);
+    app->replay_real_speed = event->type == RfidAppEventOk;
+    app->replay_aborted = false;
+    app->replay_rec_start = event_trace_start_tick(app->trace_play);
+    app->replay_rec_time = event_trace_start_time(app->trace_play);
+    app->replay_tick = app->replay_rec_start;
+    app->replay_start = furi_get_tick();
+    app->replay_events = 0;
+    app->replay_cycles = 0;
+    app->replay_max_cycles = 0;
+    app->replay_chains = 0;
+    memset(app->replay_taps, 0, sizeof(app->replay_taps));
+    app->replaying = true;
+    rfid_app_set_state(app, RfidAppStateIdle);
+    return true;
+}
+
+static bool rfid_app_action_browse_cards(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    memset(app->browser_marked, 0, sizeof(app->browser_marked));
+    app->browser_mark_count = 0;
+    // everything shown comes from the card index, no card file is opened
+    virtual_list_init(&app->browser, rfid_stored_cards(app, app->browser_cards), RFID_APP_BROWSER_ROWS);
+    return true;
+}
+
+static bool rfid_app_action_export_cards(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    int16_t exported = rfid_export_cards(app);
+    if(exported < 0) {
+        furi_string_set(app->status_text, "Can't write archive");
+        rfid_app_set_state(app, RfidAppStateHashError);
+        return false;
+    }
+    furi_string_printf(app->status_text, "Exported %d cards", exported);
+    return true;
+}
+
+static bool rfid_app_import(RfidApp* app, bool verifier) {
+    uint16_t skipped;
+    int16_t imported = rfid_import_cards(app, verifier, &skipped);
+    if(imported < 0) {
+        furi_string_set(app->status_text, imported == -1 ? "Archive missing or damaged" : "Can't update card ids");
+        rfid_app_set_state(app, RfidAppStateHashError);
+        return false;
+    }
+    furi_string_printf(app->status_text, "Imported %d, skipped %u", imported, skipped);
+    return true;
+}
+
+static bool rfid_app_action_import_cards(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    return rfid_app_import(app, false);
+}
+
+static bool rfid_app_action_import_verifiers(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    return rfid_app_import(app, true);
+}
+
+static bool rfid_app_action_clone_value_up(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    if(app->clone_field == RfidCloneFieldMode) {
+        app->clone_mode = (app->clone_mode + 1) % PayloadSeqCount;
+    } else if(app->clone_field == RfidCloneFieldStep) {
+        app->clone_step = (app->clone_step < UINT16_MAX) ? app->clone_step + 1 : 1;
+    } else {
+        app->clone_count = (app->clone_count < RFID_CLONE_MAX) ? app->clone_count + 1 : 1;
+    }
+    return true;
+}
+
+static bool rfid_app_action_clone_value_down(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    if(app->clone_field == RfidCloneFieldMode) {
+        app->clone_mode = (app->clone_mode + PayloadSeqCount - 1) % PayloadSeqCount;
+    } else if(app->clone_field == RfidCloneFieldStep) {
+        app->clone_step = (app->clone_step > 1) ? app->clone_step - 1 : UINT16_MAX;
+    } else {
+        app->clone_count = (app->clone_count > 1) ? app->clone_count - 1 : RFID_CLONE_MAX;
+    }
+    return true;
+}
+
+static bool rfid_app_action_clone_field_prev(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    app->clone_field = (app->clone_field + RfidCloneFieldNum - 1) % RfidCloneFieldNum;
+    return true;
+}
+
+static bool rfid_app_action_clone_field_next(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    app->clone_field = (app->clone_field + 1) % RfidCloneFieldNum;
+    return true;
+}
+
+// the captured or entered tag is the base of the sequence
+static bool rfid_app_action_clone_start(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    if(!app->tag_found) {
+        error_beep();
+        return false;
+    }
+    app->clone_written = 0;
+    app->clone_start_tick = rfid_app_now(app);
+    app->clone_last_tick = app->clone_start_tick;
+    rfid_clone_write_next(app);
+    return true;
+}
+
+static bool rfid_app_action_clone_written(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    beep();
+    app->clone_written++;
+    app->clone_last_tick = rfid_app_now(app);
+    if(app->clone_written == app->clone_count) {
+        rfid_app_set_state(app, RfidAppStateCloneDone);
+        return false;
+    }
+    // same presence detection as the batch, the next write starts once the card is gone
+    rfid_presence_start(app);
+    return true;
+}
+
+static bool rfid_app_action_clone_next(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    rfid_clone_write_next(app);
+    return true;
+}
+
+static bool rfid_app_action_clone_gone(RfidApp* app, const RfidAppEvent* event) {
+    if(!rfid_presence_gone(app)) {
+        return false;
+    }
+    return rfid_app_action_clone_next(app, event);
+}
+
+static bool rfid_app_action_clone_finish(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    lfrfid_worker_stop(app->worker);
+    return true;
+}
+
+// times one chain step of every backend with the cycle counter, at the step length its chains
+// use: 4 bytes for the keyed backend, whose chains are short step, 10 for the others
+static bool rfid_app_action_benchmark(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    uint8_t buff[HASH_BACKEND_DIGEST_LEN] = {0};
+    for(uint8_t id = 0; id < HashBackendCount; id++) {
+        const HashBackend* hash = hash_backend_get(id);
+        if(!hash) {
+            continue;
+        }
+        size_t step_len =
+            id == HashBackendRipemd128Keyed ? HASH_CHAIN_SHORT_STEP_LEN : HASH_CHAIN_STEP_LEN;
+        uint32_t start = DWT->CYCCNT;
+        for(uint16_t i = 0; i < RFID_BENCH_STEPS; i++) {
+            hash->digest(buff, step_len, buff);
+        }
+        app->bench_cycles[id] = (DWT->CYCCNT - start) / RFID_BENCH_STEPS;
+        FURI_LOG_I(
+            TAG,
+            "%s: %lu cycles per %u byte step, %u bytes state",
+            hash->name,
+            app->bench_cycles[id],
+            step_len,
+            hash->state_size);
+    }
+    return true;
+}
+
+static bool rfid_app_action_browser_mark(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    if(app->browser.count == 0) {
+        return false;
+    }
+    uint8_t card_id = app->browser_cards[app->browser.selected];
+    app->browser_marked[card_id / 8] ^= 1 << (card_id % 8);
+    if(app->browser_marked[card_id / 8] & (1 << (card_id % 8))) {
+        app->browser_mark_count++;
+    } else {
+        app->browser_mark_count--;
+    }
+    return true;
+}
+
+// asks before revoking the marked cards, or the selected one if none are marked
+static bool rfid_app_action_revoke_ask(RfidApp* app, const RfidAppEvent* event) {
+    if(app->browser.count == 0) {
+        return false;
+    }
+    if(app->browser_mark_count == 0) {
+        rfid_app_action_browser_mark(app, event);
+    }
+    return true;
+}
+
+static bool rfid_app_action_revoke(RfidApp* app, const RfidAppEvent* event) {
+    uint16_t failed = rfid_revoke_cards(app);
+    rfid_app_action_browse_cards(app, event);
+    if(failed) {
+        furi_string_printf(app->status_text, "%u cards not revoked", failed);
+        rfid_app_set_state(app, RfidAppStateHashError);
+        return false;
+    }
+    return true;
+}
+
+static bool rfid_app_action_browser_up(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    virtual_list_move(&app->browser, -1);
+    return true;
+}
+
+static bool rfid_app_action_browser_down(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    virtual_list_move(&app->browser, 1);
+    return true;
+}
+
+static bool rfid_app_action_browser_page_up(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    virtual_list_move(&app->browser, -RFID_APP_BROWSER_ROWS);
+    return true;
+}
+
+static bool rfid_app_action_browser_page_down(RfidApp* app, const RfidAppEvent* event) {
+    UNUSED(event);
+    virtual_list_move(&app->browser, RFID_APP_BROWSER_ROWS);
+    return true;
+}
+
+static const RfidAppActionHandler rfid_app_actions[RfidAppActionCount] = {
+    [RfidAppActionNone] = NULL,
+    [RfidAppActionExit] = rfid_app_action_exit,
+    [RfidAppActionReadTag] = rfid_app_action_read_tag,
+    [RfidAppActionReadDone] = rfid_app_action_read_done,
+    [RfidAppActionCardSensed] = rfid_app_action_card_sensed,
+    [RfidAppActionCardRemoved] = rfid_app_action_card_removed,
+    [RfidAppActionStopWorker] = rfid_app_action_stop_worker,
+    [RfidAppActionStopEmulate] = rfid_app_action_stop_emulate,
+    [RfidAppActionCancelWrite] = rfid_app_action_cancel_write,
+    [RfidAppActionWriteTag] = rfid_app_action_write_tag,
+    [RfidAppActionWriteDone] = rfid_app_action_write_done,
+    [RfidAppActionEmulateTag] = rfid_app_action_emulate_tag,
+    [RfidAppActionMenuUp] = rfid_app_action_menu_up,
+    [RfidAppActionMenuDown] = rfid_app_action_menu_down,
+    [RfidAppActionMenuSelect] = rfid_app_action_menu_select,
+    [RfidAppActionOffsetUp] = rfid_app_action_offset_up,
+    [RfidAppActionOffsetDown] = rfid_app_action_offset_down,
+    [RfidAppActionInputLoad] = rfid_app_action_input_load,
+    [RfidAppActionInputByteUp] = rfid_app_action_input_byte_up,
+    [RfidAppActionInputByteDown] = rfid_app_action_input_byte_down,
+    [RfidAppActionInputPrev] = rfid_app_action_input_prev,
+    [RfidAppActionInputNext] = rfid_app_action_input_next,
+    [RfidAppActionInputCommit] = rfid_app_action_input_commit,
+    [RfidAppActionCreateHashTag] = rfid_app_action_create_hash_tag,
+    [RfidAppActionCreateDone] = rfid_app_action_create_done,
+    [RfidAppActionCreateCancel] = rfid_app_action_create_cancel,
+    [RfidAppActionReadHashTag] = rfid_app_action_read_hash_tag,
+    [RfidAppActionHashReadDone] = rfid_app_action_hash_read_done,
+    [RfidAppActionHashReadProfile] = rfid_app_action_hash_read_profile,
+    [RfidAppActionHashVerify] = rfid_app_action_hash_verify,
+    [RfidAppActionHashWriteDone] = rfid_app_action_hash_write_done,
+    [RfidAppActionHashDeltaCheck] = rfid_app_action_hash_delta_check,
+    [RfidAppActionHashDeltaTick] = rfid_app_action_hash_delta_tick,
+    [RfidAppActionBatchCountUp] = rfid_app_action_batch_count_up,
+    [RfidAppActionBatchCountDown] = rfid_app_action_batch_count_down,
+    [RfidAppActionBatchStart] = rfid_app_action_batch_start,
+    [RfidAppActionBatchWritten] = rfid_app_action_batch_written,
+    [RfidAppActionBatchWriteFailed] = rfid_app_action_batch_write_failed,
+    [RfidAppActionBatchNext] = rfid_app_action_batch_next,
+    [RfidAppActionBatchGone] = rfid_app_action_batch_gone,
+    [RfidAppActionBatchFinish] = rfid_app_action_batch_finish,
+    [RfidAppActionEmulateHash] = rfid_app_action_emulate_hash,
+    [RfidAppActionEmulateHashNext] = rfid_app_action_emulate_hash_next,
+    [RfidAppActionEmulateHashAuto] = rfid_app_action_emulate_hash_auto,
+    [RfidAppActionEmulateHashTick] = rfid_app_action_emulate_hash_tick,
+    [RfidAppActionEmulateHashCardPrev] = rfid_app_action_emulate_hash_card_prev,
+    [RfidAppActionEmulateHashCardNext] = rfid_app_action_emulate_hash_card_next,
+    [RfidAppActionEmulateHashStop] = rfid_app_action_emulate_hash_stop,
+    [RfidAppActionBrowseCards] = rfid_app_action_browse_cards,
+    [RfidAppActionBrowserUp] = rfid_app_action_browser_up,
+    [RfidAppActionBrowserDown] = rfid_app_action_browser_down,
+    [RfidAppActionBrowserPageUp] = rfid_app_action_browser_page_up,
+    [RfidAppActionBrowserPageDown] = rfid_app_action_browser_page_down,
+    [RfidAppActionBrowserMark] = rfid_app_action_browser_mark,
+    [RfidAppActionRevokeAsk] = rfid_app_action_revoke_ask,
+    [RfidAppActionRevoke] = rfid_app_action_revoke,
+    [RfidAppActionExportCards] = rfid_app_action_export_cards,
+    [RfidAppActionImportCards] = rfid_app_action_import_cards,
+    [RfidAppActionImportVerifiers] = rfid_app_action_import_verifiers,
+    [RfidAppActionBenchmark] = rfid_app_action_benchmark,
+    [RfidAppActionCloneValueUp] = rfid_app_action_clone_value_up,
+    [RfidAppActionCloneValueDown] = rfid_app_action_clone_value_down,
+    [RfidAppActionCloneFieldPrev] = rfid_app_action_clone_field_prev,
+    [RfidAppActionCloneFieldNext] = rfid_app_action_clone_field_next,
+    [RfidAppActionCloneStart] = rfid_app_action_clone_start,
+    [RfidAppActionCloneWritten] = rfid_app_action_clone_written,
+    [RfidAppActionCloneNext] = rfid_app_action_clone_next,
+    [RfidAppActionCloneGone] = rfid_app_action_clone_gone,
+    [RfidAppActionCloneFinish] = rfid_app_action_clone_finish,
+    [RfidAppActionLibraryOpen] = rfid_app_action_library_open,
+    [RfidAppActionLibraryMove] = rfid_app_action_library_move,
+    [RfidAppActionLibraryPlay] = rfid_app_action_library_play,
+    [RfidAppActionLibrarySave] = rfid_app_action_library_save,
+    [RfidAppActionLibraryRemove] = rfid_app_action_library_remove,
+    [RfidAppActionLibraryTick] = rfid_app_action_library_tick,
+    [RfidAppActionLibraryClose] = rfid_app_action_library_close,
+    [RfidAppActionAuditCard] = rfid_app_action_audit_card,
+    [RfidAppActionAuditRange] = rfid_app_action_audit_range,
+    [RfidAppActionAuditSearch] = rfid_app_action_audit_search,
+    [RfidAppActionAuditUp] = rfid_app_action_audit_up,
+    [RfidAppActionAuditDown] = rfid_app_action_audit_down,
+    [RfidAppActionReplayStart] = rfid_app_action_replay_start,
+    [RfidAppActionPresenceSeen] = rfid_app_action_presence_seen,
+};
+
+// the state every session starts in, a replay goes back to it before its first event
+static void rfid_app_reset(RfidApp* app) {
+    app->tag_found = false;
+    memset(app->tag_data, 0, sizeof(app->tag_data));
+    app->tag_protocol = LFRFIDProtocolHidGeneric;
+    memset(app->input_bytes, 0, sizeof(app->input_bytes));
+    furi_string_reset(app->status_text);
+    virtual_list_init(&app->menu, rfid_app_menu_count, RFID_APP_MENU_ROWS);
+    app->current_offset = 0;
+    app->batch_size = 10;
+    app->batch_reserved = 0;
+    app->batch_written = 0;
+    app->batch_flushed = 0;
+    app->hash_delta_pending = false;
+    app->hash_read_profile = RfidHashReadProfileEm4100;
+    memset(app->hash_read_total_ms, 0, sizeof(app->hash_read_total_ms));
+    memset(app->hash_read_count, 0, sizeof(app->hash_read_count));
+    app->emu_card_count = 0;
+    app->emu_card_pos = 0;
+    app->emu_advanced = false;
+    app->emu_auto = 0;
+    memset(app->browser_marked, 0, sizeof(app->browser_marked));
+    app->browser_mark_count = 0;
+    app->clone_mode = PayloadSeqAdd;
+    app->clone_field = RfidCloneFieldMode;
+    app->clone_step = 1;
+    app->clone_count = 10;
+    app->clone_written = 0;
+    app->library_playing = false;
+    app->library_switch_pending = false;
+    app->library_encode_cycles = 0;
+    app->library_switch_cycles = 0;
+    app->audit_card = -1;
+    app->audit_range = 1;
+    app->audit_result_count = 0;
+}
+
+#ifdef DEBUG
+static void rfid_app_check_transitions(void) {
+    bool reached[RfidAppStateCount];
+    bool valid = rfid_app_fsm_check(reached);
+    for(uint8_t state = RfidAppStateIdle; state < RfidAppStateCount; state++) {
+        if(!reached[state]) {
+            FURI_LOG_E(TAG, "state %u can't be reached", state);
+        }
+    }
+    furi_check(valid);
+}
+#endif
+
+static bool rfid_app_action_menu_select(RfidApp* app, const RfidAppEvent* event) {
+    const RfidAppMenuItem* item = &rfid_app_menu_items[app->menu.selected];
+    rfid_app_fsm_run(&app->fsm, app, item->action, item->next, event);
+    return true;
+}
 
-static void rfid_write_hash(RfidApp* app) {
-    if (app->card_idx < 99) {
-        app->card_idx++;
-    } else {
-        //TODO add regeneration
+// returns false if the current state ignores the event
+static bool rfid_app_dispatch(RfidApp* app, const RfidAppEvent* event) {
+    arena_reset(&app->scratch);
+    if(!rfid_app_fsm_dispatch(&app->fsm, app, event)) {
+        return false;
     }
-    uint8_t new_data[5];
-    new_data[0] = app->card_id;
-    memcpy(&new_data[1], &app->hash_bytes[app->card_idx], 4);
+    if(event->type != RfidAppEventTick) {
+        // any handled key can move the menu cursor or change data on screen
+        rfid_app_mark_dirty(app);
+    }
+    return true;
+}
 
-    protocol_dict_set_data(app->protocols, LFRFIDProtocolEM4100, new_data, 5);
-    lfrfid_worker_write_start(app->worker, LFRFIDProtocolEM4100, rfid_write_hash_callback, app);
+// records every key and worker result, even ignored ones, but only the ticks that did
+// something: replaying an idle tick changes nothing
+static void rfid_trace_add(RfidApp* app, const RfidAppEvent* event, bool handled) {
+    if(!handled && event->type == RfidAppEventTick) return;
+    uint32_t now = furi_get_tick();
+    TraceEvent record = {
+        .tick = now,
+        .delay = MIN(now - event->tick, (uint32_t)UINT16_MAX),
+        .type = event->type,
+        .has_data = event->type == RfidAppEventReadDone,
+        .repeat = event->repeat,
+        .protocol = event->protocol,
+    };
+    memcpy(record.data, event->data, sizeof(record.data));
+    // the buffer is written after the event was handled, never in the middle of it
+    if(event_trace_add(app->trace_rec, &record)) {
+        event_trace_flush(app->trace_rec);
+    }
 }
-*/
 
-static void rfid_read_hash_callback(LFRFIDWorkerReadResult result, ProtocolId protocol, void* context) {
-    RfidApp* app = context;
+static void rfid_replay_finish(RfidApp* app) {
+    event_trace_free(app->trace_play);
+    app->trace_play = NULL;
+    app->replay_ms = furi_get_tick() - app->replay_start;
+    if(app->library_loaded) {
+        rfid_library_stop(app);
+        rfid_library_free(app);
+    }
+    // the replay's store is left as the replay ended, for a look at what it did
+    if(app->index.dirty) {
+        rfid_index_save(app);
+    }
+    app->replaying = false;
+    app->data_dir = RFID_DATA_DIR;
+    rfid_store_open(app);
+    rfid_app_reset(app);
+    FURI_LOG_I(
+        TAG,
+        "replayed %lu events in %lu ms, recorded over %lu ms, slowest %lu cycles (event %u in state %u)",
+        app->replay_events,
+        app->replay_ms,
+        app->replay_tick - app->replay_rec_start,
+        app->replay_max_cycles,
+        app->replay_max_type,
+        app->replay_max_state);
+    rfid_app_set_state(app, RfidAppStateTraceDone);
+}
 
-    if(result == LFRFIDWorkerReadDone) {
-        // Get the protocol data
-        HashData temp_hash;
-        size_t data_size = protocol_dict_get_data_size(app->protocols, protocol);
-        protocol_dict_get_data(app->protocols, protocol, app->tag_data, data_size);
-    
-        int8_t read_result = rfid_file_read(app, &temp_hash, app->tag_data[0]);
-
-        if (read_result != 1){
-            if (read_result == -1) {
-                furi_string_set(app->status_text, "Card does not exist");
-                app->state = RfidAppStateHashError;
-                return;
-            } else {
-                furi_string_set(app->status_text, "File read error");
-                app->state = RfidAppStateHashError;
-                return;
-            }
+// hands out the next recorded event, at real speed only once its time has come. Live keys
+// and worker results are dropped meanwhile, a long Back stops the replay
+// returns false once the replay is over
+static bool rfid_replay_next(RfidApp* app, RfidAppEvent* event) {
+    const TraceEvent* next = &app->replay_next;
+    uint32_t due = app->replay_start + (next->tick - app->replay_rec_start);
+    RfidAppEvent live;
+    while(true) {
+        int32_t wait = app->replay_real_speed ? (int32_t)(due - furi_get_tick()) : 0;
+        if(furi_message_queue_get(app->event_queue, &live, wait > 0 ? (uint32_t)wait : 0) !=
+           FuriStatusOk) {
+            break;
         }
-        app->state = RfidAppStateReadingHashSuccess;
-        if (!app->hash_data) {
-            app->hash_data = malloc(sizeof(HashData));
+        if(live.type == RfidAppEventBackLong) {
+            app->replay_aborted = true;
+            rfid_replay_finish(app);
+            return false;
         }
-        // only copy after state has changed to prevent the current tag data
-        // from flashing on the currently reading screen
-        memcpy(app->hash_data, &temp_hash, sizeof(HashData));
-
-        // wait 1 s to show data -- TODO: Switch to input key to let person abort?
-        // NOTE moved here for now so that file data will have been read in
-        furi_delay_ms(3000);
-
-        // validate that read value matches what's expected
-        if (memcmp(&app->hash_data->hash_bytes[app->hash_data->curr_idx], &app->tag_data[1], 4) == 0) {
-
-            // card hash matches what's expected
-            app->hash_correct = true;
-            // now to write the new value to the card
-            app->state = RfidAppStateWriteHash;
-            app->tag_found = true;
-            // beep();
+    }
+
+    // a recording ends with the key that closed the app, the replay stops there instead
+    if(next->type >= RfidAppEventCount ||
+       rfid_app_transitions[app->fsm.state][next->type].action == RfidAppActionExit) {
+        rfid_replay_finish(app);
+        return false;
+    }
+    memset(event, 0, sizeof(RfidAppEvent));
+    event->type = next->type;
+    event->repeat = next->repeat;
+    event->tick = next->tick - next->delay;
+    event->protocol = PROTOCOL_NO;
+    if(next->has_data) {
+        if(next->protocol != 0xFF) event->protocol = next->protocol;
+        memcpy(event->data, next->data, sizeof(event->data));
+    }
+    app->replay_tick = next->tick;
+
+    if(!event_trace_next(app->trace_play, &app->replay_next)) {
+        // nothing after this one, the check above ends the replay next time
+        app->replay_next.type = RfidAppEventCount;
+    }
+    return true;
+}
+
+static void rfid_replay_account(
+    RfidApp* app,
+    const RfidAppEvent* event,
+    RfidAppState state,
+    uint32_t cycles) {
+    app->replay_events++;
+    app->replay_cycles += cycles;
+    if(cycles > app->replay_max_cycles) {
+        app->replay_max_cycles = cycles;
+        app->replay_max_type = event->type;
+        app->replay_max_state = state;
+    }
+}
+
+
+#define CANVAS_MAX_WIDTH 128 //TODO: Check if actual maximum or smaller?
+
+// per state draw handlers, the title is drawn by app_draw_callback
+typedef void (*RfidAppDrawHandler)(Canvas* canvas, RfidApp* app);
+
+static void rfid_app_draw_idle(Canvas* canvas, RfidApp* app) {
+    canvas_draw_str(canvas, 2, 24, "OK: Read, Up: Menu");
+    canvas_draw_str(canvas, 2, 36, "Back: Exit");
+    if(app->tag_found) {
+        canvas_draw_str(canvas, 2, 48, "Tag data found!");
+    }
+}
+
+static void rfid_app_draw_reading(Canvas* canvas, RfidApp* app) {
+    canvas_draw_str(canvas, 2, 24, "Reading...");
+    canvas_draw_str(canvas, 2, 36, "Place tag near");
+    if(app->status_text) {
+        canvas_draw_str(canvas, 2, 48, furi_string_get_cstr(app->status_text));
+    }
+}
+
+static void rfid_app_draw_emulating(Canvas* canvas, RfidApp* app) {
+    UNUSED(app);
+    canvas_draw_str(canvas, 2, 24, "Emulating tag");
+    canvas_draw_str(canvas, 2, 36, "Press Back to stop");
+}
+
+static void rfid_app_draw_writing(Canvas* canvas, RfidApp* app) {
+    UNUSED(app);
+    canvas_draw_str(canvas, 2, 24, "Writing...");
+    canvas_draw_str(canvas, 2, 36, "Place tag near");
+    canvas_draw_str(canvas, 2, 48, "Press Back to cancel");
+}
+
+static void rfid_app_draw_menu_item(Canvas* canvas, uint16_t item, int32_t y, void* context) {
+    UNUSED(context);
+    canvas_draw_str(canvas, 2, y, rfid_app_menu_items[item].label);
+}
+
+static void rfid_app_draw_menu(Canvas* canvas, RfidApp* app) {
+    canvas_set_font(canvas, FontPrimary);
+    canvas_draw_str(canvas, 2, 12, "Main Menu");
+    canvas_set_font(canvas, FontSecondary);
+    virtual_list_draw(&app->menu, canvas, 24, 10, rfid_app_draw_menu_item, NULL);
+}
+
+static void rfid_app_draw_input_offset(Canvas* canvas, RfidApp* app) {
+    canvas_draw_str(canvas, 2, 24, "Enter Offset (0-255):");
+    char offset_str[8];
+    snprintf(offset_str, sizeof(offset_str), "%d", app->current_offset);
+    canvas_draw_str(canvas, 2, 36, offset_str);
+}
+
+static void rfid_app_draw_create(Canvas* canvas, RfidApp* app) {
+    if(app->status_text) {
+        canvas_draw_str(canvas, 2, 24, "Hash values generated");
+        canvas_draw_str(canvas, 2, 34, furi_string_get_cstr(app->status_text));
+    } else {
+        canvas_draw_str(canvas, 2, 24, "Generating Hash Values");
+    }
+}
+
+static void rfid_app_draw_create_error(Canvas* canvas, RfidApp* app) {
+    canvas_draw_str(canvas, 2, 24, "Card Creation Error");
+    canvas_draw_str(canvas, 2, 34, furi_string_get_cstr(app->status_text));
+
+    canvas_draw_str(canvas, 2, 44, "Press OK to try again");
+}
+
+static void rfid_app_draw_create_success(Canvas* canvas, RfidApp* app) {
+    char hash_str[40+8];
+    canvas_draw_str(canvas, 2, 24, "Card Create Success!");
+    snprintf(hash_str, sizeof(hash_str), "Card ID: %d", app->hash_data->card_id);
+    canvas_draw_str(canvas, 2, 34, hash_str);
+    snprintf(hash_str, sizeof(hash_str), "First Hash: %02lX", app->hash_data->hash_bytes[app->hash_data->curr_idx]);
+    canvas_draw_str(canvas, 2, 44, hash_str);
+
+    canvas_draw_str(canvas, 2, 54, "Press back to go to menu");
+}
+
+static void rfid_app_draw_reading_hash(Canvas* canvas, RfidApp* app) {
+    char hash_str[40+8];
+    canvas_draw_str(canvas, 2, 24, "Hold card on reader.");
+    // app->hash_bytes is an unsigned int,
+    if (app->hash_data) {
+        if (app->hash_data->flags & HashRecordFlagVerifier) {
+            snprintf(hash_str, sizeof(hash_str), "Last card %d, anchor %02lX", app->hash_data->card_id,
+                app->hash_data->anchor);
         } else {
-            app->hash_correct = false;
-            //TODO may add code to check future vals
-            app->state = RfidAppStateHashError;
-            furi_string_set(app->status_text, "Card key did not match expected");
-            app->tag_found = false;
-            error_beep();
+            snprintf(hash_str, sizeof(hash_str), "Last card %d, next %02lX", app->hash_data->card_id,
+                app->hash_data->hash_bytes[app->hash_data->curr_idx]);
         }
-    } else if(result == LFRFIDWorkerReadSenseCardStart) {
-        furi_string_set(app->status_text, "Card detected, reading...");
-    } 
+        canvas_draw_str(canvas, 2, 34, hash_str);
+    }
+    uint8_t profile = app->hash_read_profile;
+    const char* name = profile == RfidHashReadProfileEm4100 ? "EM4100" : "Auto";
+    if (app->hash_read_count[profile]) {
+        snprintf(hash_str, sizeof(hash_str), "%s read: %lu ms, avg %lu", name, app->hash_read_last_ms[profile],
+            app->hash_read_total_ms[profile] / app->hash_read_count[profile]);
+    } else {
+        snprintf(hash_str, sizeof(hash_str), "%s read", name);
+    }
+    canvas_draw_str(canvas, 2, 44, hash_str);
+    canvas_draw_str(canvas, 2, 54, profile == RfidHashReadProfileEm4100 ? "Up: Use Auto read" : "Up: Use EM4100 read");
 }
 
-static void rfid_read_hash_tag(RfidApp* app) {
-    app->tag_found = false;
-    lfrfid_worker_read_start(app->worker, LFRFIDWorkerReadTypeAuto, rfid_read_hash_callback, app);
+static void rfid_app_draw_reading_hash_success(Canvas* canvas, RfidApp* app) {
+    char hash_str[40+8];
+    snprintf(hash_str, sizeof(hash_str), "Found card %d. Actual Value:", app->hash_data->card_id);
+    canvas_draw_str(canvas, 2, 24, hash_str);
+    snprintf(hash_str, sizeof(hash_str), "%02lX", *((uint32_t*) &app->tag_data[1]));
+    canvas_draw_str(canvas, 4, 34, hash_str);
+    if (app->hash_data->flags & HashRecordFlagVerifier) {
+        // the value can only be checked by hashing it, which happens after the screen
+        canvas_draw_str(canvas, 2, 44, "Anchor:");
+        snprintf(hash_str, sizeof(hash_str), "%02lX", app->hash_data->anchor);
+        canvas_draw_str(canvas, 4, 54, hash_str);
+        canvas_draw_str(canvas, 2, 64, "Verifier, card not written");
+        return;
+    }
+    canvas_draw_str(canvas, 2, 44, "Expected:");
+    snprintf(hash_str, sizeof(hash_str), "%02lX", app->hash_data->hash_bytes[app->hash_data->curr_idx]);
+    canvas_draw_str(canvas, 4, 54, hash_str);
+
+    if (*((uint32_t*) &app->tag_data[1]) == app->hash_data->hash_bytes[app->hash_data->curr_idx]) {
+        canvas_draw_str(canvas, 2, 64, "Matched, will write to card");
+    } else {
+        canvas_draw_str(canvas, 2, 64, "Not matched, will not write");
+    }
+}
+
+static void rfid_app_draw_write_hash(Canvas* canvas, RfidApp* app) {
+    UNUSED(app);
+    canvas_draw_str(canvas, 2, 24, "Keep card on reader.");
 }
 
+static void rfid_app_draw_hash_error(Canvas* canvas, RfidApp* app) {
+    canvas_draw_str(canvas, 2, 24, "Something went wrong.");
+    canvas_draw_str(canvas, 2, 34, furi_string_get_cstr(app->status_text));
+    canvas_draw_str(canvas, 2, 54, "Press back to return to menu");
+}
 
-static void handle_menu_input(RfidApp* app, InputEvent* event) {
-    if(event->type == InputTypeShort) {
-        switch(event->key) {
-        case InputKeyUp:
-            if(app->menu_selection > 0) {
-                if (app->screen_base == app->menu_selection) {
-                    app->screen_base--;
-                }
-                app->menu_selection--;
-            }
-            break;
-        case InputKeyDown:
-            if(app->menu_selection < 5) {
-                if (app->screen_base + 3 == app->menu_selection) {
-                    app->screen_base++;
-                }
-                app->menu_selection++;
-            }
-            break;
-        case InputKeyOk:
-            switch(app->menu_selection) {
-            case 0:
-                app->state = RfidAppStateInputOffset;
-                break;
-            case 1:
-                app->state = RfidAppStateInputData;
-
-                // Initialize input data
-                if(app->tag_found) {
-                    memcpy(app->input_bytes, app->tag_data, 8);
-                } else {
-                    memset(app->input_bytes, 0, 8);
-                }
-
-                break;
-            case 2:
-                app->state = RfidAppStateWriting;
-                rfid_write_tag(app);
-                break;
-            case 3:
-                if(app->tag_found) {
-                    app->state = RfidAppStateEmulating;
-                    rfid_emulate_tag(app);
-                } else {
-                    error_beep(); // Notify user no tag data available
-                }
-                break;
-            case 4:
-                app->state = RfidAppStateCreateHT;
-                rfid_create_hash_tag(app);
-                break;
-            case 5:
-                app->state = RfidAppStateReadingHash;
-                rfid_read_hash_tag(app);
-                break;
-            }
-            break;
-        case InputKeyBack:
-            app->state = RfidAppStateIdle;
-            break;
-        case InputKeyLeft:
-        case InputKeyRight:
-        case InputKeyMAX:
-            break;
-        }
+static void rfid_app_draw_write_hash_success(Canvas* canvas, RfidApp* app) {
+    char hash_str[40+8];
+    if (app->hash_data->flags & HashRecordFlagVerifier) {
+        snprintf(hash_str, sizeof(hash_str), "Card %d accepted", app->hash_data->card_id);
+        canvas_draw_str(canvas, 2, 24, hash_str);
+        canvas_draw_str(canvas, 2, 34, furi_string_get_cstr(app->status_text));
+        canvas_draw_str(canvas, 2, 54, "OK: Read again. Back: menu");
+        return;
     }
+    snprintf(hash_str, sizeof(hash_str), "Card %d written successfully", app->hash_data->card_id);
+    canvas_draw_str(canvas, 2, 24, hash_str);
+    snprintf(hash_str, sizeof(hash_str), "Next value: %02lX", app->hash_data->hash_bytes[app->hash_data->curr_idx]);
+    canvas_draw_str(canvas, 2, 34, hash_str);
+    canvas_draw_str(canvas, 2, 54, "OK: Read again. Back: menu");
 }
 
-static void handle_offset_input(RfidApp* app, InputEvent* event) {
-    if(event->type == InputTypeShort) {
-        switch(event->key) {
-        case InputKeyUp:
-            if(app->current_offset < 255) {
-                app->current_offset++;
-            } else {
-                app->current_offset = 0; // Wrap around to 0
-            }
-            break;
-        case InputKeyDown:
-            if(app->current_offset > 0) {
-                app->current_offset--;
-            } else {
-                app->current_offset = 255; // Wrap around to 255
-            }
-            break;
-        case InputKeyOk:
-            app->state = RfidAppStateMenu;
-            break;
-        case InputKeyBack:
-            app->state = RfidAppStateMenu;
-            break;
-        case InputKeyLeft:
-        case InputKeyRight:
-        case InputKeyMAX:
-            break;
+static void rfid_app_draw_debug_msg(Canvas* canvas, RfidApp* app) {
+    canvas_draw_str(canvas, 2, 34, furi_string_get_cstr(app->status_text));
+}
+
+static void rfid_app_draw_batch_count(Canvas* canvas, RfidApp* app) {
+    char count_str[24];
+    canvas_draw_str(canvas, 2, 24, "Cards to enroll:");
+    snprintf(count_str, sizeof(count_str), "%u", app->batch_size);
+    canvas_draw_str(canvas, 2, 36, count_str);
+    canvas_draw_str(canvas, 2, 54, "Up/Down: Change, OK: Start");
+}
+
+static void rfid_app_draw_batch_write(Canvas* canvas, RfidApp* app) {
+    char batch_str[32];
+    snprintf(batch_str, sizeof(batch_str), "Card %u of %u, ID %d",
+        app->batch_written + 1, app->batch_reserved, app->batch_ids[app->batch_written]);
+    canvas_draw_str(canvas, 2, 24, batch_str);
+    canvas_draw_str(canvas, 2, 34, furi_string_get_cstr(app->status_text));
+    canvas_draw_str(canvas, 2, 54, "Back: Stop batch");
+}
+
+static void rfid_app_draw_batch_remove(Canvas* canvas, RfidApp* app) {
+    char batch_str[32];
+    snprintf(batch_str, sizeof(batch_str), "Card %u of %u written", app->batch_written, app->batch_reserved);
+    canvas_draw_str(canvas, 2, 24, batch_str);
+    canvas_draw_str(canvas, 2, 34, "Remove card for the next");
+    canvas_draw_str(canvas, 2, 54, "OK: Next now, Back: Stop");
+}
+
+static void rfid_app_draw_batch_done(Canvas* canvas, RfidApp* app) {
+    char batch_str[32];
+    canvas_draw_str(canvas, 2, 24, "Batch finished");
+    snprintf(batch_str, sizeof(batch_str), "%u of %u cards written", app->batch_written, app->batch_size);
+    canvas_draw_str(canvas, 2, 34, batch_str);
+    canvas_draw_str(canvas, 2, 44, furi_string_get_cstr(app->status_text));
+    canvas_draw_str(canvas, 2, 54, "Press back to go to menu");
+}
+
+static void rfid_app_draw_emulate_hash(Canvas* canvas, RfidApp* app) {
+    char hash_str[40];
+    snprintf(hash_str, sizeof(hash_str), "Emulating card %d (%u/%u)",
+        app->hash_data->card_id, app->emu_card_pos + 1, app->emu_card_count);
+    canvas_draw_str(canvas, 2, 24, hash_str);
+    snprintf(hash_str, sizeof(hash_str), "Value %d: %08lX",
+        app->hash_data->curr_idx, app->hash_data->hash_bytes[app->hash_data->curr_idx]);
+    canvas_draw_str(canvas, 2, 34, hash_str);
+    if(rfid_emu_auto_ms[app->emu_auto]) {
+        snprintf(hash_str, sizeof(hash_str), "Up: Auto next every %us", rfid_emu_auto_ms[app->emu_auto] / 1000);
+    } else {
+        snprintf(hash_str, sizeof(hash_str), "Up: Auto next off");
+    }
+    canvas_draw_str(canvas, 2, 44, hash_str);
+    canvas_draw_str(canvas, 2, 54, "OK: Next value, </>: Card");
+}
+
+// card id, chain values left and time since the last record write
+// time since an RTC timestamp, in the largest whole unit, "-" if it is 0
+static void rfid_format_age(RfidApp* app, char* out, size_t size, uint32_t timestamp) {
+    uint32_t age = rfid_app_rtc(app) - timestamp;
+    if(timestamp == 0) {
+        snprintf(out, size, "-");
+    } else if(age < 60 * 60) {
+        snprintf(out, size, "%lum ago", age / 60);
+    } else if(age < 24 * 60 * 60) {
+        snprintf(out, size, "%luh ago", age / (60 * 60));
+    } else {
+        snprintf(out, size, "%lud ago", age / (24 * 60 * 60));
+    }
+}
+
+static void rfid_app_draw_browser_item(Canvas* canvas, uint16_t item, int32_t y, void* context) {
+    RfidApp* app = context;
+    CardSummary summary;
+    card_index_get(&app->index, app->browser_cards[item], &summary);
+
+    char seen[12];
+    rfid_format_age(app, seen, sizeof(seen), summary.last_seen);
+
+    uint8_t card_id = app->browser_cards[item];
+    char line[32];
+    snprintf(line, sizeof(line), "  %c#%-3u %3u left  %s",
+        (app->browser_marked[card_id / 8] & (1 << (card_id % 8))) ? '*' : ' ',
+        card_id, summary.chain_len - summary.curr_idx - !(summary.flags & HashRecordFlagVerifier), seen);
+    canvas_draw_str(canvas, 2, y, line);
+}
+
+static void rfid_app_draw_card_browser(Canvas* canvas, RfidApp* app) {
+    if(app->browser.count == 0) {
+        canvas_draw_str(canvas, 2, 24, "No stored cards");
+        return;
+    }
+    virtual_list_draw(&app->browser, canvas, 24, 10, rfid_app_draw_browser_item, app);
+}
+
+static void rfid_app_draw_revoke_confirm(Canvas* canvas, RfidApp* app) {
+    char line[32];
+    snprintf(line, sizeof(line), "Revoke %u card%s?", app->browser_mark_count, app->browser_mark_count == 1 ? "" : "s");
+    canvas_draw_str(canvas, 2, 24, line);
+    canvas_draw_str(canvas, 2, 36, "They stop verifying and");
+    canvas_draw_str(canvas, 2, 46, "their IDs are reused");
+    canvas_draw_str(canvas, 2, 58, "OK: Revoke, Back: Cancel");
+}
+
+static void rfid_app_draw_archive_done(Canvas* canvas, RfidApp* app) {
+    canvas_draw_str(canvas, 2, 24, furi_string_get_cstr(app->status_text));
+    canvas_draw_str(canvas, 2, 36, "Archive: rfid_hashes/cards.htar");
+    canvas_draw_str(canvas, 2, 54, "Press back to go to menu");
+}
+
+static void rfid_app_draw_benchmark(Canvas* canvas, RfidApp* app) {
+    char line[32];
+    uint8_t new_backend = hash_backend_has_key() ? HashBackendRipemd128Keyed : HASH_BACKEND_DEFAULT;
+    uint8_t y = 20;
+    for(uint8_t id = 0; id < HashBackendCount; id++) {
+        const HashBackend* hash = hash_backend_get(id);
+        if(!hash) {
+            continue;
         }
+        snprintf(line, sizeof(line), "%s%s %lu cyc %uB",
+            id == new_backend ? "*" : "", hash->name, app->bench_cycles[id], hash->state_size);
+        canvas_draw_str(canvas, 2, y, line);
+        y += 10;
+    }
+}
+
+static void rfid_app_draw_clone_setup(Canvas* canvas, RfidApp* app) {
+    char line[32];
+    snprintf(line, sizeof(line), "%cMode: %s", app->clone_field == RfidCloneFieldMode ? '>' : ' ',
+        payload_seq_mode_name(app->clone_mode));
+    canvas_draw_str(canvas, 2, 24, line);
+    snprintf(line, sizeof(line), "%cStep: %u", app->clone_field == RfidCloneFieldStep ? '>' : ' ', app->clone_step);
+    canvas_draw_str(canvas, 2, 34, line);
+    snprintf(line, sizeof(line), "%cCards: %u", app->clone_field == RfidCloneFieldCount ? '>' : ' ', app->clone_count);
+    canvas_draw_str(canvas, 2, 44, line);
+    canvas_draw_str(canvas, 2, 54, app->tag_found ? "</>: Field, OK: Start" : "Read or input a tag first");
+}
+
+static void rfid_app_draw_clone_payload(Canvas* canvas, RfidApp* app, int32_t y) {
+    char line[32];
+    size_t len = protocol_dict_get_data_size(app->protocols, LFRFIDProtocolEM4100);
+    size_t pos = 0;
+    for(size_t i = 0; i < len && i < PAYLOAD_SEQ_MAX_LEN; i++) {
+        pos += snprintf(&line[pos], sizeof(line) - pos, "%02X ", app->clone_payload[i]);
+    }
+    canvas_draw_str(canvas, 2, y, line);
+}
+
+static void rfid_app_draw_clone_write(Canvas* canvas, RfidApp* app) {
+    char line[32];
+    snprintf(line, sizeof(line), "Card %u of %u", app->clone_written + 1, app->clone_count);
+    canvas_draw_str(canvas, 2, 24, line);
+    rfid_app_draw_clone_payload(canvas, app, 34);
+    canvas_draw_str(canvas, 2, 44, furi_string_get_cstr(app->status_text));
+    canvas_draw_str(canvas, 2, 54, "Back: Stop");
+}
+
+static void rfid_app_draw_clone_remove(Canvas* canvas, RfidApp* app) {
+    char line[32];
+    snprintf(line, sizeof(line), "Card %u of %u written", app->clone_written, app->clone_count);
+    canvas_draw_str(canvas, 2, 24, line);
+    rfid_app_draw_clone_payload(canvas, app, 34);
+    canvas_draw_str(canvas, 2, 44, "Remove card for the next");
+    canvas_draw_str(canvas, 2, 54, "OK: Next now, Back: Stop");
+}
+
+static void rfid_app_draw_clone_done(Canvas* canvas, RfidApp* app) {
+    char line[32];
+    canvas_draw_str(canvas, 2, 24, "Sequence finished");
+    snprintf(line, sizeof(line), "%u of %u cards written", app->clone_written, app->clone_count);
+    canvas_draw_str(canvas, 2, 34, line);
+    // from the start of the first write to the end of the last, card swaps included
+    uint32_t elapsed = app->clone_last_tick - app->clone_start_tick;
+    if(app->clone_written && elapsed) {
+        uint32_t per_min_x10 =
+            (uint64_t)app->clone_written * 600 * furi_kernel_get_tick_frequency() / elapsed;
+        snprintf(line, sizeof(line), "%lu.%lu cards per minute", per_min_x10 / 10, per_min_x10 % 10);
+        canvas_draw_str(canvas, 2, 44, line);
+    }
+    canvas_draw_str(canvas, 2, 54, "Press back to go to menu");
+}
+
+// protocol and data of a saved tag, a > marks the one being emulated
+static void rfid_app_draw_library_item(Canvas* canvas, uint16_t item, int32_t y, void* context) {
+    RfidApp* app = context;
+    const SavedTag* tag = &app->library.tags[item];
+    char line[32];
+    int pos = snprintf(line, sizeof(line), "%s%.7s ",
+        (app->library_playing && item == app->library_list.selected) ? ">" : "",
+        protocol_dict_get_name(app->protocols, tag->protocol));
+    for(uint8_t i = 0; i < tag->data_size && i < 6; i++) {
+        pos += snprintf(&line[pos], sizeof(line) - pos, "%02X", tag->data[i]);
+    }
+    canvas_draw_str(canvas, 8, y, line);
+}
+
+static void rfid_app_draw_tag_library(Canvas* canvas, RfidApp* app) {
+    char line[32];
+    if(app->library.count == 0) {
+        canvas_draw_str(canvas, 2, 24, "No saved tags");
+    } else {
+        virtual_list_draw(&app->library_list, canvas, 24, 10, rfid_app_draw_library_item, app);
+    }
+    uint32_t per_us = furi_hal_cortex_instructions_per_microsecond();
+    if(app->library.count && !app->library_streams[app->library_list.selected]) {
+        snprintf(line, sizeof(line), "Not cached, worker restart");
+    } else if(app->library_switch_cycles) {
+        snprintf(line, sizeof(line), "Switch %luus, encode %luus",
+            app->library_switch_cycles / per_us, app->library_encode_cycles / per_us);
+    } else {
+        snprintf(line, sizeof(line), "Encode %luus", app->library_encode_cycles / per_us);
+    }
+    canvas_draw_str(canvas, 2, 54, line);
+    canvas_draw_str(canvas, 2, 64, "OK:Emulate >:Save Hold:Del");
+}
+
+static void rfid_app_draw_audit_query(Canvas* canvas, RfidApp* app) {
+    char line[32];
+    if(app->audit_card < 0) {
+        snprintf(line, sizeof(line), "Card: all");
+    } else {
+        snprintf(line, sizeof(line), "Card: %d", app->audit_card);
+    }
+    canvas_draw_str(canvas, 2, 24, line);
+    uint16_t days = rfid_audit_range_days[app->audit_range];
+    if(days) {
+        snprintf(line, sizeof(line), "Taps of the last %u day%s", days, days == 1 ? "" : "s");
+    } else {
+        snprintf(line, sizeof(line), "Taps of all time");
+    }
+    canvas_draw_str(canvas, 2, 34, line);
+    canvas_draw_str(canvas, 2, 54, "Up/Down: Card, </>: Range");
+    canvas_draw_str(canvas, 2, 64, "OK: Search");
+}
+
+// newest first: age, card, position and result
+static void rfid_app_draw_audit_item(Canvas* canvas, uint16_t item, int32_t y, void* context) {
+    RfidApp* app = context;
+    const AuditRecord* record = &app->audit_results[app->audit_result_count - 1 - item];
+    char seen[12];
+    rfid_format_age(app, seen, sizeof(seen), record->time);
+    char line[40];
+    snprintf(line, sizeof(line), "  %s #%u/%u %s",
+        seen, record->card_id, record->chain_idx, audit_result_name(record->result));
+    canvas_draw_str(canvas, 2, y, line);
+}
+
+static void rfid_app_draw_audit_results(Canvas* canvas, RfidApp* app) {
+    char line[40];
+    if(!app->audit_query_ok) {
+        canvas_draw_str(canvas, 2, 24, "Can't read the tap log");
+        return;
+    }
+    snprintf(line, sizeof(line), "%lu taps, %u/%u blocks, %lums",
+        app->audit_stats.matched, app->audit_stats.blocks_read, app->audit_stats.blocks_total, app->audit_query_ms);
+    canvas_draw_str(canvas, 2, 24, line);
+    virtual_list_draw(&app->audit_list, canvas, 34, 10, rfid_app_draw_audit_item, app);
+}
+
+static void rfid_app_draw_trace_replay(Canvas* canvas, RfidApp* app) {
+    canvas_draw_str(canvas, 2, 24, "Trace: rfid_hashes/trace.bin");
+    if(app->trace_rec) {
+        canvas_draw_str(canvas, 2, 34, "Recording, delete trace.on");
+        canvas_draw_str(canvas, 2, 44, "and restart to replay");
+        return;
+    }
+    canvas_draw_str(canvas, 2, 34, "OK: Real speed");
+    canvas_draw_str(canvas, 2, 44, ">: Full speed");
+    canvas_draw_str(canvas, 2, 54, "Hold Back stops the replay");
+}
+
+static void rfid_app_draw_trace_done(Canvas* canvas, RfidApp* app) {
+    char line[40];
+    uint32_t per_us = furi_hal_cortex_instructions_per_microsecond();
+    snprintf(
+        line,
+        sizeof(line),
+        "%s %lu events",
+        app->replay_aborted ? "Stopped after" : "Replayed",
+        app->replay_events);
+    canvas_draw_str(canvas, 2, 24, line);
+    snprintf(
+        line,
+        sizeof(line),
+        "%lu ms, recorded %lu ms",
+        app->replay_ms,
+        app->replay_tick - app->replay_rec_start);
+    canvas_draw_str(canvas, 2, 34, line);
+    if(app->replay_events) {
+        snprintf(
+            line,
+            sizeof(line),
+            "Avg %lu us, max %lu us",
+            (uint32_t)(app->replay_cycles / app->replay_events / per_us),
+            app->replay_max_cycles / per_us);
+        canvas_draw_str(canvas, 2, 44, line);
+    }
+    uint16_t refused = 0;
+    for(uint8_t i = AuditResultAccepted + 1; i < AuditResultCount; i++) {
+        refused += app->replay_taps[i];
+    }
+    snprintf(
+        line, sizeof(line), "Taps: %u accepted, %u not", app->replay_taps[AuditResultAccepted], refused);
+    canvas_draw_str(canvas, 2, 54, line);
+}
+
+static const RfidAppDrawHandler rfid_app_draw_handlers[RfidAppStateCount] = {
+    [RfidAppStateIdle] = rfid_app_draw_idle,
+    [RfidAppStateReading] = rfid_app_draw_reading,
+    [RfidAppStateEmulating] = rfid_app_draw_emulating,
+    [RfidAppStateWriting] = rfid_app_draw_writing,
+    [RfidAppStateMenu] = rfid_app_draw_menu,
+    [RfidAppStateInputOffset] = rfid_app_draw_input_offset,
+    // RfidAppStateInputData is drawn by the byte input view port
+    [RfidAppStateCreateHT] = rfid_app_draw_create,
+    [RfidAppStateCreateError] = rfid_app_draw_create_error,
+    [RfidAppStateCreateSuccess] = rfid_app_draw_create_success,
+    [RfidAppStateReadingHash] = rfid_app_draw_reading_hash,
+    [RfidAppStateReadingHashSuccess] = rfid_app_draw_reading_hash_success,
+    [RfidAppStateWriteHash] = rfid_app_draw_write_hash,
+    [RfidAppStateHashError] = rfid_app_draw_hash_error,
+    [RfidAppStateWriteHashSuccess] = rfid_app_draw_write_hash_success,
+    [RfidAppStateDebugMsg] = rfid_app_draw_debug_msg,
+    [RfidAppStateBatchCount] = rfid_app_draw_batch_count,
+    [RfidAppStateBatchWrite] = rfid_app_draw_batch_write,
+    [RfidAppStateBatchRemove] = rfid_app_draw_batch_remove,
+    [RfidAppStateBatchDone] = rfid_app_draw_batch_done,
+    [RfidAppStateEmulateHash] = rfid_app_draw_emulate_hash,
+    [RfidAppStateCardBrowser] = rfid_app_draw_card_browser,
+    [RfidAppStateRevokeConfirm] = rfid_app_draw_revoke_confirm,
+    [RfidAppStateArchiveDone] = rfid_app_draw_archive_done,
+    [RfidAppStateBenchmark] = rfid_app_draw_benchmark,
+    [RfidAppStateCloneSetup] = rfid_app_draw_clone_setup,
+    [RfidAppStateCloneWrite] = rfid_app_draw_clone_write,
+    [RfidAppStateCloneRemove] = rfid_app_draw_clone_remove,
+    [RfidAppStateCloneDone] = rfid_app_draw_clone_done,
+    [RfidAppStateTagLibrary] = rfid_app_draw_tag_library,
+    [RfidAppStateAuditQuery] = rfid_app_draw_audit_query,
+    [RfidAppStateAuditResults] = rfid_app_draw_audit_results,
+    [RfidAppStateTraceReplay] = rfid_app_draw_trace_replay,
+    [RfidAppStateTraceDone] = rfid_app_draw_trace_done,
+};
+
+static void app_draw_callback(Canvas* canvas, void* ctx) {
+    RfidApp* app = ctx;
+    rfid_app_count_redraw(app);
+
+    RfidAppDrawHandler draw = rfid_app_draw_handlers[app->fsm.state];
+    // Don't draw if we're showing the byte input view (crashes)
+    if(!draw) {
+        return;
+    }
+
+    canvas_clear(canvas);
+
+    // Don't show the title when in menu state (save vspace)
+    if(app->fsm.state != RfidAppStateMenu) {
+        canvas_set_font(canvas, FontPrimary);
+        canvas_draw_str(canvas, 2, 12, "# HashTag #");
+    }
+
+    canvas_set_font(canvas, FontSecondary);
+#ifdef DEBUG
+    char rate_str[12];
+    snprintf(rate_str, sizeof(rate_str), "%lu/s", app->redraws_per_sec);
+    canvas_draw_str(canvas, 100, 12, rate_str);
+#endif
+    draw(canvas, app);
+}
+
+// rfid_app_fsm_event_from_input takes the SDK's key and press type as they are
+_Static_assert(
+    (int)InputKeyUp == RfidAppKeyUp && (int)InputKeyDown == RfidAppKeyDown &&
+        (int)InputKeyRight == RfidAppKeyRight && (int)InputKeyLeft == RfidAppKeyLeft &&
+        (int)InputKeyOk == RfidAppKeyOk && (int)InputKeyBack == RfidAppKeyBack &&
+        (int)InputKeyMAX == RfidAppKeyCount,
+    "RfidAppKey has to follow InputKey");
+_Static_assert(
+    (int)InputTypePress == RfidAppPressPress && (int)InputTypeRelease == RfidAppPressRelease &&
+        (int)InputTypeShort == RfidAppPressShort && (int)InputTypeLong == RfidAppPressLong &&
+        (int)InputTypeRepeat == RfidAppPressRepeat,
+    "RfidAppPress has to follow InputType");
+
+static void app_input_callback(InputEvent* input_event, void* ctx) {
+    RfidApp* app = ctx;
+    RfidAppEvent event = {0};
+    if(rfid_app_fsm_event_from_input(input_event->key, input_event->type, &event)) {
+        event.tick = furi_get_tick();
+        furi_message_queue_put(app->event_queue, &event, FuriWaitForever);
     }
 }
 
 static void byte_input_view_port_draw_callback(Canvas* canvas, void* context) {
     RfidApp* app = context;
+    rfid_app_count_redraw(app);
 
     canvas_clear(canvas);
 
@@ -828,243 +3074,199 @@ static void byte_input_view_port_draw_callback(Canvas* canvas, void* context) {
     canvas_draw_str(canvas, 2, 60, "Left/Right: Move | OK: Done");
 }
 
-static void byte_input_view_port_input_callback(InputEvent* event, void* context) {
-    RfidApp* app = context;
-
-    // Handle input for our custom byte input UI
-    bool consumed = false;
-    uint8_t current_byte = 0;
-    uint8_t modified_byte = 0;
-
-    if(event->type == InputTypeShort || event->type == InputTypeRepeat) {
-        switch(event->key) {
-        case InputKeyOk:
-            // Complete input, return to menu
-            memcpy(app->tag_data, app->input_bytes, 8);
-            app->tag_found = true; // We now have valid data
-            app->state = RfidAppStateMenu;
-            consumed = true;
-            break;
-
-        case InputKeyUp:
-            // Increment current byte
-            current_byte = app->input_bytes[app->current_offset % 8];
-            modified_byte = current_byte + 1;
-            app->input_bytes[app->current_offset % 8] = modified_byte;
-            consumed = true;
-            break;
-
-        case InputKeyDown:
-            // Decrement current byte
-            current_byte = app->input_bytes[app->current_offset % 8];
-            modified_byte = current_byte - 1;
-            app->input_bytes[app->current_offset % 8] = modified_byte;
-            consumed = true;
-            break;
+// logs free heap and the largest free block next to the arena peaks, a shrinking
+// largest block with constant free heap would mean fragmentation is growing
+static void rfid_app_heap_report(RfidApp* app) {
+    FURI_LOG_I(
+        TAG,
+        "Heap free %zu, largest block %zu, min free %zu, arena %zu/%zu, scratch peak %zu/%zu, audit dropped %lu",
+        memmgr_get_free_heap(),
+        memmgr_heap_get_max_free_block(),
+        memmgr_get_minimum_free_heap(),
+        app->arena.used,
+        app->arena.size,
+        app->scratch.peak,
+        app->scratch.size,
+        audit_log_dropped(app->audit_log));
+    app->heap_report_tick = furi_get_tick();
+}
 
-        case InputKeyLeft:
-            // Move to previous byte
-            if(app->current_offset > 0) {
-                app->current_offset--;
-            } else {
-                app->current_offset = 7; // Wrap around to last byte
-            }
-            consumed = true;
-            break;
+// states where no tag operation is running, so background storage work can't delay one
+static bool rfid_app_is_quiet(RfidApp* app) {
+    return app->fsm.state == RfidAppStateIdle || app->fsm.state == RfidAppStateMenu ||
+           app->fsm.state == RfidAppStateCardBrowser;
+}
 
-        case InputKeyRight:
-            // Move to next byte
-            if(app->current_offset < 7) {
-                app->current_offset++;
-            } else {
-                app->current_offset = 0; // Wrap around to first byte
-            }
-            consumed = true;
-            break;
 
-        default:
-            break;
-        }
+// a site key on the SD card switches new chains to the keyed backend
+static void rfid_load_site_key(RfidApp* app) {
+    uint8_t key[HASH_BACKEND_KEY_MAX];
+    File* file = storage_file_alloc(app->storage);
+    if(storage_file_open(file, RFID_SITE_KEY_PATH, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        uint16_t len = storage_file_read(file, key, sizeof(key));
+        hash_backend_set_key(key, len);
+        FURI_LOG_I(TAG, "site key loaded, %u bytes", len);
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    memset(key, 0, sizeof(key));
+}
 
-        if(consumed) {
-            view_port_update(app->byte_input_view_port);
-        }
-    } else if(event->type == InputTypeLong && event->key == InputKeyBack) {
-        // Long press back to exit without saving
-        app->state = RfidAppStateMenu;
+// records the session while the flag file exists, see RFID_TRACE_FLAG_PATH
+static void rfid_trace_start(RfidApp* app) {
+    if(!storage_file_exists(app->storage, RFID_TRACE_FLAG_PATH)) return;
+    // replays start from the card store as it is now
+    if(!rfid_store_copy(app, RFID_DATA_DIR, RFID_TRACE_STORE_DIR)) {
+        FURI_LOG_E(TAG, "card store copy failed, not recording");
+        return;
+    }
+    app->trace_rec = event_trace_alloc(app->storage);
+    if(event_trace_record(app->trace_rec, RFID_TRACE_PATH)) {
+        FURI_LOG_I(TAG, "recording events to %s", RFID_TRACE_PATH);
+    } else {
+        event_trace_free(app->trace_rec);
+        app->trace_rec = NULL;
     }
 }
 
 void rfid_make_folder(RfidApp* app) {
-    app->storage = furi_record_open("storage");
-    if (!storage_simply_mkdir(app->storage, "/ext/rfid_hashes")) {
+    app->storage = furi_record_open(RECORD_STORAGE);
+    app->file = flipper_format_file_alloc(app->storage);
+    if (!storage_simply_mkdir(app->storage, RFID_DATA_DIR)) {
         furi_string_set(app->status_text, "folder create error");
-        app->state = RfidAppStateHashError;
+        rfid_app_set_state(app, RfidAppStateHashError);
     }
-    rfid_create_idarr(app);
-
-
+    rfid_store_open(app);
 }
 
-int32_t rfid_app_main(void* p) {
-    UNUSED(p);
-
-    RfidApp* app = malloc(sizeof(RfidApp));
-    app->state = RfidAppStateIdle;
-    app->tag_found = false;
+RfidApp* rfid_app_alloc(void) {
+    // the only heap allocation of app owned data, everything else comes out of the arenas
+    Arena arena;
+    arena_init(&arena, malloc(RFID_APP_ARENA_SIZE), RFID_APP_ARENA_SIZE);
+    RfidApp* app = arena_push(&arena, sizeof(RfidApp));
+    app->arena = arena;
+    arena_init(&app->scratch, arena_push(&app->arena, RFID_SCRATCH_SIZE), RFID_SCRATCH_SIZE);
+    app->fsm = (RfidAppFsm){.actions = rfid_app_actions, .enter = rfid_app_set_state};
+    rfid_app_set_state(app, RfidAppStateIdle);
     app->status_text = furi_string_alloc();
     app->byte_input_view_port = NULL;
+    app->hash_data = NULL;
+    rfid_app_reset(app);
+#ifdef DEBUG
+    rfid_app_check_transitions();
+#endif
+    app->redraw_count = 0;
+    app->redraw_window_start = furi_get_tick();
+    app->redraws_per_sec = 0;
+    app->running = true;
+    app->batch_chains = NULL;
+    app->library_loaded = false;
+    app->trace_rec = NULL;
+    app->trace_play = NULL;
+    app->replaying = false;
+    app->heap_report_tick = furi_get_tick();
+    app->data_dir = RFID_DATA_DIR;
     rfid_make_folder(app);
+    rfid_load_site_key(app);
+    rfid_trace_start(app);
+    app->chain_pool = chain_pool_alloc();
+    app->audit_log = audit_log_alloc(app->storage);
     // Initialize protocols and worker
     app->protocols = protocol_dict_alloc(lfrfid_protocols, LFRFIDProtocolMax);
     app->worker = lfrfid_worker_alloc(app->protocols);
     lfrfid_worker_start_thread(app->worker);
 
+    // Configure event queue, before the view port can deliver input into it
+    app->event_queue = furi_message_queue_alloc(8, sizeof(RfidAppEvent));
+
     // Configure view port
     app->view_port = view_port_alloc();
     app->gui = furi_record_open(RECORD_GUI);
     view_port_draw_callback_set(app->view_port, app_draw_callback, app);
     view_port_input_callback_set(app->view_port, app_input_callback, app);
     gui_add_view_port(app->gui, app->view_port, GuiLayerFullscreen);
+    return app;
+}
 
-    // Configure event queue
-    app->event_queue = furi_message_queue_alloc(8, sizeof(InputEvent));
-
-    // Main event loop
-    InputEvent event;
-    bool running = true;
-
-    while(running) {
-        if(furi_message_queue_get(app->event_queue, &event, 100) == FuriStatusOk) {
-            if(event.type == InputTypeShort || event.type == InputTypeLong) {
-                switch(app->state) {
-                case RfidAppStateIdle:
-                    switch(event.key) {
-                    case InputKeyOk:
-                        rfid_read_tag(app);
-                        break;
-                    case InputKeyUp:
-                        app->state = RfidAppStateMenu;
-                        break;
-                    case InputKeyDown:
-                        if(app->tag_found) {
-                            app->state = RfidAppStateEmulating;
-                            rfid_emulate_tag(app);
-                        }
-                        break;
-                    case InputKeyBack:
-                        running = false;
-                        break;
-                    default:
-                        break;
-                    }
-                    break;
-                case RfidAppStateMenu:
-                    handle_menu_input(app, &event);
-                    break;
-                case RfidAppStateInputOffset:
-                    handle_offset_input(app, &event);
-                    break;
-                case RfidAppStateInputData:
-                    if(event.key == InputKeyBack && event.type == InputTypeLong) {
-                        // Long press back to exit without saving
-                        app->state = RfidAppStateMenu;
-
-                        // Remove byte input view port and show main view port
-                        if(app->byte_input_view_port) {
-                            gui_remove_view_port(app->gui, app->byte_input_view_port);
-                            gui_add_view_port(app->gui, app->view_port, GuiLayerFullscreen);
-                        }
-                    }
-                    break;
-                case RfidAppStateEmulating:
-                    if(event.key == InputKeyBack) {
-                        lfrfid_worker_stop(app->worker);
-                        app->state = RfidAppStateIdle;
-                        beep(); // Notify user emulation has ended
-                    }
-                    break;
-                case RfidAppStateWriting:
-                    if(event.key == InputKeyBack) {
-                        lfrfid_worker_stop(app->worker);
-                        app->state = RfidAppStateIdle;
-                        furi_string_set(app->status_text, "Writing cancelled");
-                        error_beep();
-                    }
-                    break;
-                case RfidAppStateCreateError:
-                    if (event.key == InputKeyOk) {
-                        app->state = RfidAppStateCreateHT;
-                        rfid_create_hash_tag(app);
-                    } else if (event.key == InputKeyBack) {
-                        app->state = RfidAppStateMenu;
-                    }
-                    break;
-                case RfidAppStateCreateSuccess:
-                    if (event.key == InputKeyBack || event.key == InputKeyOk) {
-                        app->state = RfidAppStateMenu;
-                    }
-                    break;
-
-                case RfidAppStateReadingHash:
-                    if (event.key == InputKeyBack) {
-                        app->state = RfidAppStateMenu;
-                    }
-                    break;
-                case RfidAppStateWriteHash:
-                    break;
-                case RfidAppStateWriteHashSuccess:
-                    if (event.key == InputKeyBack) {
-                        app->state = RfidAppStateMenu;
-                    } else if (event.key == InputKeyOk) {
-                        app->state = RfidAppStateReadingHash;
-                        rfid_read_hash_tag(app);
-                    }
-                    break;
-                case RfidAppStateHashError:
-                    if (event.key == InputKeyBack) {
-                        app->state = RfidAppStateMenu;
-                    }
-                    break;
-                // TODO add interactions for hash read/write/error
-                default:
-                    break;
-                }
-            }
-        }
+bool rfid_app_step(RfidApp* app) {
+    RfidAppEvent event;
+    if(app->replaying) {
+        if(!rfid_replay_next(app, &event)) return app->running;
+    } else if(furi_message_queue_get(app->event_queue, &event, 100) != FuriStatusOk) {
+        event.type = RfidAppEventTick;
+        event.tick = furi_get_tick();
+    }
+    bool replayed = app->replaying;
+    RfidAppState state = app->fsm.state;
+    uint32_t cycles = DWT->CYCCNT;
+    bool handled = rfid_app_dispatch(app, &event);
+    cycles = DWT->CYCCNT - cycles;
+    if(replayed) {
+        rfid_replay_account(app, &event, state, cycles);
+    } else if(app->trace_rec) {
+        rfid_trace_add(app, &event, handled);
+    }
+    // revoked cards are only cleaned up while nothing else is going on
+    if(event.type == RfidAppEventTick && app->index.revoked && rfid_app_is_quiet(app)) {
+        rfid_compact_step(app);
+    }
+    // all record writes of one event share a single index write
+    if(app->index.dirty) {
+        rfid_index_save(app);
+    }
 
-        // Handle view switching
-        if(app->state == RfidAppStateInputData && app->byte_input_view_port == NULL) {
-            // Switch to byte input view
-            gui_remove_view_port(app->gui, app->view_port);
-
-            // Create byte input ViewPort
-            app->byte_input_view_port = view_port_alloc();
-            view_port_draw_callback_set(
-                app->byte_input_view_port, byte_input_view_port_draw_callback, app);
-            view_port_input_callback_set(
-                app->byte_input_view_port, byte_input_view_port_input_callback, app);
-            gui_add_view_port(app->gui, app->byte_input_view_port, GuiLayerFullscreen);
-
-        } else if(app->state != RfidAppStateInputData && app->byte_input_view_port != NULL) {
-            // Switch back to main view
-            gui_remove_view_port(app->gui, app->byte_input_view_port);
-            view_port_free(app->byte_input_view_port);
-            app->byte_input_view_port = NULL;
-            gui_add_view_port(app->gui, app->view_port, GuiLayerFullscreen);
-        }
+    if(furi_get_tick() - app->heap_report_tick >= furi_ms_to_ticks(RFID_HEAP_REPORT_S * 1000)) {
+        rfid_app_heap_report(app);
+    }
+
+    // Handle view switching
+    if(app->fsm.state == RfidAppStateInputData && app->byte_input_view_port == NULL) {
+        // Switch to byte input view
+        gui_remove_view_port(app->gui, app->view_port);
+
+        // Create byte input ViewPort, its keys go through the same event queue
+        app->byte_input_view_port = view_port_alloc();
+        view_port_draw_callback_set(
+            app->byte_input_view_port, byte_input_view_port_draw_callback, app);
+        view_port_input_callback_set(app->byte_input_view_port, app_input_callback, app);
+        gui_add_view_port(app->gui, app->byte_input_view_port, GuiLayerFullscreen);
+        rfid_app_mark_dirty(app);
+
+    } else if(app->fsm.state != RfidAppStateInputData && app->byte_input_view_port != NULL) {
+        // Switch back to main view
+        gui_remove_view_port(app->gui, app->byte_input_view_port);
+        view_port_free(app->byte_input_view_port);
+        app->byte_input_view_port = NULL;
+        gui_add_view_port(app->gui, app->view_port, GuiLayerFullscreen);
+        rfid_app_mark_dirty(app);
+    }
 
+    // only redraw when something changed, queue timeouts alone don't touch the screen
+    if(app->view_dirty) {
+        app->view_dirty = false;
         view_port_update(app->view_port);
         if(app->byte_input_view_port) {
             view_port_update(app->byte_input_view_port);
         }
     }
+    return app->running;
+}
 
-    // Cleanup
+void rfid_app_free(RfidApp* app) {
+    rfid_app_heap_report(app);
+    if(app->trace_play) {
+        event_trace_free(app->trace_play);
+    }
+    if(app->trace_rec) {
+        event_trace_free(app->trace_rec);
+    }
     lfrfid_worker_stop(app->worker);
     lfrfid_worker_stop_thread(app->worker);
     lfrfid_worker_free(app->worker);
     protocol_dict_free(app->protocols);
+    chain_pool_free(app->chain_pool);
+    audit_log_free(app->audit_log);
+    rfid_library_free(app);
     view_port_enabled_set(app->view_port, false);
     gui_remove_view_port(app->gui, app->view_port);
     if(app->byte_input_view_port) {
@@ -1075,7 +3277,48 @@ int32_t rfid_app_main(void* p) {
     furi_record_close(RECORD_GUI);
     furi_message_queue_free(app->event_queue);
     furi_string_free(app->status_text);
-    free(app);
+    flipper_format_free(app->file);
+    furi_record_close(RECORD_STORAGE);
+    free(app->arena.base); // app itself lives in there
+}
+
+bool rfid_app_replay(RfidApp* app, bool real_speed) {
+    // as if picked from the menu, then OK or Right
+    rfid_app_set_state(app, RfidAppStateTraceReplay);
+    RfidAppEvent event = {
+        .type = real_speed ? RfidAppEventOk : RfidAppEventRight,
+        .protocol = PROTOCOL_NO,
+        .tick = furi_get_tick(),
+    };
+    rfid_app_dispatch(app, &event);
+    return app->replaying;
+}
+
+bool rfid_app_replaying(const RfidApp* app) {
+    return app->replaying;
+}
+
+void rfid_app_replay_report(const RfidApp* app, RfidAppReplayReport* report) {
+    report->events = app->replay_events;
+    report->ms = app->replay_ms;
+    report->recorded_ms = app->replay_tick - app->replay_rec_start;
+    report->cycles = app->replay_cycles;
+    report->max_cycles = app->replay_max_cycles;
+    report->max_type = app->replay_max_type;
+    report->max_state = app->replay_max_state;
+    report->aborted = app->replay_aborted;
+    memcpy(report->taps, app->replay_taps, sizeof(report->taps));
+}
+
+RfidAppState rfid_app_state(const RfidApp* app) {
+    return app->fsm.state;
+}
 
+int32_t rfid_app_main(void* p) {
+    UNUSED(p);
+    RfidApp* app = rfid_app_alloc();
+    while(rfid_app_step(app)) {
+    }
+    rfid_app_free(app);
     return 0;
 }
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "rfid_app_fsm.h"
+#include "helpers/audit_log.h"
+
+/*
+ * The app below rfid_app_main, which is alloc, step until closed, free. tools/trace_replay
+ * drives it the same way on a host, with the SDK shim in tools/host, to replay a trace
+ * recorded on the device through the real state machine.
+ */
+
+// what the last replay did, the numbers its summary screen shows
+typedef struct {
+    uint32_t events;
+    uint32_t ms; // how long the whole replay took
+    uint32_t recorded_ms; // the time the recording spanned up to where the replay stopped
+    uint64_t cycles; // spent handling the replayed events, DWT cycles
+    uint32_t max_cycles; // slowest single event
+    uint8_t max_type; // RfidAppEventType of the slowest event
+    uint8_t max_state; // RfidAppState it was handled in
+    bool aborted; // a long Back stopped it
+    uint16_t taps[AuditResultCount]; // tap outcomes the replay would have logged
+} RfidAppReplayReport;
+
+// opens the card store and starts the threads, the worker and the view port
+RfidApp* rfid_app_alloc(void);
+
+// handles one event: the next one of a replay, else a queued one or a tick after 100 ms
+// without one. Returns false once the app was closed
+bool rfid_app_step(RfidApp* app);
+
+void rfid_app_free(RfidApp* app);
+
+// starts replaying RFID_TRACE_PATH as the Replay Trace screen does, OK for real speed or Right
+// for full speed. Returns false if it didn't start; rfid_app_step hands out its events
+bool rfid_app_replay(RfidApp* app, bool real_speed);
+
+bool rfid_app_replaying(const RfidApp* app);
+
+void rfid_app_replay_report(const RfidApp* app, RfidAppReplayReport* report);
+
+RfidAppState rfid_app_state(const RfidApp* app);
@@ -0,0 +1,408 @@
+#include "rfid_app_fsm.h"
+
+_Static_assert(RfidAppStateCount <= 64, "action exits keep a bit per state");
+
+#define T(action, next) {RfidAppAction##action, RfidAppState##next}
+
+// state x event -> action, next state. Empty cells ignore the event
+const RfidAppTransition rfid_app_transitions[RfidAppStateCount][RfidAppEventCount] = {
+    [RfidAppStateIdle] = {
+        [RfidAppEventOk] = T(ReadTag, Reading),
+        [RfidAppEventUp] = T(None, Menu),
+        [RfidAppEventDown] = T(EmulateTag, Emulating),
+        [RfidAppEventBack] = T(Exit, Keep),
+        [RfidAppEventBackLong] = T(Exit, Keep),
+    },
+    [RfidAppStateReading] = {
+        [RfidAppEventCardSensed] = T(CardSensed, Keep),
+        [RfidAppEventCardRemoved] = T(CardRemoved, Idle),
+        [RfidAppEventReadDone] = T(ReadDone, Idle),
+        [RfidAppEventBack] = T(StopWorker, Idle),
+    },
+    [RfidAppStateEmulating] = {
+        [RfidAppEventBack] = T(StopEmulate, Idle),
+    },
+    [RfidAppStateWriting] = {
+        [RfidAppEventBack] = T(CancelWrite, Idle),
+        [RfidAppEventWriteOk] = T(WriteDone, Menu),
+        [RfidAppEventWriteFail] = T(WriteDone, Menu),
+    },
+    [RfidAppStateMenu] = {
+        [RfidAppEventUp] = T(MenuUp, Keep),
+        [RfidAppEventDown] = T(MenuDown, Keep),
+        [RfidAppEventOk] = T(MenuSelect, Keep),
+        [RfidAppEventBack] = T(None, Idle),
+    },
+    [RfidAppStateInputOffset] = {
+        [RfidAppEventUp] = T(OffsetUp, Keep),
+        [RfidAppEventDown] = T(OffsetDown, Keep),
+        [RfidAppEventOk] = T(None, Menu),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateInputData] = {
+        [RfidAppEventUp] = T(InputByteUp, Keep),
+        [RfidAppEventDown] = T(InputByteDown, Keep),
+        [RfidAppEventLeft] = T(InputPrev, Keep),
+        [RfidAppEventRight] = T(InputNext, Keep),
+        [RfidAppEventOk] = T(InputCommit, Menu),
+        [RfidAppEventBackLong] = T(None, Menu), // Long press back to exit without saving
+    },
+    [RfidAppStateCreateHT] = {
+        [RfidAppEventWriteOk] = T(CreateDone, Keep),
+        [RfidAppEventWriteFail] = T(CreateDone, Keep),
+        [RfidAppEventBack] = T(CreateCancel, Menu),
+    },
+    [RfidAppStateCreateError] = {
+        [RfidAppEventOk] = T(CreateHashTag, CreateHT),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateCreateSuccess] = {
+        [RfidAppEventOk] = T(None, Menu),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateReadingHash] = {
+        [RfidAppEventCardSensed] = T(CardSensed, Keep),
+        [RfidAppEventReadDone] = T(HashReadDone, Keep),
+        [RfidAppEventUp] = T(HashReadProfile, Keep),
+        [RfidAppEventBack] = T(StopWorker, Menu),
+    },
+    [RfidAppStateReadingHashSuccess] = {
+        [RfidAppEventTick] = T(HashVerify, Keep),
+    },
+    [RfidAppStateWriteHash] = {
+        [RfidAppEventWriteOk] = T(HashWriteDone, Keep),
+        [RfidAppEventWriteFail] = T(HashWriteDone, Keep),
+        [RfidAppEventReadDone] = T(HashDeltaCheck, Keep),
+        [RfidAppEventTick] = T(HashDeltaTick, Keep),
+    },
+    [RfidAppStateHashError] = {
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateWriteHashSuccess] = {
+        [RfidAppEventOk] = T(ReadHashTag, ReadingHash),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateBatchCount] = {
+        [RfidAppEventUp] = T(BatchCountUp, Keep),
+        [RfidAppEventDown] = T(BatchCountDown, Keep),
+        [RfidAppEventOk] = T(BatchStart, BatchWrite),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateBatchWrite] = {
+        [RfidAppEventWriteOk] = T(BatchWritten, BatchRemove),
+        [RfidAppEventWriteFail] = T(BatchWriteFailed, Keep),
+        [RfidAppEventBack] = T(BatchFinish, BatchDone),
+    },
+    [RfidAppStateBatchRemove] = {
+        [RfidAppEventCardSensed] = T(PresenceSeen, Keep),
+        [RfidAppEventReadDone] = T(PresenceSeen, Keep),
+        [RfidAppEventTick] = T(BatchGone, BatchWrite),
+        [RfidAppEventCardRemoved] = T(BatchNext, BatchWrite),
+        [RfidAppEventOk] = T(BatchNext, BatchWrite),
+        [RfidAppEventBack] = T(BatchFinish, BatchDone),
+    },
+    [RfidAppStateBatchDone] = {
+        [RfidAppEventOk] = T(None, Menu),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateEmulateHash] = {
+        [RfidAppEventOk] = T(EmulateHashNext, Keep),
+        [RfidAppEventUp] = T(EmulateHashAuto, Keep),
+        [RfidAppEventLeft] = T(EmulateHashCardPrev, Keep),
+        [RfidAppEventRight] = T(EmulateHashCardNext, Keep),
+        [RfidAppEventTick] = T(EmulateHashTick, Keep),
+        [RfidAppEventBack] = T(EmulateHashStop, Menu),
+    },
+    [RfidAppStateCardBrowser] = {
+        [RfidAppEventUp] = T(BrowserUp, Keep),
+        [RfidAppEventDown] = T(BrowserDown, Keep),
+        [RfidAppEventLeft] = T(BrowserPageUp, Keep),
+        [RfidAppEventRight] = T(BrowserPageDown, Keep),
+        [RfidAppEventOk] = T(BrowserMark, Keep),
+        [RfidAppEventOkLong] = T(RevokeAsk, RevokeConfirm),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateRevokeConfirm] = {
+        [RfidAppEventOk] = T(Revoke, CardBrowser),
+        [RfidAppEventBack] = T(None, CardBrowser),
+    },
+    [RfidAppStateArchiveDone] = {
+        [RfidAppEventOk] = T(None, Menu),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateBenchmark] = {
+        [RfidAppEventOk] = T(Benchmark, Keep),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateCloneSetup] = {
+        [RfidAppEventUp] = T(CloneValueUp, Keep),
+        [RfidAppEventDown] = T(CloneValueDown, Keep),
+        [RfidAppEventLeft] = T(CloneFieldPrev, Keep),
+        [RfidAppEventRight] = T(CloneFieldNext, Keep),
+        [RfidAppEventOk] = T(CloneStart, CloneWrite),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateCloneWrite] = {
+        [RfidAppEventWriteOk] = T(CloneWritten, CloneRemove),
+        [RfidAppEventWriteFail] = T(BatchWriteFailed, Keep),
+        [RfidAppEventBack] = T(CloneFinish, CloneDone),
+    },
+    [RfidAppStateCloneRemove] = {
+        [RfidAppEventCardSensed] = T(PresenceSeen, Keep),
+        [RfidAppEventReadDone] = T(PresenceSeen, Keep),
+        [RfidAppEventTick] = T(CloneGone, CloneWrite),
+        [RfidAppEventCardRemoved] = T(CloneNext, CloneWrite),
+        [RfidAppEventOk] = T(CloneNext, CloneWrite),
+        [RfidAppEventBack] = T(CloneFinish, CloneDone),
+    },
+    [RfidAppStateCloneDone] = {
+        [RfidAppEventOk] = T(None, Menu),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateTagLibrary] = {
+        [RfidAppEventUp] = T(LibraryMove, Keep),
+        [RfidAppEventDown] = T(LibraryMove, Keep),
+        [RfidAppEventOk] = T(LibraryPlay, Keep),
+        [RfidAppEventRight] = T(LibrarySave, Keep),
+        [RfidAppEventOkLong] = T(LibraryRemove, Keep),
+        [RfidAppEventTick] = T(LibraryTick, Keep),
+        [RfidAppEventBack] = T(LibraryClose, Menu),
+    },
+    [RfidAppStateAuditQuery] = {
+        [RfidAppEventUp] = T(AuditCard, Keep),
+        [RfidAppEventDown] = T(AuditCard, Keep),
+        [RfidAppEventLeft] = T(AuditRange, Keep),
+        [RfidAppEventRight] = T(AuditRange, Keep),
+        [RfidAppEventOk] = T(AuditSearch, AuditResults),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateAuditResults] = {
+        [RfidAppEventUp] = T(AuditUp, Keep),
+        [RfidAppEventDown] = T(AuditDown, Keep),
+        [RfidAppEventBack] = T(None, AuditQuery),
+    },
+    [RfidAppStateTraceReplay] = {
+        [RfidAppEventOk] = T(ReplayStart, Keep),
+        [RfidAppEventRight] = T(ReplayStart, Keep),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+    [RfidAppStateTraceDone] = {
+        [RfidAppEventOk] = T(None, Menu),
+        [RfidAppEventBack] = T(None, Menu),
+    },
+};
+
+#undef T
+
+const RfidAppMenuItem rfid_app_menu_items[] = {
+    {"  Set Offset", RfidAppActionNone, RfidAppStateInputOffset},
+    {"  Input Data", RfidAppActionInputLoad, RfidAppStateInputData},
+    {"  Write Tag", RfidAppActionWriteTag, RfidAppStateWriting},
+    {"  Clone Sequence", RfidAppActionNone, RfidAppStateCloneSetup},
+    {"  Emulate Tag", RfidAppActionEmulateTag, RfidAppStateEmulating},
+    {"  Tag Library", RfidAppActionLibraryOpen, RfidAppStateTagLibrary},
+    {"  Create HashTag", RfidAppActionCreateHashTag, RfidAppStateCreateHT},
+    {"  Read HashTag", RfidAppActionReadHashTag, RfidAppStateReadingHash},
+    {"  Batch HashTags", RfidAppActionNone, RfidAppStateBatchCount},
+    {"  Emulate HashTag", RfidAppActionEmulateHash, RfidAppStateEmulateHash},
+    {"  Browse Cards", RfidAppActionBrowseCards, RfidAppStateCardBrowser},
+    {"  Tap Log", RfidAppActionNone, RfidAppStateAuditQuery},
+    {"  Export Cards", RfidAppActionExportCards, RfidAppStateArchiveDone},
+    {"  Import Cards", RfidAppActionImportCards, RfidAppStateArchiveDone},
+    {"  Import Verifiers", RfidAppActionImportVerifiers, RfidAppStateArchiveDone},
+    {"  Hash Benchmark", RfidAppActionBenchmark, RfidAppStateBenchmark},
+    {"  Replay Trace", RfidAppActionNone, RfidAppStateTraceReplay},
+};
+
+const size_t rfid_app_menu_count = sizeof(rfid_app_menu_items) / sizeof(rfid_app_menu_items[0]);
+
+#define S(state) (1ull << RfidAppState##state)
+
+// states action handlers enter themselves, instead of or before the next state of their cell.
+// MenuSelect's are those of the menu items
+static const uint64_t rfid_app_action_exits[RfidAppActionCount] = {
+    [RfidAppActionCreateHashTag] = S(CreateError) | S(DebugMsg) | S(CreateHT),
+    [RfidAppActionCreateDone] = S(CreateSuccess) | S(CreateError),
+    [RfidAppActionHashReadDone] = S(HashError) | S(ReadingHashSuccess),
+    [RfidAppActionHashVerify] = S(WriteHash) | S(WriteHashSuccess) | S(HashError),
+    [RfidAppActionHashWriteDone] = S(WriteHashSuccess) | S(HashError),
+    [RfidAppActionHashDeltaCheck] = S(WriteHashSuccess) | S(HashError),
+    [RfidAppActionBatchStart] = S(HashError),
+    [RfidAppActionBatchWritten] = S(BatchDone),
+    [RfidAppActionEmulateHash] = S(HashError),
+    [RfidAppActionRevoke] = S(HashError),
+    [RfidAppActionExportCards] = S(HashError),
+    [RfidAppActionImportCards] = S(HashError),
+    [RfidAppActionImportVerifiers] = S(HashError),
+    [RfidAppActionCloneWritten] = S(CloneDone),
+    // the replay it starts ends in TraceDone, entered between events
+    [RfidAppActionReplayStart] = S(Idle) | S(TraceDone),
+};
+
+#undef S
+
+// actions a held key repeats: moving through lists and stepping values
+static const bool rfid_app_action_repeats[RfidAppActionCount] = {
+    [RfidAppActionMenuUp] = true,
+    [RfidAppActionMenuDown] = true,
+    [RfidAppActionOffsetUp] = true,
+    [RfidAppActionOffsetDown] = true,
+    [RfidAppActionInputByteUp] = true,
+    [RfidAppActionInputByteDown] = true,
+    [RfidAppActionInputPrev] = true,
+    [RfidAppActionInputNext] = true,
+    [RfidAppActionBatchCountUp] = true,
+    [RfidAppActionBatchCountDown] = true,
+    [RfidAppActionBrowserUp] = true,
+    [RfidAppActionBrowserDown] = true,
+    [RfidAppActionBrowserPageUp] = true,
+    [RfidAppActionBrowserPageDown] = true,
+    [RfidAppActionCloneValueUp] = true,
+    [RfidAppActionCloneValueDown] = true,
+    [RfidAppActionLibraryMove] = true,
+    [RfidAppActionAuditCard] = true,
+    [RfidAppActionAuditUp] = true,
+    [RfidAppActionAuditDown] = true,
+};
+
+// states that ask before something can't be undone: only a fresh short OK confirms, the long
+// press that opened them doesn't fall through to Ok and held keys don't repeat into them
+static const bool rfid_app_state_confirms[RfidAppStateCount] = {
+    [RfidAppStateRevokeConfirm] = true,
+};
+
+static uint64_t rfid_app_fsm_exits(uint8_t action) {
+    uint64_t exits = rfid_app_action_exits[action];
+    if(action == RfidAppActionMenuSelect) {
+        for(size_t i = 0; i < rfid_app_menu_count; i++) {
+            exits |= rfid_app_action_exits[rfid_app_menu_items[i].action] |
+                     1ull << rfid_app_menu_items[i].next;
+        }
+    }
+    return exits;
+}
+
+bool rfid_app_fsm_event_from_input(uint8_t key, uint8_t press, RfidAppEvent* event) {
+    static const uint8_t key_events[RfidAppKeyCount] = {
+        [RfidAppKeyUp] = RfidAppEventUp,
+        [RfidAppKeyDown] = RfidAppEventDown,
+        [RfidAppKeyRight] = RfidAppEventRight,
+        [RfidAppKeyLeft] = RfidAppEventLeft,
+        [RfidAppKeyOk] = RfidAppEventOk,
+        [RfidAppKeyBack] = RfidAppEventBack,
+    };
+
+    if(key >= RfidAppKeyCount) {
+        return false;
+    }
+    event->repeat = false;
+    // OK and Back act once per press: short, or long after 300 ms. They never repeat
+    if(key == RfidAppKeyOk || key == RfidAppKeyBack) {
+        if(press == RfidAppPressShort) {
+            event->type = key_events[key];
+        } else if(press == RfidAppPressLong) {
+            event->type = key == RfidAppKeyOk ? RfidAppEventOkLong : RfidAppEventBackLong;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    // a held direction key acts once at its long press, its repeats only scroll
+    if(press == RfidAppPressRepeat) {
+        event->repeat = true;
+    } else if(press != RfidAppPressShort && press != RfidAppPressLong) {
+        return false;
+    }
+    event->type = key_events[key];
+    return true;
+}
+
+const RfidAppTransition* rfid_app_fsm_lookup(RfidAppState state, const RfidAppEvent* event) {
+    const RfidAppTransition* cell = &rfid_app_transitions[state][event->type];
+    // states without a long press action take it as a short press
+    if(event->type == RfidAppEventOkLong && cell->action == RfidAppActionNone &&
+       cell->next == RfidAppStateKeep && !rfid_app_state_confirms[state]) {
+        cell = &rfid_app_transitions[state][RfidAppEventOk];
+    }
+    if(cell->action == RfidAppActionNone && cell->next == RfidAppStateKeep) {
+        return NULL;
+    }
+    if(event->repeat && !rfid_app_action_repeats[cell->action]) {
+        return NULL;
+    }
+    return cell;
+}
+
+bool rfid_app_fsm_run(
+    RfidAppFsm* fsm,
+    RfidApp* app,
+    uint8_t action,
+    uint8_t next,
+    const RfidAppEvent* event) {
+    RfidAppActionHandler handler = fsm->actions[action];
+    uint8_t outer = fsm->action;
+    fsm->action = action;
+    bool done = !handler || handler(app, event);
+    fsm->action = outer;
+    if(!done) {
+        return false;
+    }
+    if(next != RfidAppStateKeep) {
+        fsm->enter(app, next);
+    }
+    return true;
+}
+
+bool rfid_app_fsm_dispatch(RfidAppFsm* fsm, RfidApp* app, const RfidAppEvent* event) {
+    const RfidAppTransition* cell = rfid_app_fsm_lookup(fsm->state, event);
+    if(!cell) {
+        return false;
+    }
+    rfid_app_fsm_run(fsm, app, cell->action, cell->next, event);
+    return true;
+}
+
+bool rfid_app_fsm_may_enter(const RfidAppFsm* fsm, RfidAppState state) {
+    return fsm->action == RfidAppActionNone || (rfid_app_fsm_exits(fsm->action) >> state & 1);
+}
+
+bool rfid_app_fsm_check(bool reached[RfidAppStateCount]) {
+    bool valid = true;
+    for(uint8_t state = 0; state < RfidAppStateCount; state++) {
+        reached[state] = state == RfidAppStateIdle;
+    }
+    for(size_t i = 0; i < rfid_app_menu_count; i++) {
+        const RfidAppMenuItem* item = &rfid_app_menu_items[i];
+        valid &= item->action < RfidAppActionCount && item->next < RfidAppStateCount &&
+                 item->next != RfidAppStateKeep;
+    }
+    bool grew = true;
+    while(grew) {
+        grew = false;
+        for(uint8_t state = RfidAppStateIdle; state < RfidAppStateCount; state++) {
+            for(uint8_t type = 0; type < RfidAppEventCount; type++) {
+                const RfidAppTransition* cell = &rfid_app_transitions[state][type];
+                if(cell->action >= RfidAppActionCount || cell->next >= RfidAppStateCount) {
+                    valid = false;
+                    continue;
+                }
+                if(!reached[state]) {
+                    continue;
+                }
+                uint64_t exits = rfid_app_fsm_exits(cell->action);
+                if(cell->next != RfidAppStateKeep) {
+                    exits |= 1ull << cell->next;
+                }
+                for(uint8_t next = RfidAppStateIdle; next < RfidAppStateCount; next++) {
+                    if((exits >> next & 1) && !reached[next]) {
+                        reached[next] = grew = true;
+                    }
+                }
+            }
+        }
+    }
+    for(uint8_t state = RfidAppStateIdle; state < RfidAppStateCount; state++) {
+        valid &= reached[state];
+    }
+    return valid;
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * The app's state machine: states, events, actions, the state x event transition table,
+ * the main menu and the dispatch that runs them. Nothing here depends on the SDK, action
+ * handlers and the state change itself come in through RfidAppFsm, so the tables can be
+ * checked and driven on a host.
+ */
+
+typedef enum {
+    RfidAppStateKeep, // transition table only: stay in the current state
+    RfidAppStateIdle,
+    RfidAppStateReading,
+    RfidAppStateEmulating,
+    RfidAppStateWriting,
+    RfidAppStateMenu,
+    RfidAppStateInputOffset,
+    RfidAppStateInputData,
+    RfidAppStateCreateHT,
+    RfidAppStateCreateError,
+    RfidAppStateCreateSuccess,
+    RfidAppStateReadingHash,
+    RfidAppStateReadingHashSuccess,
+    RfidAppStateWriteHash,
+    RfidAppStateHashError,
+    RfidAppStateWriteHashSuccess,
+    RfidAppStateDebugMsg,
+    RfidAppStateBatchCount,
+    RfidAppStateBatchWrite,
+    RfidAppStateBatchRemove,
+    RfidAppStateBatchDone,
+    RfidAppStateEmulateHash,
+    RfidAppStateCardBrowser,
+    RfidAppStateRevokeConfirm,
+    RfidAppStateArchiveDone,
+    RfidAppStateBenchmark,
+    RfidAppStateCloneSetup,
+    RfidAppStateCloneWrite,
+    RfidAppStateCloneRemove,
+    RfidAppStateCloneDone,
+    RfidAppStateTagLibrary,
+    RfidAppStateAuditQuery,
+    RfidAppStateAuditResults,
+    RfidAppStateTraceReplay,
+    RfidAppStateTraceDone,
+    RfidAppStateCount,
+} RfidAppState;
+
+// everything the state machine reacts to, both key presses and worker results
+typedef enum {
+    RfidAppEventUp,
+    RfidAppEventDown,
+    RfidAppEventLeft,
+    RfidAppEventRight,
+    RfidAppEventOk,
+    RfidAppEventBack,
+    RfidAppEventBackLong,
+    RfidAppEventOkLong,
+    RfidAppEventCardSensed, // worker saw a card in the field
+    RfidAppEventCardRemoved, // card left the field before a read finished
+    RfidAppEventReadDone, // worker decoded a tag, payload is in data
+    RfidAppEventWriteOk,
+    RfidAppEventWriteFail,
+    RfidAppEventTick, // queue timeout, drives timed transitions
+    RfidAppEventCount,
+} RfidAppEventType;
+
+typedef struct {
+    RfidAppEventType type;
+    uint8_t data[8]; // tag data for RfidAppEventReadDone
+    int32_t protocol; // ProtocolId of that data
+    uint32_t tick; // kernel tick it was posted at
+    bool repeat; // auto repeat of a held direction key, only moving through lists takes it
+} RfidAppEvent;
+
+// InputKey and InputType, in the same order: rfid_app.c checks they match
+typedef enum {
+    RfidAppKeyUp,
+    RfidAppKeyDown,
+    RfidAppKeyRight,
+    RfidAppKeyLeft,
+    RfidAppKeyOk,
+    RfidAppKeyBack,
+    RfidAppKeyCount,
+} RfidAppKey;
+
+typedef enum {
+    RfidAppPressPress,
+    RfidAppPressRelease,
+    RfidAppPressShort,
+    RfidAppPressLong,
+    RfidAppPressRepeat,
+    RfidAppPressCount,
+} RfidAppPress;
+
+typedef enum {
+    RfidAppActionNone,
+    RfidAppActionExit,
+    RfidAppActionReadTag,
+    RfidAppActionReadDone,
+    RfidAppActionCardSensed,
+    RfidAppActionCardRemoved,
+    RfidAppActionStopWorker,
+    RfidAppActionStopEmulate,
+    RfidAppActionCancelWrite,
+    RfidAppActionWriteTag,
+    RfidAppActionWriteDone,
+    RfidAppActionEmulateTag,
+    RfidAppActionMenuUp,
+    RfidAppActionMenuDown,
+    RfidAppActionMenuSelect,
+    RfidAppActionOffsetUp,
+    RfidAppActionOffsetDown,
+    RfidAppActionInputLoad,
+    RfidAppActionInputByteUp,
+    RfidAppActionInputByteDown,
+    RfidAppActionInputPrev,
+    RfidAppActionInputNext,
+    RfidAppActionInputCommit,
+    RfidAppActionCreateHashTag,
+    RfidAppActionCreateDone,
+    RfidAppActionCreateCancel,
+    RfidAppActionReadHashTag,
+    RfidAppActionHashReadDone,
+    RfidAppActionHashReadProfile,
+    RfidAppActionHashVerify,
+    RfidAppActionHashWriteDone,
+    RfidAppActionHashDeltaCheck,
+    RfidAppActionHashDeltaTick,
+    RfidAppActionBatchCountUp,
+    RfidAppActionBatchCountDown,
+    RfidAppActionBatchStart,
+    RfidAppActionBatchWritten,
+    RfidAppActionBatchWriteFailed,
+    RfidAppActionBatchNext,
+    RfidAppActionBatchGone, // BatchNext once the written card has left the field
+    RfidAppActionBatchFinish,
+    RfidAppActionEmulateHash,
+    RfidAppActionEmulateHashNext,
+    RfidAppActionEmulateHashAuto,
+    RfidAppActionEmulateHashTick,
+    RfidAppActionEmulateHashCardPrev,
+    RfidAppActionEmulateHashCardNext,
+    RfidAppActionEmulateHashStop,
+    RfidAppActionBrowseCards,
+    RfidAppActionBrowserUp,
+    RfidAppActionBrowserDown,
+    RfidAppActionBrowserPageUp,
+    RfidAppActionBrowserPageDown,
+    RfidAppActionBrowserMark,
+    RfidAppActionRevokeAsk,
+    RfidAppActionRevoke,
+    RfidAppActionExportCards,
+    RfidAppActionImportCards,
+    RfidAppActionImportVerifiers,
+    RfidAppActionBenchmark,
+    RfidAppActionCloneValueUp,
+    RfidAppActionCloneValueDown,
+    RfidAppActionCloneFieldPrev,
+    RfidAppActionCloneFieldNext,
+    RfidAppActionCloneStart,
+    RfidAppActionCloneWritten,
+    RfidAppActionCloneNext,
+    RfidAppActionCloneGone, // CloneNext once the written card has left the field
+    RfidAppActionCloneFinish,
+    RfidAppActionLibraryOpen,
+    RfidAppActionLibraryMove,
+    RfidAppActionLibraryPlay,
+    RfidAppActionLibrarySave,
+    RfidAppActionLibraryRemove,
+    RfidAppActionLibraryTick,
+    RfidAppActionLibraryClose,
+    RfidAppActionAuditCard,
+    RfidAppActionAuditRange,
+    RfidAppActionAuditSearch,
+    RfidAppActionAuditUp,
+    RfidAppActionAuditDown,
+    RfidAppActionReplayStart,
+    RfidAppActionPresenceSeen, // the card that was just written is still there
+    RfidAppActionCount,
+} RfidAppAction;
+
+// one cell of the transition table, two bytes so the whole table stays small
+typedef struct {
+    uint8_t action; // RfidAppAction
+    uint8_t next; // RfidAppState, RfidAppStateKeep to stay
+} RfidAppTransition;
+
+// main menu entries, selecting one runs its action and moves to its state
+typedef struct {
+    const char* label;
+    uint8_t action; // RfidAppAction
+    uint8_t next; // RfidAppState
+} RfidAppMenuItem;
+
+// the transition table, see rfid_app_fsm.c
+extern const RfidAppTransition rfid_app_transitions[RfidAppStateCount][RfidAppEventCount];
+
+extern const RfidAppMenuItem rfid_app_menu_items[];
+extern const size_t rfid_app_menu_count;
+
+typedef struct RfidApp RfidApp;
+
+// returns false if the action didn't finish the transition, the next state isn't entered then
+typedef bool (*RfidAppActionHandler)(RfidApp* app, const RfidAppEvent* event);
+
+typedef struct {
+    const RfidAppActionHandler* actions; // one per RfidAppAction, NULL for none
+    void (*enter)(RfidApp* app, RfidAppState state); // sets state, called for every state change
+    RfidAppState state;
+    uint8_t action; // RfidAppAction being run, RfidAppActionNone between events
+} RfidAppFsm;
+
+// the event for an input event, returns false for input the app doesn't react to
+bool rfid_app_fsm_event_from_input(uint8_t key, uint8_t press, RfidAppEvent* event);
+
+// the cell of state for the event, NULL if the state ignores it
+const RfidAppTransition* rfid_app_fsm_lookup(RfidAppState state, const RfidAppEvent* event);
+
+// runs action and, if it finished, enters next unless that is RfidAppStateKeep
+bool rfid_app_fsm_run(
+    RfidAppFsm* fsm,
+    RfidApp* app,
+    uint8_t action,
+    uint8_t next,
+    const RfidAppEvent* event);
+
+// returns false if the current state ignores the event
+bool rfid_app_fsm_dispatch(RfidAppFsm* fsm, RfidApp* app, const RfidAppEvent* event);
+
+// true if the running action is allowed to enter state itself, or no action runs
+bool rfid_app_fsm_may_enter(const RfidAppFsm* fsm, RfidAppState state);
+
+// walks every cell, menu item and action exit: actions and next states have to be in range,
+// and every state has to be reachable from Idle. reached gets the states that are
+bool rfid_app_fsm_check(bool reached[RfidAppStateCount]);
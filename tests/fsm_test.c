@@ -0,0 +1,326 @@
+#include "rfid_app_fsm.h"
+
+#include <stdio.h>
+
+// what the stub handlers see of the app
+struct RfidApp {
+    RfidAppFsm fsm;
+    bool finish; // what every handler returns
+    uint8_t ran; // last action a handler ran for
+    uint8_t menu_selected;
+};
+
+static int failures;
+
+#define CHECK(cond, ...)                                              \
+    do {                                                              \
+        if(!(cond)) {                                                 \
+            failures++;                                               \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond);         \
+            printf(__VA_ARGS__);                                      \
+            printf("\n");                                             \
+        }                                                             \
+    } while(0)
+
+static void stub_enter(RfidApp* app, RfidAppState state) {
+    app->fsm.state = state;
+}
+
+static bool stub_action(RfidApp* app, const RfidAppEvent* event) {
+    (void)event;
+    app->ran = app->fsm.action;
+    return app->finish;
+}
+
+// like the app's: runs the selected item's action and moves to its state
+static bool stub_menu_select(RfidApp* app, const RfidAppEvent* event) {
+    const RfidAppMenuItem* item = &rfid_app_menu_items[app->menu_selected];
+    rfid_app_fsm_run(&app->fsm, app, item->action, item->next, event);
+    return true;
+}
+
+static RfidAppActionHandler stub_actions[RfidAppActionCount];
+
+static void app_init(RfidApp* app, RfidAppState state, bool finish) {
+    app->fsm = (RfidAppFsm){.actions = stub_actions, .enter = stub_enter, .state = state};
+    app->finish = finish;
+    app->ran = RfidAppActionNone;
+    app->menu_selected = 0;
+}
+
+static bool cell_empty(const RfidAppTransition* cell) {
+    return cell->action == RfidAppActionNone && cell->next == RfidAppStateKeep;
+}
+
+// every event in every state, with actions that finish and ones that don't
+static void test_transitions(void) {
+    for(int finish = 0; finish < 2; finish++) {
+        for(uint8_t state = RfidAppStateIdle; state < RfidAppStateCount; state++) {
+            for(uint8_t type = 0; type < RfidAppEventCount; type++) {
+                const RfidAppTransition* cell = &rfid_app_transitions[state][type];
+                CHECK(cell->action < RfidAppActionCount, "state %u event %u", state, type);
+                CHECK(cell->next < RfidAppStateCount, "state %u event %u", state, type);
+                if(type == RfidAppEventOkLong && cell_empty(cell) &&
+                   state != RfidAppStateRevokeConfirm) {
+                    cell = &rfid_app_transitions[state][RfidAppEventOk];
+                }
+
+                RfidApp app;
+                app_init(&app, state, finish);
+                RfidAppEvent event = {.type = type};
+                bool handled = rfid_app_fsm_dispatch(&app.fsm, &app, &event);
+
+                CHECK(handled == !cell_empty(cell), "state %u event %u", state, type);
+                CHECK(app.fsm.action == RfidAppActionNone, "state %u event %u", state, type);
+                if(cell->action == RfidAppActionMenuSelect) {
+                    const RfidAppMenuItem* item = &rfid_app_menu_items[0];
+                    CHECK(app.ran == item->action, "state %u event %u", state, type);
+                    CHECK(
+                        app.fsm.state == (finish || item->action == RfidAppActionNone ?
+                                              item->next :
+                                              state),
+                        "state %u event %u", state, type);
+                    continue;
+                }
+                CHECK(app.ran == cell->action, "state %u event %u", state, type);
+                uint8_t expected = state;
+                if(cell->next != RfidAppStateKeep &&
+                   (finish || cell->action == RfidAppActionNone)) {
+                    expected = cell->next;
+                }
+                CHECK(
+                    app.fsm.state == expected,
+                    "state %u event %u: in %u, expected %u",
+                    state,
+                    type,
+                    app.fsm.state,
+                    expected);
+            }
+        }
+    }
+}
+
+static void test_menu(void) {
+    CHECK(rfid_app_menu_count > 0, "empty menu");
+    for(size_t i = 0; i < rfid_app_menu_count; i++) {
+        const RfidAppMenuItem* item = &rfid_app_menu_items[i];
+        CHECK(item->action < RfidAppActionCount, "item %zu", i);
+        CHECK(item->next > RfidAppStateKeep && item->next < RfidAppStateCount, "item %zu", i);
+
+        RfidApp app;
+        app_init(&app, RfidAppStateMenu, true);
+        app.menu_selected = i;
+        RfidAppEvent event = {.type = RfidAppEventOk};
+        CHECK(rfid_app_fsm_dispatch(&app.fsm, &app, &event), "item %zu", i);
+        CHECK(app.ran == item->action, "item %zu ran %u", i, app.ran);
+        CHECK(app.fsm.state == item->next, "item %zu in %u", i, app.fsm.state);
+    }
+}
+
+static void test_reachable(void) {
+    bool reached[RfidAppStateCount];
+    CHECK(rfid_app_fsm_check(reached), "table check failed");
+    for(uint8_t state = RfidAppStateIdle; state < RfidAppStateCount; state++) {
+        CHECK(reached[state], "state %u can't be reached from Idle", state);
+    }
+}
+
+// the states an action may enter itself come from its exits, nothing else
+static void test_may_enter(void) {
+    RfidApp app;
+    app_init(&app, RfidAppStateIdle, true);
+    for(uint8_t state = RfidAppStateIdle; state < RfidAppStateCount; state++) {
+        CHECK(rfid_app_fsm_may_enter(&app.fsm, state), "between events, state %u", state);
+    }
+    app.fsm.action = RfidAppActionHashVerify;
+    CHECK(rfid_app_fsm_may_enter(&app.fsm, RfidAppStateWriteHash), "HashVerify");
+    CHECK(rfid_app_fsm_may_enter(&app.fsm, RfidAppStateHashError), "HashVerify");
+    CHECK(!rfid_app_fsm_may_enter(&app.fsm, RfidAppStateMenu), "HashVerify");
+    app.fsm.action = RfidAppActionMenuUp;
+    CHECK(!rfid_app_fsm_may_enter(&app.fsm, RfidAppStateIdle), "MenuUp");
+    app.fsm.action = RfidAppActionMenuSelect;
+    for(size_t i = 0; i < rfid_app_menu_count; i++) {
+        CHECK(rfid_app_fsm_may_enter(&app.fsm, rfid_app_menu_items[i].next), "item %zu", i);
+    }
+    // the exits of an item's action are MenuSelect's too
+    CHECK(rfid_app_fsm_may_enter(&app.fsm, RfidAppStateCreateError), "MenuSelect");
+    CHECK(!rfid_app_fsm_may_enter(&app.fsm, RfidAppStateRevokeConfirm), "MenuSelect");
+}
+
+// every state leads back to Idle, through cells and the states actions enter
+static void test_way_back(void) {
+    bool home[RfidAppStateCount] = {[RfidAppStateIdle] = true};
+    bool grew = true;
+    while(grew) {
+        grew = false;
+        for(uint8_t state = RfidAppStateIdle; state < RfidAppStateCount; state++) {
+            for(uint8_t type = 0; type < RfidAppEventCount && !home[state]; type++) {
+                const RfidAppTransition* cell = &rfid_app_transitions[state][type];
+                RfidAppFsm fsm = {.action = cell->action};
+                for(uint8_t next = RfidAppStateIdle; next < RfidAppStateCount; next++) {
+                    bool leads = next == cell->next ||
+                                 (cell->action != RfidAppActionNone &&
+                                  rfid_app_fsm_may_enter(&fsm, next));
+                    if(leads && home[next]) {
+                        home[state] = grew = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    for(uint8_t state = RfidAppStateIdle; state < RfidAppStateCount; state++) {
+        // CreateHashTag shows DebugMsg for a moment in DEBUG builds and moves on by itself
+        if(state == RfidAppStateDebugMsg) {
+            continue;
+        }
+        CHECK(home[state], "state %u has no way back to Idle", state);
+    }
+}
+
+static void test_input(void) {
+    RfidAppEvent event;
+    CHECK(rfid_app_fsm_event_from_input(RfidAppKeyOk, RfidAppPressShort, &event), "OK short");
+    CHECK(event.type == RfidAppEventOk && !event.repeat, "OK short");
+    CHECK(rfid_app_fsm_event_from_input(RfidAppKeyOk, RfidAppPressLong, &event), "OK long");
+    CHECK(event.type == RfidAppEventOkLong && !event.repeat, "OK long");
+    CHECK(rfid_app_fsm_event_from_input(RfidAppKeyBack, RfidAppPressShort, &event), "Back");
+    CHECK(event.type == RfidAppEventBack, "Back short");
+    CHECK(rfid_app_fsm_event_from_input(RfidAppKeyBack, RfidAppPressLong, &event), "Back");
+    CHECK(event.type == RfidAppEventBackLong, "Back long");
+    for(uint8_t key = RfidAppKeyOk; key <= RfidAppKeyBack; key++) {
+        CHECK(!rfid_app_fsm_event_from_input(key, RfidAppPressRepeat, &event), "key %u", key);
+        CHECK(!rfid_app_fsm_event_from_input(key, RfidAppPressPress, &event), "key %u", key);
+        CHECK(!rfid_app_fsm_event_from_input(key, RfidAppPressRelease, &event), "key %u", key);
+    }
+    CHECK(rfid_app_fsm_event_from_input(RfidAppKeyLeft, RfidAppPressShort, &event), "Left");
+    CHECK(event.type == RfidAppEventLeft && !event.repeat, "Left short");
+    CHECK(rfid_app_fsm_event_from_input(RfidAppKeyUp, RfidAppPressLong, &event), "Up long");
+    CHECK(event.type == RfidAppEventUp && !event.repeat, "Up long");
+    CHECK(rfid_app_fsm_event_from_input(RfidAppKeyDown, RfidAppPressRepeat, &event), "Down");
+    CHECK(event.type == RfidAppEventDown && event.repeat, "Down repeat");
+    CHECK(!rfid_app_fsm_event_from_input(RfidAppKeyRight, RfidAppPressRelease, &event), "Right");
+    CHECK(!rfid_app_fsm_event_from_input(RfidAppKeyCount, RfidAppPressShort, &event), "no key");
+}
+
+// a held key only scrolls and steps values: its repeats never change state or start anything
+static void test_repeats(void) {
+    for(uint8_t state = RfidAppStateIdle; state < RfidAppStateCount; state++) {
+        for(uint8_t type = 0; type < RfidAppEventCount; type++) {
+            RfidApp app;
+            app_init(&app, state, true);
+            RfidAppEvent event = {.type = type, .repeat = true};
+            bool handled = rfid_app_fsm_dispatch(&app.fsm, &app, &event);
+            CHECK(app.fsm.state == state, "state %u event %u moved to %u", state, type, app.fsm.state);
+            CHECK(!handled || rfid_app_transitions[state][type].next == RfidAppStateKeep,
+                  "state %u event %u", state, type);
+        }
+    }
+
+    RfidApp app;
+    app_init(&app, RfidAppStateMenu, true);
+    RfidAppEvent event = {.type = RfidAppEventDown, .repeat = true};
+    CHECK(rfid_app_fsm_dispatch(&app.fsm, &app, &event), "menu scrolls");
+    CHECK(app.ran == RfidAppActionMenuDown, "menu scrolls");
+    app_init(&app, RfidAppStateIdle, true);
+    event.type = RfidAppEventUp;
+    CHECK(!rfid_app_fsm_dispatch(&app.fsm, &app, &event), "Up held in Idle");
+    CHECK(app.fsm.state == RfidAppStateIdle, "Up held in Idle");
+}
+
+// feeds a key press the way the input service reports it, returns the number of events handled
+static int press(RfidApp* app, RfidAppKey key, const RfidAppPress* presses, size_t count) {
+    int handled = 0;
+    for(size_t i = 0; i < count; i++) {
+        RfidAppEvent event = {0};
+        if(rfid_app_fsm_event_from_input(key, presses[i], &event)) {
+            handled += rfid_app_fsm_dispatch(&app->fsm, app, &event);
+        }
+    }
+    return handled;
+}
+
+// holding OK in the browser asks once; only a new short OK revokes
+static void test_revoke_confirm(void) {
+    static const RfidAppPress hold[] = {
+        RfidAppPressPress,
+        RfidAppPressLong,
+        RfidAppPressRepeat,
+        RfidAppPressRepeat,
+        RfidAppPressRepeat,
+        RfidAppPressRelease,
+    };
+    static const RfidAppPress tap[] = {
+        RfidAppPressPress,
+        RfidAppPressShort,
+        RfidAppPressRelease,
+    };
+    RfidApp app;
+    app_init(&app, RfidAppStateCardBrowser, true);
+
+    CHECK(press(&app, RfidAppKeyOk, hold, 6) == 1, "hold in the browser");
+    CHECK(app.fsm.state == RfidAppStateRevokeConfirm, "hold in the browser: in %u", app.fsm.state);
+    CHECK(app.ran == RfidAppActionRevokeAsk, "hold in the browser ran %u", app.ran);
+
+    // a second hold doesn't confirm either
+    CHECK(press(&app, RfidAppKeyOk, hold, 6) == 0, "hold in the confirmation");
+    CHECK(app.fsm.state == RfidAppStateRevokeConfirm, "hold in the confirmation");
+    CHECK(app.ran == RfidAppActionRevokeAsk, "hold in the confirmation ran %u", app.ran);
+
+    CHECK(press(&app, RfidAppKeyOk, tap, 3) == 1, "tap in the confirmation");
+    CHECK(app.ran == RfidAppActionRevoke, "tap in the confirmation ran %u", app.ran);
+    CHECK(app.fsm.state == RfidAppStateCardBrowser, "tap in the confirmation");
+}
+
+// after a write, the card is polled until the gone action finds it has left the field
+static void test_removal(void) {
+    static const struct {
+        RfidAppState remove;
+        RfidAppState write;
+        RfidAppAction gone;
+    } writers[] = {
+        {RfidAppStateBatchRemove, RfidAppStateBatchWrite, RfidAppActionBatchGone},
+        {RfidAppStateCloneRemove, RfidAppStateCloneWrite, RfidAppActionCloneGone},
+    };
+    static const RfidAppEventType seen[] = {RfidAppEventCardSensed, RfidAppEventReadDone};
+    for(size_t w = 0; w < sizeof(writers) / sizeof(writers[0]); w++) {
+        RfidApp app;
+        for(size_t i = 0; i < sizeof(seen) / sizeof(seen[0]); i++) {
+            app_init(&app, writers[w].remove, true);
+            RfidAppEvent event = {.type = seen[i]};
+            CHECK(rfid_app_fsm_dispatch(&app.fsm, &app, &event), "state %u, event %u", writers[w].remove, seen[i]);
+            CHECK(app.ran == RfidAppActionPresenceSeen, "state %u, event %u ran %u", writers[w].remove, seen[i], app.ran);
+            CHECK(app.fsm.state == writers[w].remove, "state %u, event %u", writers[w].remove, seen[i]);
+        }
+        RfidAppEvent tick = {.type = RfidAppEventTick};
+        // still there: the gone action doesn't finish and the state stays
+        app_init(&app, writers[w].remove, false);
+        rfid_app_fsm_dispatch(&app.fsm, &app, &tick);
+        CHECK(app.ran == writers[w].gone, "state %u, tick ran %u", writers[w].remove, app.ran);
+        CHECK(app.fsm.state == writers[w].remove, "state %u, tick while present", writers[w].remove);
+        app_init(&app, writers[w].remove, true);
+        rfid_app_fsm_dispatch(&app.fsm, &app, &tick);
+        CHECK(app.fsm.state == writers[w].write, "state %u, tick once gone", writers[w].remove);
+    }
+}
+
+int main(void) {
+    for(size_t i = 0; i < RfidAppActionCount; i++) {
+        stub_actions[i] = stub_action;
+    }
+    stub_actions[RfidAppActionNone] = NULL;
+    stub_actions[RfidAppActionMenuSelect] = stub_menu_select;
+
+    test_transitions();
+    test_menu();
+    test_reachable();
+    test_may_enter();
+    test_way_back();
+    test_input();
+    test_repeats();
+    test_revoke_confirm();
+    test_removal();
+
+    printf("fsm_test: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+#include "helpers/hash_chain.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// more than two batches, with a partial one at the end
+#define HASH_CHAIN_TEST_CARDS (2 * HASH_CHAIN_BATCH + 5)
+#define HASH_CHAIN_TEST_SEED_LEN 16
+
+static int failures;
+
+#define CHECK(cond, ...)                                              \
+    do {                                                              \
+        if(!(cond)) {                                                 \
+            failures++;                                               \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond);         \
+            printf(__VA_ARGS__);                                      \
+            printf("\n");                                             \
+        }                                                             \
+    } while(0)
+
+static HashData batch[HASH_CHAIN_TEST_CARDS];
+static HashData single;
+
+// every backend and step length: the batch has to give the chains one by one would
+static void test_generate_batch(void) {
+    static const uint8_t key[] = "hash_chain_test site key";
+    uint8_t seeds[HASH_CHAIN_TEST_CARDS][HASH_CHAIN_TEST_SEED_LEN];
+    for(size_t n = 0; n < HASH_CHAIN_TEST_CARDS; n++) {
+        for(size_t i = 0; i < HASH_CHAIN_TEST_SEED_LEN; i++) {
+            seeds[n][i] = n * 31 + i * 7;
+        }
+    }
+    hash_backend_set_key(key, sizeof(key));
+    for(uint8_t backend = 0; backend < HashBackendCount; backend++) {
+        for(int short_step = 0; short_step < 2; short_step++) {
+            uint8_t flags = short_step ? HashRecordFlagShortStep : 0;
+            memset(batch, 0xA5, sizeof(batch));
+            CHECK(
+                hash_chain_generate_batch(batch, HASH_CHAIN_TEST_CARDS, backend, flags, &seeds[0][0], HASH_CHAIN_TEST_SEED_LEN),
+                "backend %u",
+                backend);
+            for(size_t n = 0; n < HASH_CHAIN_TEST_CARDS; n++) {
+                memset(&single, 0xA5, sizeof(single));
+                hash_chain_generate(&single, backend, flags, seeds[n], HASH_CHAIN_TEST_SEED_LEN);
+                if(memcmp(&single, &batch[n], sizeof(single)) != 0) {
+                    CHECK(false, "backend %u, flags %u, card %zu differs", backend, flags, n);
+                    break;
+                }
+            }
+        }
+    }
+    CHECK(!hash_chain_generate_batch(batch, 1, HashBackendCount, 0, &seeds[0][0], 1), "unknown backend");
+}
+
+int main(void) {
+    test_generate_batch();
+
+    printf("hash_chain_test: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+// replays a made up trace through the real app, rfid_app.c on the SDK shim in tools/host
+#define _GNU_SOURCE // mkdtemp
+
+#include "rfid_app.h"
+#include "helpers/chain_pool.h"
+#include "helpers/event_trace.h"
+
+#include <host_sdk.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+// kernel tick and RTC time the recording started at
+#define REPLAY_TEST_START_TICK 1000
+#define REPLAY_TEST_START_TIME 1700000000
+// an id no card of the trace has
+#define REPLAY_TEST_UNKNOWN_CARD 200
+
+static int failures;
+
+#define CHECK(cond, ...)                                              \
+    do {                                                              \
+        if(!(cond)) {                                                 \
+            failures++;                                               \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond);         \
+            printf(__VA_ARGS__);                                      \
+            printf("\n");                                             \
+        }                                                             \
+    } while(0)
+
+static char sd_root[64];
+// records written to the trace being made
+static uint32_t trace_events;
+
+static FILE* trace_open(void) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/rfid_hashes", sd_root);
+    mkdir(path, 0755);
+    // the recording started from an empty card store
+    snprintf(path, sizeof(path), "%s/rfid_hashes/trace", sd_root);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/rfid_hashes/trace.bin", sd_root);
+    FILE* trace = fopen(path, "wb");
+    uint8_t header[EVENT_TRACE_HEADER_SIZE] = {'H', 'T', 'T', 'R', EVENT_TRACE_VERSION, 0, 1000 & 0xFF, 1000 >> 8};
+    const uint32_t start[2] = {REPLAY_TEST_START_TICK, REPLAY_TEST_START_TIME};
+    for(uint8_t i = 0; i < 8; i++) {
+        header[8 + i] = start[i / 4] >> (8 * (i % 4));
+    }
+    fwrite(header, 1, sizeof(header), trace);
+    trace_events = 0;
+    return trace;
+}
+
+// one record as event_trace.h lays it out, data is the 5 byte EM4100 frame of a read
+static void trace_put(FILE* trace, uint32_t tick, RfidAppEventType type, const uint8_t* data) {
+    uint8_t record[EVENT_TRACE_RECORD_SIZE + EVENT_TRACE_DATA_SIZE] = {
+        tick, tick >> 8, tick >> 16, tick >> 24, 0, 0, type | (data ? EVENT_TRACE_HAS_DATA : 0)};
+    size_t len = EVENT_TRACE_RECORD_SIZE;
+    if(data) {
+        record[len] = LFRFIDProtocolEM4100;
+        memcpy(&record[len + 1], data, 5);
+        len += EVENT_TRACE_DATA_SIZE;
+    }
+    fwrite(record, 1, len, trace);
+    trace_events++;
+}
+
+// creates card 0, taps it, taps a card that doesn't exist and closes the app, returns the
+// tick of the last replayed event
+static uint32_t trace_session(void) {
+    FILE* trace = trace_open();
+    uint32_t tick = REPLAY_TEST_START_TICK;
+    trace_put(trace, tick += 100, RfidAppEventUp, NULL);
+    for(size_t i = 0; i < rfid_app_menu_count; i++) {
+        if(rfid_app_menu_items[i].next == RfidAppStateCreateHT) break;
+        trace_put(trace, tick += 100, RfidAppEventDown, NULL);
+    }
+    // the chain comes from the replay clock, the first one of the replay
+    uint32_t created = tick + 100;
+    HashData chain;
+    chain_pool_generate_from(
+        &chain,
+        REPLAY_TEST_START_TIME + (created - REPLAY_TEST_START_TICK) / 1000,
+        0,
+        (const uint8_t[CHAIN_POOL_NONCE_LEN]){0});
+    uint8_t frame[5] = {0};
+    memcpy(&frame[1], &chain.hash_bytes[chain.curr_idx], 4);
+    trace_put(trace, tick += 100, RfidAppEventOk, NULL);
+    trace_put(trace, tick += 700, RfidAppEventWriteOk, NULL);
+    trace_put(trace, tick += 100, RfidAppEventOk, NULL);
+
+    // Read HashTag is the next entry
+    trace_put(trace, tick += 100, RfidAppEventDown, NULL);
+    trace_put(trace, tick += 100, RfidAppEventOk, NULL);
+    trace_put(trace, tick += 200, RfidAppEventReadDone, frame);
+    // the value is shown for 3 s, then the delta write gets 1 s to read back before a full write
+    trace_put(trace, tick += 3100, RfidAppEventTick, NULL);
+    trace_put(trace, tick += 1100, RfidAppEventTick, NULL);
+    trace_put(trace, tick += 100, RfidAppEventWriteOk, NULL);
+
+    trace_put(trace, tick += 100, RfidAppEventOk, NULL);
+    frame[0] = REPLAY_TEST_UNKNOWN_CARD;
+    trace_put(trace, tick += 100, RfidAppEventReadDone, frame);
+    trace_put(trace, tick += 100, RfidAppEventBack, NULL);
+    trace_put(trace, tick += 100, RfidAppEventBack, NULL);
+    uint32_t last = tick;
+    // closes the app, the replay stops before it
+    trace_put(trace, tick += 100, RfidAppEventBack, NULL);
+    fclose(trace);
+    return last;
+}
+
+static bool replay(bool real_speed, RfidAppReplayReport* report, RfidAppState* state) {
+    RfidApp* app = rfid_app_alloc();
+    bool started = rfid_app_replay(app, real_speed);
+    while(started && rfid_app_replaying(app)) {
+        rfid_app_step(app);
+    }
+    rfid_app_replay_report(app, report);
+    *state = rfid_app_state(app);
+    rfid_app_free(app);
+    return started;
+}
+
+static bool replay_file_exists(const char* name) {
+    char path[128];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/rfid_hashes/replay/%s", sd_root, name);
+    return stat(path, &st) == 0;
+}
+
+// every file of the replay's card store, names and contents, into one buffer
+static size_t replay_store(uint8_t* out, size_t size) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/rfid_hashes/replay", sd_root);
+    struct dirent** names;
+    int count = scandir(path, &names, NULL, alphasort);
+    size_t len = 0;
+    for(int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "%s/rfid_hashes/replay/%s", sd_root, names[i]->d_name);
+        FILE* file = fopen(path, "rb");
+        struct stat st;
+        if(file && stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            len += snprintf((char*)out + len, size - len, "%s\n", names[i]->d_name);
+            len += fread(out + len, 1, size - len, file);
+        }
+        if(file) fclose(file);
+        free(names[i]);
+    }
+    free(names);
+    return len;
+}
+
+static void test_full_speed(void) {
+    uint32_t last = trace_session();
+    RfidAppReplayReport report;
+    RfidAppState state;
+    CHECK(replay(false, &report, &state), "replay didn't start");
+    CHECK(state == RfidAppStateTraceDone, "ended in state %u", state);
+    CHECK(!report.aborted, "aborted");
+    CHECK(report.events == trace_events - 1, "%u events", report.events);
+    CHECK(report.recorded_ms == last - REPLAY_TEST_START_TICK, "recorded %u ms", report.recorded_ms);
+    CHECK(report.ms < report.recorded_ms, "%u ms at full speed", report.ms);
+    CHECK(report.taps[AuditResultAccepted] == 1, "%u accepted", report.taps[AuditResultAccepted]);
+    CHECK(report.taps[AuditResultUnknown] == 1, "%u unknown", report.taps[AuditResultUnknown]);
+    // created in slot 0, the accepted tap wrote slot 1
+    CHECK(replay_file_exists("0.hashrf") && replay_file_exists("0.b.hashrf"), "card 0 files missing");
+}
+
+// two runs of a trace leave the same card store behind
+static void test_deterministic(void) {
+    static uint8_t first[64 * 1024], second[64 * 1024];
+    RfidAppReplayReport report;
+    RfidAppState state;
+    replay(false, &report, &state);
+    size_t first_len = replay_store(first, sizeof(first));
+    replay(false, &report, &state);
+    size_t second_len = replay_store(second, sizeof(second));
+    CHECK(first_len > 0 && first_len == second_len && memcmp(first, second, first_len) == 0,
+          "card stores differ, %zu and %zu bytes", first_len, second_len);
+}
+
+// at the recorded pace the replay takes at least as long as the recording
+static void test_real_speed(void) {
+    FILE* trace = trace_open();
+    trace_put(trace, REPLAY_TEST_START_TICK + 100, RfidAppEventUp, NULL);
+    trace_put(trace, REPLAY_TEST_START_TICK + 200, RfidAppEventDown, NULL);
+    trace_put(trace, REPLAY_TEST_START_TICK + 300, RfidAppEventBack, NULL);
+    trace_put(trace, REPLAY_TEST_START_TICK + 400, RfidAppEventBack, NULL);
+    fclose(trace);
+    RfidAppReplayReport report;
+    RfidAppState state;
+    CHECK(replay(true, &report, &state), "replay didn't start");
+    CHECK(report.events == trace_events - 1, "%u events", report.events);
+    CHECK(report.ms >= report.recorded_ms && report.recorded_ms == 300,
+          "%u ms for %u recorded", report.ms, report.recorded_ms);
+}
+
+int main(void) {
+    snprintf(sd_root, sizeof(sd_root), "/tmp/replay_test.XXXXXX");
+    if(!mkdtemp(sd_root)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    host_sdk_init(sd_root);
+    host_sdk_log_level('E');
+
+    test_full_speed();
+    test_deterministic();
+    test_real_speed();
+
+    storage_simply_remove_recursive(furi_record_open(RECORD_STORAGE), "/ext");
+    printf("replay_test: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,190 @@
+#include "helpers/hash_backend.h"
+#include "lib/sphlib/sph_ripemd.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// random messages per step length and alignment
+#define RIPEMD_TEST_RUNS 50000
+
+static int failures;
+
+#define CHECK(cond, ...)                                              \
+    do {                                                              \
+        if(!(cond)) {                                                 \
+            failures++;                                               \
+            printf("%s:%d: %s: ", __FILE__, __LINE__, #cond);         \
+            printf(__VA_ARGS__);                                      \
+            printf("\n");                                             \
+        }                                                             \
+    } while(0)
+
+static const sph_u32 ripemd_iv[4] = {
+    SPH_C32(0x67452301), SPH_C32(0xEFCDAB89), SPH_C32(0x98BADCFE), SPH_C32(0x10325476),
+};
+
+// xorshift32, fixed seed so a failure repeats
+static uint32_t rng_state = 0x2545F491;
+
+static void rng_fill(uint8_t* out, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        rng_state ^= rng_state << 13;
+        rng_state ^= rng_state >> 17;
+        rng_state ^= rng_state << 5;
+        out[i] = rng_state;
+    }
+}
+
+// init, update with the prefix and the message, close
+static void reference(const uint8_t* prefix, size_t prefix_len, const uint8_t* in, size_t len, uint8_t* out) {
+    sph_ripemd128_context ctx;
+    sph_ripemd128_init(&ctx);
+    sph_ripemd128(&ctx, prefix, prefix_len);
+    sph_ripemd128(&ctx, in, len);
+    sph_ripemd128_close(&ctx, out);
+}
+
+static void step(size_t len, const uint8_t* in, const sph_u32 val[4], sph_u32 prefix, uint8_t* out) {
+    if(len == 10) {
+        sph_ripemd128_step10(in, val, prefix, out);
+    } else {
+        sph_ripemd128_step4(in, val, prefix, out);
+    }
+}
+
+// the kernels from the IV against the generic code, at every alignment of the input
+static void test_step(void) {
+    static const size_t lens[] = {10, 4};
+    // word aligned, the offsets move the input off it
+    _Alignas(4) uint8_t buff[10 + 3];
+    uint8_t want[16], got[16];
+    for(size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        size_t len = lens[l];
+        for(size_t offset = 0; offset < 4; offset++) {
+            for(int run = 0; run < RIPEMD_TEST_RUNS; run++) {
+                uint8_t* in = buff + offset;
+                rng_fill(in, len);
+                reference(NULL, 0, in, len, want);
+                step(len, in, ripemd_iv, 0, got);
+                if(memcmp(want, got, sizeof(want)) != 0) {
+                    CHECK(false, "%zu bytes at offset %zu differ, run %d", len, offset, run);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// from the midstate after a 64 byte block, as the keyed backend runs them
+static void test_step_midstate(void) {
+    static const size_t lens[] = {10, 4};
+    uint8_t block[64], in[10 + 3];
+    uint8_t want[16], got[16];
+    sph_u32 msg[16], val[4];
+    for(size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        size_t len = lens[l];
+        for(int run = 0; run < RIPEMD_TEST_RUNS / 10; run++) {
+            rng_fill(block, sizeof(block));
+            for(uint8_t i = 0; i < 16; i++) {
+                msg[i] = sph_dec32le(block + 4 * i);
+            }
+            memcpy(val, ripemd_iv, sizeof(val));
+            sph_ripemd128_comp(msg, val);
+            uint8_t* data = in + run % 4;
+            rng_fill(data, len);
+            reference(block, sizeof(block), data, len, want);
+            step(len, data, val, sizeof(block), got);
+            if(memcmp(want, got, sizeof(want)) != 0) {
+                CHECK(false, "%zu bytes after a block differ, run %d", len, run);
+                break;
+            }
+        }
+    }
+}
+
+// the batch steps against the single ones, for counts around the lane width
+static void test_step_x(void) {
+    static const size_t lens[] = {10, 4};
+    // two blocks of SPH_RIPEMD128_LANES and a partial one at any width
+    uint8_t buffs[4 * 8 + 5][16], want[16];
+    sph_u32 msg[16], val[4];
+    for(size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        size_t len = lens[l];
+        for(int keyed = 0; keyed < 2; keyed++) {
+            sph_u32 prefix = keyed ? 64 : 0;
+            memcpy(val, ripemd_iv, sizeof(val));
+            if(keyed) {
+                uint8_t block[64];
+                rng_fill(block, sizeof(block));
+                for(uint8_t i = 0; i < 16; i++) {
+                    msg[i] = sph_dec32le(block + 4 * i);
+                }
+                sph_ripemd128_comp(msg, val);
+            }
+            for(size_t num = 0; num <= sizeof(buffs) / sizeof(buffs[0]); num++) {
+                uint8_t in[sizeof(buffs) / sizeof(buffs[0])][16];
+                rng_fill(&in[0][0], sizeof(in));
+                memcpy(buffs, in, sizeof(buffs));
+                if(len == 10) {
+                    sph_ripemd128_step10_x(buffs, val, prefix, num);
+                } else {
+                    sph_ripemd128_step4_x(buffs, val, prefix, num);
+                }
+                for(size_t n = 0; n < sizeof(buffs) / sizeof(buffs[0]); n++) {
+                    if(n < num) {
+                        step(len, in[n], val, prefix, want);
+                    } else {
+                        memcpy(want, in[n], sizeof(want));
+                    }
+                    CHECK(
+                        memcmp(want, buffs[n], sizeof(want)) == 0,
+                        "%zu bytes, %s, buffer %zu of %zu",
+                        len,
+                        keyed ? "keyed" : "plain",
+                        n,
+                        num);
+                }
+            }
+        }
+    }
+}
+
+// the RIPEMD-128 backends hash in place, the way chains step
+static void test_backend(void) {
+    static const size_t lens[] = {10, 4, 16, 20};
+    uint8_t key[HASH_BACKEND_KEY_MAX];
+    uint8_t in[20], buff[20], want[16];
+    rng_fill(key, sizeof(key));
+    hash_backend_set_key(key, sizeof(key));
+    const HashBackend* plain = hash_backend_get(HashBackendRipemd128);
+    const HashBackend* keyed = hash_backend_get(HashBackendRipemd128Keyed);
+    CHECK(plain && keyed, "RIPEMD-128 backends missing");
+    if(!plain || !keyed) {
+        return;
+    }
+    for(size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        size_t len = lens[l];
+        for(int run = 0; run < 1000; run++) {
+            rng_fill(in, sizeof(in));
+            reference(NULL, 0, in, len, want);
+            memcpy(buff, in, sizeof(buff));
+            plain->digest(buff, len, buff);
+            CHECK(memcmp(want, buff, sizeof(want)) == 0, "plain, %zu bytes, run %d", len, run);
+
+            reference(key, sizeof(key), in, len, want);
+            memcpy(buff, in, sizeof(buff));
+            keyed->digest(buff, len, buff);
+            CHECK(memcmp(want, buff, sizeof(want)) == 0, "keyed, %zu bytes, run %d", len, run);
+        }
+    }
+}
+
+int main(void) {
+    test_step();
+    test_step_midstate();
+    test_step_x();
+    test_backend();
+
+    printf("ripemd_test: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Queries the HashTag tap log (audit.bin) on a computer, using its index (audit.idx).
+
+The layouts are described in helpers/audit_log.h:
+  audit.bin: b"HTAL", u8 version, u8 record size, 2 reserved, then records of
+             u32 time, u8 card_id, u16 chain_idx, u8 result
+  audit.idx: b"HTAI", u8 version, u8 entry size, u16 block records, then per block of the log
+             u32 earliest time, u32 latest time, 32 byte bitmap of the card ids in the block
+All little-endian. Only the blocks whose entry can match are read; blocks the index doesn't
+cover yet are always read.
+
+  audit_query.py rfid_hashes/audit.bin --card 42 --days 7
+  audit_query.py audit.bin --since 2026-10-01 --until 2026-10-08T12:00
+"""
+
+import argparse
+import datetime
+import os
+import struct
+import sys
+import time
+
+LOG_MAGIC = b"HTAL"
+INDEX_MAGIC = b"HTAI"
+LOG_VERSION = 1
+INDEX_VERSION = 1
+HEADER_SIZE = 8
+RECORD = struct.Struct("<IBHB")  # time, card_id, chain_idx, result
+ENTRY = struct.Struct("<II32s")  # earliest time, latest time, card bitmap
+RESULTS = ["accepted", "unknown", "revoked", "stale", "write failed", "storage error"]
+
+
+def read_header(f, magic, version, size):
+    header = f.read(HEADER_SIZE)
+    if len(header) < HEADER_SIZE or header[:4] != magic:
+        raise ValueError(f"not a {magic.decode()} file")
+    if header[4] != version or header[5] != size:
+        raise ValueError(f"unsupported version {header[4]} or entry size {header[5]}")
+    return header
+
+
+def read_index(path):
+    """Returns the block size and the index entries, or (None, []) if there is no usable index."""
+    if not os.path.exists(path):
+        return None, []
+    with open(path, "rb") as f:
+        try:
+            header = read_header(f, INDEX_MAGIC, INDEX_VERSION, ENTRY.size)
+        except ValueError as e:
+            print(f"index ignored: {e}", file=sys.stderr)
+            return None, []
+        (block_records,) = struct.unpack_from("<H", header, 6)
+        data = f.read()
+    count = len(data) // ENTRY.size
+    return block_records, [ENTRY.unpack_from(data, i * ENTRY.size) for i in range(count)]
+
+
+def query(log_path, index_path, card, since, until):
+    """Yields the matching records oldest first, then returns (blocks read, blocks total)."""
+    block_records, entries = read_index(index_path)
+    with open(log_path, "rb") as f:
+        read_header(f, LOG_MAGIC, LOG_VERSION, RECORD.size)
+        records = (os.fstat(f.fileno()).st_size - HEADER_SIZE) // RECORD.size
+        if block_records is None:
+            block_records, entries = 256, []
+        blocks = (records + block_records - 1) // block_records
+        blocks_read = 0
+        for block in range(blocks):
+            if block < len(entries):
+                earliest, latest, cards = entries[block]
+                if latest < since or earliest > until:
+                    continue
+                if card is not None and not cards[card // 8] & (1 << (card % 8)):
+                    continue
+            first = block * block_records
+            count = min(block_records, records - first)
+            f.seek(HEADER_SIZE + first * RECORD.size)
+            data = f.read(count * RECORD.size)
+            blocks_read += 1
+            for pos in range(0, len(data) - RECORD.size + 1, RECORD.size):
+                record = RECORD.unpack_from(data, pos)
+                if (card is None or record[1] == card) and since <= record[0] <= until:
+                    yield record
+    return blocks_read, blocks
+
+
+def parse_time(value):
+    # the Flipper's RTC runs on local time and its timestamps count it as UTC
+    moment = datetime.datetime.fromisoformat(value)
+    return int(moment.replace(tzinfo=datetime.timezone.utc).timestamp())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", help="audit.bin copied from /ext/rfid_hashes")
+    parser.add_argument("--index", help="audit.idx, defaults to the one next to the log")
+    parser.add_argument("--card", type=int, help="only taps of this card id")
+    parser.add_argument("--days", type=float, help="only taps of the last DAYS days")
+    parser.add_argument("--since", type=parse_time, default=0, help="ISO date/time, Flipper clock")
+    parser.add_argument("--until", type=parse_time, default=2**32 - 1, help="ISO date/time, Flipper clock")
+    args = parser.parse_args()
+    index = args.index or os.path.join(os.path.dirname(args.log), "audit.idx")
+    since = args.since
+    if args.days is not None:
+        now = parse_time(datetime.datetime.now().isoformat(timespec="seconds"))
+        since = max(since, now - int(args.days * 24 * 60 * 60))
+
+    start = time.perf_counter()
+    matches = 0
+    try:
+        results = query(args.log, index, args.card, since, args.until)
+        while True:
+            try:
+                stamp, card_id, chain_idx, result = next(results)
+            except StopIteration as done:
+                blocks_read, blocks = done.value
+                break
+            when = datetime.datetime.fromtimestamp(stamp, datetime.timezone.utc).strftime("%Y-%m-%d %H:%M:%S")
+            name = RESULTS[result] if result < len(RESULTS) else f"result {result}"
+            print(f"{when}  card {card_id:3d}  position {chain_idx:5d}  {name}")
+            matches += 1
+    except (OSError, ValueError) as e:
+        sys.exit(f"error: {e}")
+    elapsed = (time.perf_counter() - start) * 1000
+    print(f"{matches} taps, read {blocks_read} of {blocks} blocks in {elapsed:.1f} ms", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""Reports code size, static RAM and step cost of every chain hash backend.
+
+The sources are compiled to objects with the given compiler and the symbol sizes from nm are
+summed per backend: code (text), constants (rodata) and static RAM (data and bss). The
+RIPEMD-128 core in lib/sphlib is counted for both RIPEMD-128 backends; its multi-message
+functions are listed apart, on the device (one lane) they are short loops over the single
+step kernels. With the host
+compiler tools/hash_bench is built and run too, for the time per step at the length chains
+hash (10 bytes, 4 for the keyed backend) and the hashing state on the stack per call.
+
+With --qemu tools/hash_bench is built static with the given (ARM Linux) compiler and run under
+qemu-arm with the libinsn plugin, once per backend at two step counts. The difference of the
+instruction counts over the difference of the steps is the instructions per step, each step
+being one compression. The chain and startup code cancel out. Linux user mode qemu only runs
+A-profile cores, so build Thumb-2 for ARMv7-A: the integer instructions are the ones the
+Cortex-M4 runs, its cycles per instruction are not modelled.
+
+  hash_bench.py
+  hash_bench.py --cc arm-none-eabi-gcc --cflags="-mcpu=cortex-m4 -mthumb -Os"
+  hash_bench.py --cc arm-linux-gnueabihf-gcc --cflags="-march=armv7-a -mthumb -Os" \
+      --qemu --qemu-plugin ~/qemu/build/tests/plugin/libinsn.so
+"""
+
+import argparse
+import os
+import re
+import shlex
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SOURCES = ["helpers/hash_backend.c", "lib/sphlib/ripemd.c"]
+BENCH_SOURCES = ["tools/hash_bench.c", "helpers/hash_chain.c", *SOURCES]
+# step counts of the two qemu runs
+QEMU_STEPS = (1000, 11000)
+# symbol name patterns of each backend, the first match wins
+BACKENDS = [
+    ("RIPEMD-128 x", r"\w*ripemd128\w*(_x|_lanes)"),
+    ("RIPEMD-128K", r"hash_backend_(ripemd128_keyed|ripemd128_iv|key_\w+|set_key|has_key)"),
+    ("RIPEMD-128", r"hash_backend_ripemd128|\w*ripemd128\w*|IV"),
+    ("SipHash-2-4", r"hash_backend_(siphash\w*|rotl64|le64)"),
+    ("BLAKE2s-128", r"hash_backend_(blake2s\w*|rotr32)"),
+    ("SHA-256/128", r"hash_backend_sha256\w*"),
+]
+KINDS = {"t": "code", "r": "rodata", "d": "ram", "b": "ram"}
+
+
+def compile_objects(cc, cflags, out_dir):
+    objects = []
+    for source in SOURCES:
+        obj = os.path.join(out_dir, os.path.basename(source) + ".o")
+        cmd = [cc, *cflags, "-I", ROOT, "-I", os.path.join(ROOT, "lib/sphlib"), "-c", "-o", obj,
+               os.path.join(ROOT, source)]
+        subprocess.run(cmd, check=True)
+        objects.append(obj)
+    return objects
+
+
+def symbol_sizes(nm, objects):
+    """Yields (name, kind, size) of every sized symbol, kind as in KINDS."""
+    out = subprocess.run([nm, "-S", *objects], check=True, capture_output=True, text=True).stdout
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) != 4:
+            continue
+        _, size, kind, name = fields
+        kind = KINDS.get(kind.lower())
+        if kind:
+            yield name.split(".")[0], kind, int(size, 16)
+
+
+def qemu_insns(args, bench, backend, steps, log):
+    cmd = [args.qemu, "-plugin", args.qemu_plugin, "-d", "plugin", "-D", log, bench, str(steps), backend]
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+    with open(log) as f:
+        counts = re.findall(r"insns: (\d+)", f.read())
+    if not counts:
+        sys.exit(f"error: no instruction count from {args.qemu_plugin}")
+    # newer plugins print one line per vcpu and the total last
+    return int(counts[-1])
+
+
+def qemu_report(args, cflags):
+    print(f"{args.qemu} {os.path.basename(args.qemu_plugin)}")
+    print(f"{'backend':<12} {'insns/step':>10}")
+    with tempfile.TemporaryDirectory() as tmp:
+        bench = os.path.join(tmp, "hash_bench")
+        log = os.path.join(tmp, "insn.log")
+        try:
+            subprocess.run([args.cc, *cflags, "-static", "-I", ROOT, "-I", os.path.join(ROOT, "lib/sphlib"),
+                            "-o", bench, *[os.path.join(ROOT, s) for s in BENCH_SOURCES]], check=True)
+            for backend, _ in BACKENDS:
+                if backend.endswith(" x"):
+                    continue
+                low, high = (qemu_insns(args, bench, backend, n, log) for n in QEMU_STEPS)
+                print(f"{backend:<12} {(high - low) / (QEMU_STEPS[1] - QEMU_STEPS[0]):10.1f}")
+        except (OSError, subprocess.CalledProcessError) as e:
+            sys.exit(f"error: {e}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--cc", default=os.environ.get("CC", "cc"), help="compiler, e.g. arm-none-eabi-gcc")
+    parser.add_argument("--cflags", default="-O2", help="flags for the size build")
+    parser.add_argument("--steps", type=int, default=200000, help="steps timed per backend")
+    parser.add_argument("--qemu", nargs="?", const="qemu-arm", help="count instructions per step under qemu-arm")
+    parser.add_argument("--qemu-plugin", help="path of qemu's libinsn.so, needed with --qemu")
+    args = parser.parse_args()
+    if args.qemu and not args.qemu_plugin:
+        parser.error("--qemu needs --qemu-plugin")
+
+    # a cross compiler's nm carries its prefix
+    prefix = re.sub(r"(gcc|cc|clang)$", "", os.path.basename(args.cc))
+    nm = prefix + "nm" if prefix else "nm"
+    sizes = {name: {"code": 0, "rodata": 0, "ram": 0} for name, _ in BACKENDS}
+    other = {"code": 0, "rodata": 0, "ram": 0}
+    with tempfile.TemporaryDirectory() as tmp:
+        try:
+            objects = compile_objects(args.cc, shlex.split(args.cflags), tmp)
+            symbols = list(symbol_sizes(nm, objects))
+        except (OSError, subprocess.CalledProcessError) as e:
+            sys.exit(f"error: {e}")
+    for name, kind, size in symbols:
+        for backend, pattern in BACKENDS:
+            if re.fullmatch(pattern, name):
+                sizes[backend][kind] += size
+                break
+        else:
+            other[kind] += size
+
+    print(f"{args.cc} {args.cflags}")
+    print(f"{'backend':<12} {'code':>6} {'rodata':>7} {'ram':>5}")
+    for backend, _ in BACKENDS:
+        s = sizes[backend]
+        print(f"{backend:<12} {s['code']:6d} {s['rodata']:7d} {s['ram']:5d}")
+    print(f"{'other':<12} {other['code']:6d} {other['rodata']:7d} {other['ram']:5d}")
+    print("RIPEMD-128K also runs the RIPEMD-128 core, other is the backend table and unused sphlib code\n")
+
+    if args.qemu:
+        qemu_report(args, shlex.split(args.cflags))
+        return
+    if args.cc not in ("cc", "gcc", "clang"):
+        return
+    bench = os.path.join(ROOT, "tools", "hash_bench")
+    try:
+        subprocess.run(["make", "-s", "-C", os.path.join(ROOT, "tools"), "hash_bench"], check=True)
+        subprocess.run([bench, str(args.steps)], check=True)
+    except (OSError, subprocess.CalledProcessError) as e:
+        sys.exit(f"error: {e}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Reads and writes HashTag card archives (cards.htar) on a computer.
+
+The archive layout is described in helpers/card_archive.h:
+  b"HTAR", u16 version, then per card u16 length + record, u16 0, u32 CRC-32 of all bytes before it.
+Records use the layout from helpers/hash_chain.h.
+
+  hashtag_archive.py list cards.htar
+  hashtag_archive.py pack rfid_hashes/ cards.htar   # from a copy of /ext/rfid_hashes
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = b"HTAR"
+ARCHIVE_VERSION = 1
+RECORD_VERSION = 2
+RECORD_HEADER = struct.Struct("<BBBBHH")  # version, flags, card_id, seed_len, chain_len, curr_idx
+FLAG_SEED_ONLY = 1 << 0
+FLAG_REVOKED = 1 << 1
+FLAG_SHORT_STEP = 1 << 2
+FLAG_VERIFIER = 1 << 3
+V1_SIZE = 404
+
+
+def read_archive(path):
+    """Returns the records of an archive, raises ValueError if it is damaged."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < 12 or data[:4] != MAGIC:
+        raise ValueError("not a HashTag archive")
+    (version,) = struct.unpack_from("<H", data, 4)
+    if version != ARCHIVE_VERSION:
+        raise ValueError(f"unsupported archive version {version}")
+    records = []
+    pos = 6
+    while True:
+        if pos + 2 > len(data):
+            raise ValueError("archive is cut short")
+        (length,) = struct.unpack_from("<H", data, pos)
+        pos += 2
+        if length == 0:
+            break
+        if pos + length > len(data):
+            raise ValueError("archive is cut short")
+        records.append(data[pos : pos + length])
+        pos += length
+    if pos + 4 != len(data):
+        raise ValueError("trailing data after the end marker")
+    (crc,) = struct.unpack_from("<I", data, pos)
+    if crc != zlib.crc32(data[:pos]):
+        raise ValueError("CRC mismatch")
+    return records
+
+
+def write_archive(path, records):
+    out = bytearray(MAGIC + struct.pack("<H", ARCHIVE_VERSION))
+    for record in records:
+        out += struct.pack("<H", len(record)) + record
+    out += struct.pack("<H", 0)
+    out += struct.pack("<I", zlib.crc32(out))
+    with open(path, "wb") as f:
+        f.write(out)
+
+
+def parse_flipper_file(path):
+    """Returns the keys of a FlipperFormat text file as strings."""
+    keys = {}
+    with open(path, encoding="ascii", errors="replace") as f:
+        for line in f:
+            key, sep, value = line.partition(":")
+            if sep:
+                keys[key.strip()] = value.strip()
+    return keys
+
+
+def hex_bytes(value):
+    return bytes(int(b, 16) for b in value.split())
+
+
+def slot_crc(seq, record):
+    return zlib.crc32(struct.pack("<I", seq) + record)
+
+
+def load_slot(path):
+    """Returns (seq, record) of a valid slot file, or None."""
+    keys = parse_flipper_file(path)
+    if "Seq" in keys:
+        seq = int(keys["Seq"])
+        record = hex_bytes(keys.get("Record", ""))
+        if "Crc" not in keys or int(keys["Crc"]) != slot_crc(seq, record):
+            return None
+        return seq, record
+    # files from before the slots
+    if "Record" in keys:
+        return 0, hex_bytes(keys["Record"])
+    if "HashData" in keys:
+        raw = hex_bytes(keys["HashData"])
+        if len(raw) != V1_SIZE:
+            return None
+        card_id, curr_idx = raw[0], raw[1]
+        values = raw[4 + 4 * curr_idx :]
+        return 0, RECORD_HEADER.pack(RECORD_VERSION, 0, card_id, 0, 100, curr_idx) + values
+    return None
+
+
+def describe(record):
+    if len(record) < RECORD_HEADER.size or record[0] != RECORD_VERSION:
+        return "unknown record"
+    _, flags, card_id, seed_len, chain_len, curr_idx = RECORD_HEADER.unpack_from(record)
+    if flags & FLAG_VERIFIER:
+        kind = f"verifier, anchor {struct.unpack_from('<I', record, RECORD_HEADER.size)[0]:08X}"
+    elif flags & FLAG_SEED_ONLY:
+        kind = f"seed {seed_len} bytes"
+    else:
+        kind = "values"
+    revoked = ", revoked" if flags & FLAG_REVOKED else ""
+    return f"card {card_id:3d}: position {curr_idx}/{chain_len}, {kind}{revoked}"
+
+
+def cmd_list(args):
+    records = read_archive(args.archive)
+    for record in records:
+        print(describe(record))
+    print(f"{len(records)} cards")
+
+
+def cmd_pack(args):
+    records = []
+    for name in sorted(os.listdir(args.directory)):
+        match = re.fullmatch(r"(\d+)\.hashrf", name)
+        if not match:
+            continue
+        card_id = int(match.group(1))
+        slots = [
+            load_slot(os.path.join(args.directory, f))
+            for f in (f"{card_id}.hashrf", f"{card_id}.b.hashrf")
+            if os.path.exists(os.path.join(args.directory, f))
+        ]
+        slots = [slot for slot in slots if slot]
+        if not slots:
+            print(f"card {card_id}: no valid slot, skipped", file=sys.stderr)
+            continue
+        record = max(slots)[1]
+        if len(record) >= 2 and record[1] & FLAG_REVOKED:
+            continue
+        records.append(record)
+    write_archive(args.archive, records)
+    print(f"packed {len(records)} cards into {args.archive}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+    list_parser = commands.add_parser("list", help="show the cards in an archive")
+    list_parser.add_argument("archive")
+    list_parser.set_defaults(func=cmd_list)
+    pack_parser = commands.add_parser("pack", help="build an archive from a copied card folder")
+    pack_parser.add_argument("directory")
+    pack_parser.add_argument("archive")
+    pack_parser.set_defaults(func=cmd_pack)
+    args = parser.parse_args()
+    try:
+        args.func(args)
+    except (OSError, ValueError) as e:
+        sys.exit(f"error: {e}")
+
+
+if __name__ == "__main__":
+    main()
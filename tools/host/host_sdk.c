@@ -0,0 +1,1257 @@
+// the SDK functions declared in host_sdk.h, on POSIX
+#define _GNU_SOURCE // nftw
+
+#include "host_sdk.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// longest host path, /ext mapped into the SD directory
+#define HOST_PATH_LEN 512
+// longest format string once the l modifiers are taken out
+#define HOST_FORMAT_LEN 256
+// longest "Key: value" line of a flipper format file, a 256 byte hex value included
+#define HOST_LINE_LEN 1024
+// protocol data kept per protocol, the app doesn't keep more than 8 bytes of a tag
+#define HOST_PROTOCOL_DATA_MAX 8
+
+static char host_sd_root[HOST_PATH_LEN];
+static struct timespec host_start;
+static char host_level_max = 'I';
+static const char host_levels[] = "EWIDT";
+
+/* formatting and logging */
+
+// copies format without the single l modifiers, see host_snprintf
+static const char* host_format(const char* format, char* out) {
+    size_t len = 0;
+    const char* in = format;
+    while(*in && len < HOST_FORMAT_LEN - 2) {
+        char c = *in++;
+        out[len++] = c;
+        if(c != '%') continue;
+        // flags, width and precision
+        while(*in && strchr("-+ #0123456789.*", *in) && len < HOST_FORMAT_LEN - 2) {
+            out[len++] = *in++;
+        }
+        // ll stays, it is 64 bits on both
+        if(in[0] == 'l' && in[1] != 'l') in++;
+        if(*in) out[len++] = *in++;
+    }
+    out[len] = '\0';
+    return out;
+}
+
+static int host_vsnprintf(char* out, size_t size, const char* format, va_list args) {
+    char host[HOST_FORMAT_LEN];
+    return vsnprintf(out, size, host_format(format, host), args);
+}
+
+int host_snprintf(char* out, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = host_vsnprintf(out, size, format, args);
+    va_end(args);
+    return len;
+}
+
+void host_sdk_log_level(char level) {
+    host_level_max = level;
+}
+
+void host_log(char level, const char* tag, const char* format, ...) {
+    if(strchr(host_levels, level) > strchr(host_levels, host_level_max)) return;
+    char line[HOST_LINE_LEN];
+    int len = snprintf(line, sizeof(line), "%lu [%c][%s] ", furi_get_tick(), level, tag);
+    va_list args;
+    va_start(args, format);
+    host_vsnprintf(line + len, sizeof(line) - len, format, args);
+    va_end(args);
+    fprintf(stderr, "%s\n", line);
+}
+
+void host_crash(const char* what, const char* file, int line) {
+    fprintf(stderr, "furi_check failed: %s at %s:%d\n", what, file, line);
+    abort();
+}
+
+/* furi */
+
+struct FuriString {
+    char* text;
+    size_t size;
+};
+
+FuriString* furi_string_alloc(void) {
+    FuriString* string = malloc(sizeof(FuriString));
+    string->text = strdup("");
+    string->size = 0;
+    return string;
+}
+
+void furi_string_free(FuriString* string) {
+    free(string->text);
+    free(string);
+}
+
+void furi_string_set(FuriString* string, const char* text) {
+    char* copy = strdup(text);
+    free(string->text);
+    string->text = copy;
+    string->size = strlen(copy);
+}
+
+void furi_string_reset(FuriString* string) {
+    furi_string_set(string, "");
+}
+
+int furi_string_printf(FuriString* string, const char* format, ...) {
+    char text[HOST_LINE_LEN];
+    va_list args;
+    va_start(args, format);
+    int len = host_vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    furi_string_set(string, text);
+    return len;
+}
+
+const char* furi_string_get_cstr(const FuriString* string) {
+    return string->text;
+}
+
+size_t furi_string_size(const FuriString* string) {
+    return string->size;
+}
+
+// absolute CLOCK_MONOTONIC time timeout ms from now
+static struct timespec host_deadline(uint32_t timeout) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+    if(deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+static void host_cond_init(pthread_cond_t* cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// waits for a signal on cond, returns false once the deadline passed
+static bool host_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, uint32_t timeout, const struct timespec* deadline) {
+    if(timeout == FuriWaitForever) {
+        pthread_cond_wait(cond, mutex);
+        return true;
+    }
+    return timeout && pthread_cond_timedwait(cond, mutex, deadline) != ETIMEDOUT;
+}
+
+struct FuriMessageQueue {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    uint8_t* items;
+    uint32_t item_size;
+    uint32_t capacity;
+    uint32_t head; // oldest message
+    uint32_t count;
+};
+
+FuriMessageQueue* furi_message_queue_alloc(uint32_t msg_count, uint32_t msg_size) {
+    FuriMessageQueue* queue = malloc(sizeof(FuriMessageQueue));
+    pthread_mutex_init(&queue->mutex, NULL);
+    host_cond_init(&queue->changed);
+    queue->items = malloc((size_t)msg_count * msg_size);
+    queue->item_size = msg_size;
+    queue->capacity = msg_count;
+    queue->head = 0;
+    queue->count = 0;
+    return queue;
+}
+
+void furi_message_queue_free(FuriMessageQueue* queue) {
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->items);
+    free(queue);
+}
+
+FuriStatus furi_message_queue_put(FuriMessageQueue* queue, const void* msg, uint32_t timeout) {
+    struct timespec deadline = host_deadline(timeout);
+    FuriStatus status = FuriStatusOk;
+    pthread_mutex_lock(&queue->mutex);
+    while(queue->count == queue->capacity) {
+        if(!host_cond_wait(&queue->changed, &queue->mutex, timeout, &deadline)) {
+            status = timeout ? FuriStatusErrorTimeout : FuriStatusErrorResource;
+            break;
+        }
+    }
+    if(status == FuriStatusOk) {
+        uint32_t tail = (queue->head + queue->count++) % queue->capacity;
+        memcpy(&queue->items[tail * queue->item_size], msg, queue->item_size);
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return status;
+}
+
+FuriStatus furi_message_queue_get(FuriMessageQueue* queue, void* msg, uint32_t timeout) {
+    struct timespec deadline = host_deadline(timeout);
+    FuriStatus status = FuriStatusOk;
+    pthread_mutex_lock(&queue->mutex);
+    while(queue->count == 0) {
+        if(!host_cond_wait(&queue->changed, &queue->mutex, timeout, &deadline)) {
+            status = timeout ? FuriStatusErrorTimeout : FuriStatusErrorResource;
+            break;
+        }
+    }
+    if(status == FuriStatusOk) {
+        memcpy(msg, &queue->items[queue->head * queue->item_size], queue->item_size);
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return status;
+}
+
+uint32_t furi_message_queue_get_count(FuriMessageQueue* queue) {
+    pthread_mutex_lock(&queue->mutex);
+    uint32_t count = queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+    return count;
+}
+
+// nothing behind the records is used directly, each is just a distinct pointer
+struct Storage {
+    uint8_t unused;
+};
+struct Gui {
+    uint8_t unused;
+};
+struct NotificationApp {
+    uint8_t unused;
+};
+static Storage host_storage;
+static Gui host_gui;
+static NotificationApp host_notification;
+
+void* furi_record_open(const char* name) {
+    if(strcmp(name, RECORD_STORAGE) == 0) return &host_storage;
+    if(strcmp(name, RECORD_GUI) == 0) return &host_gui;
+    if(strcmp(name, RECORD_NOTIFICATION) == 0) return &host_notification;
+    host_crash(name, __FILE__, __LINE__);
+}
+
+void furi_record_close(const char* name) {
+    UNUSED(name);
+}
+
+static uint64_t host_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - host_start.tv_sec) * 1000000000u + now.tv_nsec - host_start.tv_nsec;
+}
+
+void furi_delay_ms(uint32_t ms) {
+    struct timespec delay = {.tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000};
+    nanosleep(&delay, NULL);
+}
+
+uint32_t furi_get_tick(void) {
+    return host_ns() / 1000000;
+}
+
+uint32_t furi_ms_to_ticks(uint32_t ms) {
+    return ms;
+}
+
+uint32_t furi_kernel_get_tick_frequency(void) {
+    return 1000;
+}
+
+struct FuriThread {
+    pthread_t pthread;
+    FuriThreadCallback callback;
+    void* context;
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    uint32_t flags;
+};
+
+static FuriThread host_main_thread;
+static __thread FuriThread* host_thread_current;
+
+static void host_thread_init(FuriThread* thread, FuriThreadCallback callback, void* context) {
+    thread->callback = callback;
+    thread->context = context;
+    pthread_mutex_init(&thread->mutex, NULL);
+    host_cond_init(&thread->changed);
+    thread->flags = 0;
+}
+
+FuriThread* furi_thread_alloc_ex(
+    const char* name,
+    uint32_t stack_size,
+    FuriThreadCallback callback,
+    void* context) {
+    UNUSED(name);
+    UNUSED(stack_size);
+    FuriThread* thread = malloc(sizeof(FuriThread));
+    host_thread_init(thread, callback, context);
+    return thread;
+}
+
+void furi_thread_free(FuriThread* thread) {
+    pthread_cond_destroy(&thread->changed);
+    pthread_mutex_destroy(&thread->mutex);
+    free(thread);
+}
+
+// all threads run at the host's default priority
+void furi_thread_set_priority(FuriThread* thread, FuriThreadPriority priority) {
+    UNUSED(thread);
+    UNUSED(priority);
+}
+
+static void* host_thread_run(void* context) {
+    host_thread_current = context;
+    host_thread_current->callback(host_thread_current->context);
+    return NULL;
+}
+
+void furi_thread_start(FuriThread* thread) {
+    furi_check(pthread_create(&thread->pthread, NULL, host_thread_run, thread) == 0);
+}
+
+bool furi_thread_join(FuriThread* thread) {
+    return pthread_join(thread->pthread, NULL) == 0;
+}
+
+FuriThreadId furi_thread_get_id(FuriThread* thread) {
+    return thread;
+}
+
+FuriThreadId furi_thread_get_current_id(void) {
+    return host_thread_current ? host_thread_current : &host_main_thread;
+}
+
+uint32_t furi_thread_flags_set(FuriThreadId thread_id, uint32_t flags) {
+    FuriThread* thread = thread_id;
+    pthread_mutex_lock(&thread->mutex);
+    thread->flags |= flags;
+    uint32_t set = thread->flags;
+    pthread_cond_broadcast(&thread->changed);
+    pthread_mutex_unlock(&thread->mutex);
+    return set;
+}
+
+uint32_t furi_thread_flags_get(void) {
+    FuriThread* thread = furi_thread_get_current_id();
+    pthread_mutex_lock(&thread->mutex);
+    uint32_t flags = thread->flags;
+    pthread_mutex_unlock(&thread->mutex);
+    return flags;
+}
+
+uint32_t furi_thread_flags_wait(uint32_t flags, uint32_t options, uint32_t timeout) {
+    FuriThread* thread = furi_thread_get_current_id();
+    struct timespec deadline = host_deadline(timeout);
+    uint32_t result = FuriFlagErrorTimeout;
+    pthread_mutex_lock(&thread->mutex);
+    while(true) {
+        uint32_t set = thread->flags & flags;
+        if((options & FuriFlagWaitAll) ? set == flags : set != 0) {
+            result = thread->flags;
+            if(!(options & FuriFlagNoClear)) thread->flags &= ~flags;
+            break;
+        }
+        if(!host_cond_wait(&thread->changed, &thread->mutex, timeout, &deadline)) break;
+    }
+    pthread_mutex_unlock(&thread->mutex);
+    return result;
+}
+
+struct FuriMutex {
+    pthread_mutex_t mutex;
+};
+
+FuriMutex* furi_mutex_alloc(FuriMutexType type) {
+    FuriMutex* mutex = malloc(sizeof(FuriMutex));
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    if(type == FuriMutexTypeRecursive) {
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    }
+    pthread_mutex_init(&mutex->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return mutex;
+}
+
+void furi_mutex_free(FuriMutex* mutex) {
+    pthread_mutex_destroy(&mutex->mutex);
+    free(mutex);
+}
+
+FuriStatus furi_mutex_acquire(FuriMutex* mutex, uint32_t timeout) {
+    if(timeout == FuriWaitForever) {
+        pthread_mutex_lock(&mutex->mutex);
+        return FuriStatusOk;
+    }
+    // timed locks only take the realtime clock
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+    if(deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    int error = timeout ? pthread_mutex_timedlock(&mutex->mutex, &deadline) :
+                          pthread_mutex_trylock(&mutex->mutex);
+    return error ? FuriStatusErrorTimeout : FuriStatusOk;
+}
+
+FuriStatus furi_mutex_release(FuriMutex* mutex) {
+    return pthread_mutex_unlock(&mutex->mutex) ? FuriStatusError : FuriStatusOk;
+}
+
+size_t memmgr_get_free_heap(void) {
+    return 64 * 1024;
+}
+
+size_t memmgr_get_minimum_free_heap(void) {
+    return 64 * 1024;
+}
+
+size_t memmgr_heap_get_max_free_block(void) {
+    return 64 * 1024;
+}
+
+/* furi_hal */
+
+static pthread_mutex_t host_random_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t host_random_state;
+
+uint32_t furi_hal_rtc_get_timestamp(void) {
+    return time(NULL);
+}
+
+// xorshift64 from a fixed seed, only the chain pool's nonces come from it
+void furi_hal_random_fill_buf(uint8_t* buffer, uint32_t len) {
+    pthread_mutex_lock(&host_random_mutex);
+    for(uint32_t i = 0; i < len; i++) {
+        host_random_state ^= host_random_state << 13;
+        host_random_state ^= host_random_state >> 7;
+        host_random_state ^= host_random_state << 17;
+        buffer[i] = host_random_state >> 24;
+    }
+    pthread_mutex_unlock(&host_random_mutex);
+}
+
+uint32_t furi_hal_cortex_instructions_per_microsecond(void) {
+    return 1000;
+}
+
+DWT_Type* host_dwt(void) {
+    static __thread DWT_Type dwt;
+    dwt.CYCCNT = host_ns();
+    return &dwt;
+}
+
+void furi_hal_rfid_tim_emulate_dma_start(
+    uint32_t* duration,
+    uint32_t* pulse,
+    size_t length,
+    FuriHalRfidDMACallback callback,
+    void* context) {
+    UNUSED(duration);
+    UNUSED(pulse);
+    UNUSED(length);
+    UNUSED(callback);
+    UNUSED(context);
+}
+
+void furi_hal_rfid_tim_emulate_dma_stop(void) {
+}
+
+/* lfrfid */
+
+typedef struct {
+    const char* name;
+    uint8_t data_size;
+    uint8_t half_bit; // carrier clocks per half bit of the EM4100 family, 0 for the others
+} HostProtocol;
+
+static const HostProtocol host_protocols[LFRFIDProtocolMax] = {
+    [LFRFIDProtocolEM4100] = {"EM4100", 5, 32},
+    [LFRFIDProtocolEM4100_32] = {"EM4100/32", 5, 16},
+    [LFRFIDProtocolEM4100_16] = {"EM4100/16", 5, 8},
+    [LFRFIDProtocolElectra] = {"Electra", 8, 0},
+    [LFRFIDProtocolH10301] = {"H10301", 3, 0},
+    [LFRFIDProtocolIdteck] = {"Idteck", 8, 0},
+    [LFRFIDProtocolIndala26] = {"Indala26", 4, 0},
+    [LFRFIDProtocolIOProxXSF] = {"IoProxXSF", 4, 0},
+    [LFRFIDProtocolAwid] = {"AWID", 8, 0},
+    [LFRFIDProtocolFDXA] = {"FDX-A", 5, 0},
+    [LFRFIDProtocolFDXB] = {"FDX-B", 8, 0},
+    [LFRFIDProtocolHidGeneric] = {"HIDProx", 6, 0},
+};
+
+const void* lfrfid_protocols[LFRFIDProtocolMax] = {0};
+
+struct ProtocolDict {
+    uint8_t data[LFRFIDProtocolMax][HOST_PROTOCOL_DATA_MAX];
+    uint64_t frame; // EM4100 frame being encoded, first bit in the top one
+    uint8_t bit;
+    bool second_half;
+};
+
+ProtocolDict* protocol_dict_alloc(const void* const* protocols, size_t count) {
+    UNUSED(protocols);
+    furi_check(count == LFRFIDProtocolMax);
+    return calloc(1, sizeof(ProtocolDict));
+}
+
+void protocol_dict_free(ProtocolDict* dict) {
+    free(dict);
+}
+
+void protocol_dict_set_data(ProtocolDict* dict, size_t protocol, const uint8_t* data, size_t size) {
+    furi_check(protocol < LFRFIDProtocolMax);
+    memcpy(dict->data[protocol], data, MIN(size, (size_t)host_protocols[protocol].data_size));
+}
+
+void protocol_dict_get_data(ProtocolDict* dict, size_t protocol, uint8_t* data, size_t size) {
+    furi_check(protocol < LFRFIDProtocolMax);
+    memcpy(data, dict->data[protocol], MIN(size, (size_t)host_protocols[protocol].data_size));
+}
+
+size_t protocol_dict_get_data_size(ProtocolDict* dict, size_t protocol) {
+    UNUSED(dict);
+    furi_check(protocol < LFRFIDProtocolMax);
+    return host_protocols[protocol].data_size;
+}
+
+const char* protocol_dict_get_name(ProtocolDict* dict, size_t protocol) {
+    UNUSED(dict);
+    furi_check(protocol < LFRFIDProtocolMax);
+    return host_protocols[protocol].name;
+}
+
+ProtocolId protocol_dict_get_protocol_by_name(ProtocolDict* dict, const char* name) {
+    UNUSED(dict);
+    for(ProtocolId protocol = 0; protocol < LFRFIDProtocolMax; protocol++) {
+        if(strcmp(host_protocols[protocol].name, name) == 0) return protocol;
+    }
+    return PROTOCOL_NO;
+}
+
+// 9 header ones, 10 rows of a nibble and its even parity, 4 column parity bits and a stop bit
+static uint64_t host_em4100_frame(const uint8_t* data) {
+    uint64_t frame = 0x1FF;
+    uint8_t columns = 0;
+    for(uint8_t row = 0; row < 10; row++) {
+        uint8_t nibble = (data[row / 2] >> (row % 2 ? 0 : 4)) & 0x0F;
+        frame = (frame << 5) | ((uint64_t)nibble << 1) | (__builtin_popcount(nibble) & 1);
+        columns ^= nibble;
+    }
+    return (frame << 5) | ((uint64_t)columns << 1);
+}
+
+// the EM4100 family in Manchester, anything else as a plain square wave: the app only keeps
+// what the encoder yields, it never has to be read by a reader
+bool protocol_dict_encoder_start(ProtocolDict* dict, size_t protocol) {
+    furi_check(protocol < LFRFIDProtocolMax);
+    dict->frame = host_em4100_frame(dict->data[protocol]);
+    dict->bit = 0;
+    dict->second_half = false;
+    return true;
+}
+
+LevelDuration protocol_dict_encoder_yield(ProtocolDict* dict, size_t protocol) {
+    uint8_t half_bit = host_protocols[protocol].half_bit;
+    bool level = half_bit ? (dict->frame >> (63 - dict->bit)) & 1 : true;
+    if(dict->second_half) {
+        level = !level;
+        dict->bit = (dict->bit + 1) % 64;
+    }
+    dict->second_half = !dict->second_half;
+    return (LevelDuration){.level = level, .duration = half_bit ? half_bit : 32};
+}
+
+// T5577 configuration of the EM4100 family: Manchester, the bit rate and two data blocks
+#define HOST_T5577_MANCHESTER 0x00008000
+#define HOST_T5577_MAXBLOCK_2 0x00000040
+#define HOST_T5577_RF_64 0x00140000
+#define HOST_T5577_RF_32 0x000C0000
+#define HOST_T5577_RF_16 0x00040000
+
+bool protocol_dict_get_write_data(ProtocolDict* dict, size_t protocol, void* data) {
+    LFRFIDWriteRequest* request = data;
+    uint8_t half_bit = protocol < LFRFIDProtocolMax ? host_protocols[protocol].half_bit : 0;
+    if(request->write_type != LFRFIDWriteTypeT5577 || !half_bit) return false;
+    uint64_t frame = host_em4100_frame(dict->data[protocol]);
+    uint32_t rate = half_bit == 32 ? HOST_T5577_RF_64 : half_bit == 16 ? HOST_T5577_RF_32 : HOST_T5577_RF_16;
+    request->t5577.block[0] = HOST_T5577_MANCHESTER | rate | HOST_T5577_MAXBLOCK_2;
+    request->t5577.block[1] = frame >> 32;
+    request->t5577.block[2] = frame;
+    request->t5577.blocks_to_write = 3;
+    return true;
+}
+
+void t5577_write_with_mask(LFRFIDT5577* data, uint8_t page, bool with_password, uint32_t password) {
+    UNUSED(data);
+    UNUSED(page);
+    UNUSED(with_password);
+    UNUSED(password);
+}
+
+// never reads, writes or emulates: its results only come from a replayed trace
+struct LFRFIDWorker {
+    ProtocolDict* dict;
+};
+
+LFRFIDWorker* lfrfid_worker_alloc(ProtocolDict* dict) {
+    LFRFIDWorker* worker = malloc(sizeof(LFRFIDWorker));
+    worker->dict = dict;
+    return worker;
+}
+
+void lfrfid_worker_free(LFRFIDWorker* worker) {
+    free(worker);
+}
+
+void lfrfid_worker_start_thread(LFRFIDWorker* worker) {
+    UNUSED(worker);
+}
+
+void lfrfid_worker_stop_thread(LFRFIDWorker* worker) {
+    UNUSED(worker);
+}
+
+void lfrfid_worker_stop(LFRFIDWorker* worker) {
+    UNUSED(worker);
+}
+
+void lfrfid_worker_read_start(
+    LFRFIDWorker* worker,
+    LFRFIDWorkerReadType type,
+    LFRFIDWorkerReadCallback callback,
+    void* context) {
+    UNUSED(worker);
+    UNUSED(type);
+    UNUSED(callback);
+    UNUSED(context);
+}
+
+void lfrfid_worker_write_start(
+    LFRFIDWorker* worker,
+    LFRFIDProtocol protocol,
+    LFRFIDWorkerWriteCallback callback,
+    void* context) {
+    UNUSED(worker);
+    UNUSED(protocol);
+    UNUSED(callback);
+    UNUSED(context);
+}
+
+void lfrfid_worker_emulate_start(LFRFIDWorker* worker, LFRFIDProtocol protocol) {
+    UNUSED(worker);
+    UNUSED(protocol);
+}
+
+// a pulse is a high level and the low one after it, complete once the next high one starts
+struct PulseGlue {
+    uint32_t high;
+    uint32_t low;
+    uint32_t duration; // of the last complete pulse, high and low
+    uint32_t pulse; // its high part
+};
+
+PulseGlue* pulse_glue_alloc(void) {
+    PulseGlue* glue = malloc(sizeof(PulseGlue));
+    memset(glue, 0, sizeof(PulseGlue));
+    return glue;
+}
+
+void pulse_glue_free(PulseGlue* glue) {
+    free(glue);
+}
+
+bool pulse_glue_push(PulseGlue* glue, bool polarity, uint32_t length) {
+    if(!polarity) {
+        glue->low += length;
+        return false;
+    }
+    if(!glue->low) {
+        glue->high += length;
+        return false;
+    }
+    glue->duration = glue->high + glue->low;
+    glue->pulse = glue->high;
+    glue->high = length;
+    glue->low = 0;
+    return true;
+}
+
+void pulse_glue_pop(PulseGlue* glue, uint32_t* length, uint32_t* period) {
+    *length = glue->duration;
+    *period = glue->pulse;
+}
+
+/* gui */
+
+struct ViewPort {
+    ViewPortDrawCallback draw;
+    void* draw_context;
+    ViewPortInputCallback input;
+    void* input_context;
+    bool enabled;
+};
+
+struct Canvas {
+    uint8_t unused;
+};
+static Canvas host_canvas;
+
+ViewPort* view_port_alloc(void) {
+    ViewPort* view_port = calloc(1, sizeof(ViewPort));
+    view_port->enabled = true;
+    return view_port;
+}
+
+void view_port_free(ViewPort* view_port) {
+    free(view_port);
+}
+
+void view_port_draw_callback_set(ViewPort* view_port, ViewPortDrawCallback callback, void* context) {
+    view_port->draw = callback;
+    view_port->draw_context = context;
+}
+
+void view_port_input_callback_set(ViewPort* view_port, ViewPortInputCallback callback, void* context) {
+    view_port->input = callback;
+    view_port->input_context = context;
+}
+
+// draws right away, the device's GUI thread would draw soon after
+void view_port_update(ViewPort* view_port) {
+    if(view_port->enabled && view_port->draw) {
+        view_port->draw(&host_canvas, view_port->draw_context);
+    }
+}
+
+void view_port_enabled_set(ViewPort* view_port, bool enabled) {
+    view_port->enabled = enabled;
+}
+
+void gui_add_view_port(Gui* gui, ViewPort* view_port, GuiLayer layer) {
+    UNUSED(gui);
+    UNUSED(view_port);
+    UNUSED(layer);
+}
+
+void gui_remove_view_port(Gui* gui, ViewPort* view_port) {
+    UNUSED(gui);
+    UNUSED(view_port);
+}
+
+void canvas_clear(Canvas* canvas) {
+    UNUSED(canvas);
+}
+
+void canvas_set_font(Canvas* canvas, Font font) {
+    UNUSED(canvas);
+    UNUSED(font);
+}
+
+void canvas_draw_str(Canvas* canvas, int32_t x, int32_t y, const char* text) {
+    UNUSED(canvas);
+    UNUSED(x);
+    UNUSED(y);
+    UNUSED(text);
+}
+
+size_t canvas_width(const Canvas* canvas) {
+    UNUSED(canvas);
+    return 128;
+}
+
+void elements_scrollbar_pos(Canvas* canvas, int32_t x, int32_t y, size_t height, size_t pos, size_t total) {
+    UNUSED(canvas);
+    UNUSED(x);
+    UNUSED(y);
+    UNUSED(height);
+    UNUSED(pos);
+    UNUSED(total);
+}
+
+/* storage */
+
+// the host path of an /ext path, false for any other
+static bool host_path(const char* path, char* out) {
+    if(strncmp(path, "/ext", 4) != 0 || (path[4] != '/' && path[4] != '\0')) {
+        host_log('E', "host", "%s is outside /ext", path);
+        return false;
+    }
+    return (size_t)snprintf(out, HOST_PATH_LEN, "%s%s", host_sd_root, path + 4) < HOST_PATH_LEN;
+}
+
+struct File {
+    int fd;
+    DIR* dir;
+};
+
+File* storage_file_alloc(Storage* storage) {
+    UNUSED(storage);
+    File* file = malloc(sizeof(File));
+    file->fd = -1;
+    file->dir = NULL;
+    return file;
+}
+
+void storage_file_free(File* file) {
+    storage_file_close(file);
+    storage_dir_close(file);
+    free(file);
+}
+
+bool storage_file_open(File* file, const char* path, FS_AccessMode access_mode, FS_OpenMode open_mode) {
+    char host[HOST_PATH_LEN];
+    if(file->fd >= 0 || !host_path(path, host)) return false;
+    int flags = access_mode == FSAM_READ_WRITE ? O_RDWR : access_mode == FSAM_WRITE ? O_WRONLY : O_RDONLY;
+    if(open_mode == FSOM_OPEN_ALWAYS || open_mode == FSOM_OPEN_APPEND) flags |= O_CREAT;
+    if(open_mode == FSOM_CREATE_NEW) flags |= O_CREAT | O_EXCL;
+    if(open_mode == FSOM_CREATE_ALWAYS) flags |= O_CREAT | O_TRUNC;
+    file->fd = open(host, flags, 0644);
+    if(file->fd >= 0 && open_mode == FSOM_OPEN_APPEND) {
+        lseek(file->fd, 0, SEEK_END);
+    }
+    return file->fd >= 0;
+}
+
+bool storage_file_close(File* file) {
+    if(file->fd < 0) return false;
+    close(file->fd);
+    file->fd = -1;
+    return true;
+}
+
+size_t storage_file_read(File* file, void* buff, size_t bytes_to_read) {
+    size_t done = 0;
+    while(file->fd >= 0 && done < bytes_to_read) {
+        ssize_t got = read(file->fd, (uint8_t*)buff + done, bytes_to_read - done);
+        if(got <= 0) break;
+        done += got;
+    }
+    return done;
+}
+
+size_t storage_file_write(File* file, const void* buff, size_t bytes_to_write) {
+    size_t done = 0;
+    while(file->fd >= 0 && done < bytes_to_write) {
+        ssize_t put = write(file->fd, (const uint8_t*)buff + done, bytes_to_write - done);
+        if(put <= 0) break;
+        done += put;
+    }
+    return done;
+}
+
+bool storage_file_seek(File* file, uint32_t offset, bool from_start) {
+    return file->fd >= 0 && lseek(file->fd, offset, from_start ? SEEK_SET : SEEK_CUR) >= 0;
+}
+
+uint64_t storage_file_tell(File* file) {
+    off_t position = file->fd >= 0 ? lseek(file->fd, 0, SEEK_CUR) : -1;
+    return position < 0 ? 0 : (uint64_t)position;
+}
+
+uint64_t storage_file_size(File* file) {
+    struct stat st;
+    return file->fd >= 0 && fstat(file->fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+bool storage_file_truncate(File* file) {
+    return file->fd >= 0 && ftruncate(file->fd, storage_file_tell(file)) == 0;
+}
+
+bool storage_file_exists(Storage* storage, const char* path) {
+    FileInfo info;
+    return storage_common_stat(storage, path, &info) == FSE_OK && !file_info_is_dir(&info);
+}
+
+bool storage_dir_open(File* file, const char* path) {
+    char host[HOST_PATH_LEN];
+    if(file->dir || !host_path(path, host)) return false;
+    file->dir = opendir(host);
+    return file->dir != NULL;
+}
+
+bool storage_dir_close(File* file) {
+    if(!file->dir) return false;
+    closedir(file->dir);
+    file->dir = NULL;
+    return true;
+}
+
+bool storage_dir_read(File* file, FileInfo* fileinfo, char* name, uint16_t name_length) {
+    struct dirent* entry;
+    while(file->dir && (entry = readdir(file->dir))) {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        struct stat st;
+        if(fstatat(dirfd(file->dir), entry->d_name, &st, 0) != 0) continue;
+        if(fileinfo) {
+            fileinfo->flags = S_ISDIR(st.st_mode) ? FSF_DIRECTORY : 0;
+            fileinfo->size = st.st_size;
+        }
+        if(name) {
+            snprintf(name, name_length, "%s", entry->d_name);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool file_info_is_dir(const FileInfo* file_info) {
+    return file_info->flags & FSF_DIRECTORY;
+}
+
+FS_Error storage_common_stat(Storage* storage, const char* path, FileInfo* fileinfo) {
+    UNUSED(storage);
+    char host[HOST_PATH_LEN];
+    struct stat st;
+    if(!host_path(path, host)) return FSE_INVALID_NAME;
+    if(stat(host, &st) != 0) return FSE_NOT_EXIST;
+    if(fileinfo) {
+        fileinfo->flags = S_ISDIR(st.st_mode) ? FSF_DIRECTORY : 0;
+        fileinfo->size = st.st_size;
+    }
+    return FSE_OK;
+}
+
+FS_Error storage_common_copy(Storage* storage, const char* old_path, const char* new_path) {
+    if(storage_common_stat(storage, new_path, NULL) == FSE_OK) return FSE_EXIST;
+    File* from = storage_file_alloc(storage);
+    File* to = storage_file_alloc(storage);
+    FS_Error error = FSE_NOT_EXIST;
+    if(storage_file_open(from, old_path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        error = FSE_INTERNAL;
+        if(storage_file_open(to, new_path, FSAM_WRITE, FSOM_CREATE_NEW)) {
+            uint8_t buff[512];
+            size_t len;
+            error = FSE_OK;
+            while(error == FSE_OK && (len = storage_file_read(from, buff, sizeof(buff)))) {
+                if(storage_file_write(to, buff, len) != len) error = FSE_INTERNAL;
+            }
+        }
+    }
+    storage_file_free(from);
+    storage_file_free(to);
+    return error;
+}
+
+FS_Error storage_common_remove(Storage* storage, const char* path) {
+    UNUSED(storage);
+    char host[HOST_PATH_LEN];
+    if(!host_path(path, host)) return FSE_INVALID_NAME;
+    if(remove(host) == 0) return FSE_OK;
+    return errno == ENOENT ? FSE_NOT_EXIST : FSE_DENIED;
+}
+
+bool storage_simply_mkdir(Storage* storage, const char* path) {
+    UNUSED(storage);
+    char host[HOST_PATH_LEN];
+    return host_path(path, host) && (mkdir(host, 0755) == 0 || errno == EEXIST);
+}
+
+static int host_remove_entry(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+    UNUSED(st);
+    UNUSED(flag);
+    UNUSED(ftw);
+    return remove(path);
+}
+
+bool storage_simply_remove_recursive(Storage* storage, const char* path) {
+    UNUSED(storage);
+    char host[HOST_PATH_LEN];
+    struct stat st;
+    if(!host_path(path, host)) return false;
+    if(stat(host, &st) != 0) return true;
+    return nftw(host, host_remove_entry, 16, FTW_DEPTH | FTW_PHYS) == 0;
+}
+
+/* flipper_format */
+
+// the lines of the open file, written back whole after every change
+struct FlipperFormat {
+    Storage* storage;
+    char path[HOST_PATH_LEN];
+    bool open;
+    char** lines;
+    size_t count;
+    size_t capacity;
+    size_t cursor; // reads look for their key from this line on
+};
+
+static void flipper_format_clear(FlipperFormat* format) {
+    for(size_t i = 0; i < format->count; i++) {
+        free(format->lines[i]);
+    }
+    format->count = 0;
+    format->cursor = 0;
+}
+
+static void flipper_format_add_line(FlipperFormat* format, const char* line) {
+    if(format->count == format->capacity) {
+        format->capacity = format->capacity ? 2 * format->capacity : 16;
+        format->lines = realloc(format->lines, format->capacity * sizeof(char*));
+    }
+    format->lines[format->count++] = strdup(line);
+}
+
+static bool flipper_format_save(FlipperFormat* format) {
+    File* file = storage_file_alloc(format->storage);
+    bool saved = storage_file_open(file, format->path, FSAM_WRITE, FSOM_CREATE_ALWAYS);
+    for(size_t i = 0; saved && i < format->count; i++) {
+        size_t len = strlen(format->lines[i]);
+        saved = storage_file_write(file, format->lines[i], len) == len &&
+                storage_file_write(file, "\n", 1) == 1;
+    }
+    storage_file_free(file);
+    return saved;
+}
+
+static bool flipper_format_load(FlipperFormat* format) {
+    File* file = storage_file_alloc(format->storage);
+    bool loaded = storage_file_open(file, format->path, FSAM_READ, FSOM_OPEN_EXISTING);
+    char line[HOST_LINE_LEN];
+    size_t len = 0;
+    char c;
+    while(loaded && storage_file_read(file, &c, 1) == 1) {
+        if(c == '\n' || len == sizeof(line) - 1) {
+            line[len] = '\0';
+            flipper_format_add_line(format, line);
+            len = 0;
+        } else if(c != '\r') {
+            line[len++] = c;
+        }
+    }
+    if(loaded && len) {
+        line[len] = '\0';
+        flipper_format_add_line(format, line);
+    }
+    storage_file_free(file);
+    return loaded;
+}
+
+// the value of the first line from the cursor on with key, NULL if there is none
+static const char* flipper_format_find(FlipperFormat* format, const char* key, size_t* index) {
+    size_t key_len = strlen(key);
+    for(size_t i = format->cursor; format->open && i < format->count; i++) {
+        const char* line = format->lines[i];
+        if(strncmp(line, key, key_len) == 0 && line[key_len] == ':') {
+            if(index) *index = i;
+            return line + key_len + 1;
+        }
+    }
+    return NULL;
+}
+
+static bool flipper_format_write_line(FlipperFormat* format, const char* line) {
+    if(!format->open) return false;
+    flipper_format_add_line(format, line);
+    format->cursor = format->count;
+    return flipper_format_save(format);
+}
+
+FlipperFormat* flipper_format_file_alloc(Storage* storage) {
+    FlipperFormat* format = calloc(1, sizeof(FlipperFormat));
+    format->storage = storage;
+    return format;
+}
+
+void flipper_format_free(FlipperFormat* format) {
+    flipper_format_file_close(format);
+    free(format->lines);
+    free(format);
+}
+
+static bool flipper_format_open(FlipperFormat* format, const char* path, FS_OpenMode mode) {
+    flipper_format_file_close(format);
+    snprintf(format->path, sizeof(format->path), "%s", path);
+    bool exists = storage_common_stat(format->storage, path, NULL) == FSE_OK;
+    if(mode == FSOM_OPEN_EXISTING) {
+        format->open = exists && flipper_format_load(format);
+    } else {
+        format->open = (mode != FSOM_CREATE_NEW || !exists) && flipper_format_save(format);
+    }
+    return format->open;
+}
+
+bool flipper_format_file_open_new(FlipperFormat* format, const char* path) {
+    return flipper_format_open(format, path, FSOM_CREATE_NEW);
+}
+
+bool flipper_format_file_open_existing(FlipperFormat* format, const char* path) {
+    return flipper_format_open(format, path, FSOM_OPEN_EXISTING);
+}
+
+bool flipper_format_file_open_always(FlipperFormat* format, const char* path) {
+    return flipper_format_open(format, path, FSOM_CREATE_ALWAYS);
+}
+
+bool flipper_format_file_close(FlipperFormat* format) {
+    bool was_open = format->open;
+    flipper_format_clear(format);
+    format->open = false;
+    return was_open;
+}
+
+bool flipper_format_rewind(FlipperFormat* format) {
+    format->cursor = 0;
+    return format->open;
+}
+
+bool flipper_format_get_value_count(FlipperFormat* format, const char* key, uint32_t* count) {
+    const char* value = flipper_format_find(format, key, NULL);
+    if(!value) return false;
+    *count = 0;
+    for(bool in_value = false; *value; value++) {
+        if(*value != ' ' && !in_value) (*count)++;
+        in_value = *value != ' ';
+    }
+    return true;
+}
+
+bool flipper_format_write_header_cstr(FlipperFormat* format, const char* filetype, uint32_t version) {
+    char line[HOST_LINE_LEN];
+    snprintf(line, sizeof(line), "Filetype: %s", filetype);
+    if(!flipper_format_write_line(format, line)) return false;
+    snprintf(line, sizeof(line), "Version: %u", version);
+    return flipper_format_write_line(format, line);
+}
+
+bool flipper_format_delete_key(FlipperFormat* format, const char* key) {
+    size_t cursor = format->cursor;
+    size_t index;
+    format->cursor = 0;
+    bool found = flipper_format_find(format, key, &index) != NULL;
+    format->cursor = cursor;
+    if(!found) return false;
+    free(format->lines[index]);
+    memmove(&format->lines[index], &format->lines[index + 1], (format->count - index - 1) * sizeof(char*));
+    format->count--;
+    if(format->cursor > index) format->cursor--;
+    return flipper_format_save(format);
+}
+
+bool flipper_format_write_hex(FlipperFormat* format, const char* key, const uint8_t* data, uint16_t count) {
+    char line[HOST_LINE_LEN];
+    size_t len = snprintf(line, sizeof(line), "%s:", key);
+    for(uint16_t i = 0; i < count && len + 3 < sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - len, " %02X", data[i]);
+    }
+    return flipper_format_write_line(format, line);
+}
+
+bool flipper_format_read_hex(FlipperFormat* format, const char* key, uint8_t* data, uint16_t count) {
+    size_t index;
+    const char* value = flipper_format_find(format, key, &index);
+    if(!value) return false;
+    for(uint16_t i = 0; i < count; i++) {
+        unsigned byte;
+        int used;
+        if(sscanf(value, " %2x%n", &byte, &used) != 1) return false;
+        data[i] = byte;
+        value += used;
+    }
+    format->cursor = index + 1;
+    return true;
+}
+
+bool flipper_format_write_uint32(FlipperFormat* format, const char* key, const uint32_t* data, uint16_t count) {
+    char line[HOST_LINE_LEN];
+    size_t len = snprintf(line, sizeof(line), "%s:", key);
+    for(uint16_t i = 0; i < count && len + 12 < sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - len, " %u", data[i]);
+    }
+    return flipper_format_write_line(format, line);
+}
+
+bool flipper_format_read_uint32(FlipperFormat* format, const char* key, uint32_t* data, uint16_t count) {
+    size_t index;
+    const char* value = flipper_format_find(format, key, &index);
+    if(!value) return false;
+    for(uint16_t i = 0; i < count; i++) {
+        int used;
+        if(sscanf(value, " %u%n", &data[i], &used) != 1) return false;
+        value += used;
+    }
+    format->cursor = index + 1;
+    return true;
+}
+
+// the stock RFID app's key files: "Key type" is the protocol name, "Data" its bytes
+ProtocolId lfrfid_dict_file_load(ProtocolDict* dict, const char* filename) {
+    FlipperFormat* format = flipper_format_file_alloc(&host_storage);
+    ProtocolId protocol = PROTOCOL_NO;
+    const char* name = NULL;
+    uint8_t data[HOST_PROTOCOL_DATA_MAX];
+    if(flipper_format_file_open_existing(format, filename)) {
+        name = flipper_format_find(format, "Key type", NULL);
+    }
+    if(name) {
+        protocol = protocol_dict_get_protocol_by_name(dict, name + 1);
+    }
+    if(protocol != PROTOCOL_NO &&
+       flipper_format_read_hex(format, "Data", data, protocol_dict_get_data_size(dict, protocol))) {
+        protocol_dict_set_data(dict, protocol, data, sizeof(data));
+    } else {
+        protocol = PROTOCOL_NO;
+    }
+    flipper_format_free(format);
+    return protocol;
+}
+
+bool lfrfid_dict_file_save(ProtocolDict* dict, ProtocolId protocol, const char* filename) {
+    FlipperFormat* format = flipper_format_file_alloc(&host_storage);
+    char line[HOST_LINE_LEN];
+    snprintf(line, sizeof(line), "Key type: %s", protocol_dict_get_name(dict, protocol));
+    bool saved = flipper_format_file_open_always(format, filename) &&
+                 flipper_format_write_header_cstr(format, "Flipper RFID key", 1) &&
+                 flipper_format_write_line(format, line) &&
+                 flipper_format_write_hex(format, "Data", dict->data[protocol], protocol_dict_get_data_size(dict, protocol));
+    flipper_format_free(format);
+    return saved;
+}
+
+/* notification */
+
+const NotificationSequence sequence_success = {"success"};
+const NotificationSequence sequence_error = {"error"};
+
+void notification_message(NotificationApp* app, const NotificationSequence* sequence) {
+    UNUSED(app);
+    host_log('D', "host", "notification %s", sequence->name);
+}
+
+void host_sdk_init(const char* sd_root) {
+    snprintf(host_sd_root, sizeof(host_sd_root), "%s", sd_root);
+    clock_gettime(CLOCK_MONOTONIC, &host_start);
+    host_random_state = 0x9E3779B97F4A7C15u;
+    host_thread_init(&host_main_thread, NULL, NULL);
+}
@@ -0,0 +1,397 @@
+#pragma once
+
+/*
+ * The part of the Flipper SDK the app uses, for host builds of rfid_app.c and its helpers.
+ * The headers next to this one stand in for the SDK's include paths and all come here.
+ *
+ * - furi: ms ticks from the monotonic clock, pthreads with per thread flags, mutexes and
+ *   message queues with timeouts
+ * - storage: /ext is a directory given to host_sdk_init, files are plain files in it
+ * - flipper_format: "Key: value" lines, kept in memory and written through on every change
+ * - lfrfid: protocol data and names, EM4100 encoded and turned into T5577 blocks the way the
+ *   firmware does. There is no radio: the worker, T5577 writes and the emulation DMA do nothing
+ * - gui: view_port_update runs the draw callback against a canvas that draws nothing
+ * - DWT->CYCCNT counts ns, furi_hal_cortex_instructions_per_microsecond is 1000 to match
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// maps /ext to sd_root, resets the clock and the random source; call before anything else
+void host_sdk_init(const char* sd_root);
+
+// log lines below this level are dropped: 'E', 'W', 'I', 'D' or 'T', 'I' by default
+void host_sdk_log_level(char level);
+
+/* furi */
+#define UNUSED(x) (void)(x)
+#define FURI_PACKED __attribute__((packed))
+#define COUNT_OF(x) (sizeof(x) / sizeof(x[0]))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// the app formats uint32_t with %lu, long being 32 bits on the device. The host's printf
+// functions below read a single l as 32 bits, anything else as printf does
+int host_snprintf(char* out, size_t size, const char* format, ...);
+#define snprintf host_snprintf
+void host_log(char level, const char* tag, const char* format, ...);
+#define FURI_LOG_E(tag, format, ...) host_log('E', tag, format, ##__VA_ARGS__)
+#define FURI_LOG_W(tag, format, ...) host_log('W', tag, format, ##__VA_ARGS__)
+#define FURI_LOG_I(tag, format, ...) host_log('I', tag, format, ##__VA_ARGS__)
+#define FURI_LOG_D(tag, format, ...) host_log('D', tag, format, ##__VA_ARGS__)
+#define FURI_LOG_T(tag, format, ...) host_log('T', tag, format, ##__VA_ARGS__)
+
+void host_crash(const char* what, const char* file, int line) __attribute__((noreturn));
+#define furi_crash(message) host_crash(message, __FILE__, __LINE__)
+#define furi_check(x)                                   \
+    do {                                                \
+        if(!(x)) host_crash(#x, __FILE__, __LINE__);    \
+    } while(0)
+#define furi_assert(x) furi_check(x)
+
+typedef enum {
+    FuriStatusOk = 0,
+    FuriStatusError = -1,
+    FuriStatusErrorTimeout = -2,
+    FuriStatusErrorResource = -3,
+} FuriStatus;
+#define FuriWaitForever 0xFFFFFFFFU
+
+typedef enum {
+    FuriFlagWaitAny = 0,
+    FuriFlagWaitAll = 1,
+    FuriFlagNoClear = 2,
+    FuriFlagError = 0x80000000U,
+    FuriFlagErrorTimeout = 0xFFFFFFFEU,
+} FuriFlag;
+
+typedef struct FuriString FuriString;
+FuriString* furi_string_alloc(void);
+void furi_string_free(FuriString* string);
+void furi_string_set(FuriString* string, const char* text);
+void furi_string_reset(FuriString* string);
+int furi_string_printf(FuriString* string, const char* format, ...);
+const char* furi_string_get_cstr(const FuriString* string);
+size_t furi_string_size(const FuriString* string);
+
+typedef struct FuriMessageQueue FuriMessageQueue;
+FuriMessageQueue* furi_message_queue_alloc(uint32_t msg_count, uint32_t msg_size);
+void furi_message_queue_free(FuriMessageQueue* queue);
+FuriStatus furi_message_queue_put(FuriMessageQueue* queue, const void* msg, uint32_t timeout);
+FuriStatus furi_message_queue_get(FuriMessageQueue* queue, void* msg, uint32_t timeout);
+uint32_t furi_message_queue_get_count(FuriMessageQueue* queue);
+
+void* furi_record_open(const char* name);
+void furi_record_close(const char* name);
+
+void furi_delay_ms(uint32_t ms);
+uint32_t furi_get_tick(void);
+uint32_t furi_ms_to_ticks(uint32_t ms);
+uint32_t furi_kernel_get_tick_frequency(void);
+
+typedef struct FuriThread FuriThread;
+typedef void* FuriThreadId;
+typedef int32_t (*FuriThreadCallback)(void* context);
+typedef enum {
+    FuriThreadPriorityLow = 16,
+    FuriThreadPriorityNormal = 24,
+} FuriThreadPriority;
+FuriThread* furi_thread_alloc_ex(
+    const char* name,
+    uint32_t stack_size,
+    FuriThreadCallback callback,
+    void* context);
+void furi_thread_free(FuriThread* thread);
+void furi_thread_set_priority(FuriThread* thread, FuriThreadPriority priority);
+void furi_thread_start(FuriThread* thread);
+bool furi_thread_join(FuriThread* thread);
+FuriThreadId furi_thread_get_id(FuriThread* thread);
+FuriThreadId furi_thread_get_current_id(void);
+uint32_t furi_thread_flags_set(FuriThreadId thread_id, uint32_t flags);
+uint32_t furi_thread_flags_get(void);
+uint32_t furi_thread_flags_wait(uint32_t flags, uint32_t options, uint32_t timeout);
+
+typedef struct FuriMutex FuriMutex;
+typedef enum {
+    FuriMutexTypeNormal,
+    FuriMutexTypeRecursive,
+} FuriMutexType;
+FuriMutex* furi_mutex_alloc(FuriMutexType type);
+void furi_mutex_free(FuriMutex* mutex);
+FuriStatus furi_mutex_acquire(FuriMutex* mutex, uint32_t timeout);
+FuriStatus furi_mutex_release(FuriMutex* mutex);
+
+// the host has no heap of its own, these report a fixed 64 KiB as free
+size_t memmgr_get_free_heap(void);
+size_t memmgr_get_minimum_free_heap(void);
+size_t memmgr_heap_get_max_free_block(void);
+
+/* furi_hal */
+uint32_t furi_hal_rtc_get_timestamp(void);
+void furi_hal_random_fill_buf(uint8_t* buffer, uint32_t len);
+uint32_t furi_hal_cortex_instructions_per_microsecond(void);
+
+typedef struct {
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+DWT_Type* host_dwt(void);
+#define DWT (host_dwt())
+
+typedef void (*FuriHalRfidDMACallback)(bool half, void* context);
+void furi_hal_rfid_tim_emulate_dma_start(
+    uint32_t* duration,
+    uint32_t* pulse,
+    size_t length,
+    FuriHalRfidDMACallback callback,
+    void* context);
+void furi_hal_rfid_tim_emulate_dma_stop(void);
+
+/* lfrfid */
+typedef int32_t ProtocolId;
+#define PROTOCOL_NO (-1)
+
+// the firmware's order, so the protocol ids in a device trace mean the same here
+typedef enum {
+    LFRFIDProtocolEM4100,
+    LFRFIDProtocolEM4100_32,
+    LFRFIDProtocolEM4100_16,
+    LFRFIDProtocolElectra,
+    LFRFIDProtocolH10301,
+    LFRFIDProtocolIdteck,
+    LFRFIDProtocolIndala26,
+    LFRFIDProtocolIOProxXSF,
+    LFRFIDProtocolAwid,
+    LFRFIDProtocolFDXA,
+    LFRFIDProtocolFDXB,
+    LFRFIDProtocolHidGeneric,
+    LFRFIDProtocolMax,
+} LFRFIDProtocol;
+extern const void* lfrfid_protocols[];
+
+typedef struct ProtocolDict ProtocolDict;
+ProtocolDict* protocol_dict_alloc(const void* const* protocols, size_t count);
+void protocol_dict_free(ProtocolDict* dict);
+void protocol_dict_set_data(ProtocolDict* dict, size_t protocol, const uint8_t* data, size_t size);
+void protocol_dict_get_data(ProtocolDict* dict, size_t protocol, uint8_t* data, size_t size);
+size_t protocol_dict_get_data_size(ProtocolDict* dict, size_t protocol);
+const char* protocol_dict_get_name(ProtocolDict* dict, size_t protocol);
+ProtocolId protocol_dict_get_protocol_by_name(ProtocolDict* dict, const char* name);
+
+typedef struct {
+    uint32_t level : 1;
+    uint32_t duration : 31;
+} LevelDuration;
+static inline bool level_duration_get_level(LevelDuration level_duration) {
+    return level_duration.level;
+}
+static inline uint32_t level_duration_get_duration(LevelDuration level_duration) {
+    return level_duration.duration;
+}
+bool protocol_dict_encoder_start(ProtocolDict* dict, size_t protocol);
+LevelDuration protocol_dict_encoder_yield(ProtocolDict* dict, size_t protocol);
+
+typedef struct {
+    uint32_t block[8];
+    uint32_t blocks_to_write;
+    uint8_t mask;
+} LFRFIDT5577;
+typedef enum {
+    LFRFIDWriteTypeT5577,
+} LFRFIDWriteType;
+typedef struct {
+    LFRFIDWriteType write_type;
+    union {
+        LFRFIDT5577 t5577;
+    };
+} LFRFIDWriteRequest;
+bool protocol_dict_get_write_data(ProtocolDict* dict, size_t protocol, void* data);
+void t5577_write_with_mask(LFRFIDT5577* data, uint8_t page, bool with_password, uint32_t password);
+
+typedef struct LFRFIDWorker LFRFIDWorker;
+typedef enum {
+    LFRFIDWorkerReadTypeAuto,
+    LFRFIDWorkerReadTypeASKOnly,
+    LFRFIDWorkerReadTypePSKOnly,
+} LFRFIDWorkerReadType;
+typedef enum {
+    LFRFIDWorkerReadSenseStart,
+    LFRFIDWorkerReadSenseEnd,
+    LFRFIDWorkerReadSenseCardStart,
+    LFRFIDWorkerReadSenseCardEnd,
+    LFRFIDWorkerReadStartASK,
+    LFRFIDWorkerReadStartPSK,
+    LFRFIDWorkerReadDone,
+} LFRFIDWorkerReadResult;
+typedef enum {
+    LFRFIDWorkerWriteOK,
+    LFRFIDWorkerWriteProtocolCannotBeWritten,
+    LFRFIDWorkerWriteFobCannotBeWritten,
+    LFRFIDWorkerWriteTooLongToWrite,
+} LFRFIDWorkerWriteResult;
+typedef void (*LFRFIDWorkerReadCallback)(LFRFIDWorkerReadResult result, ProtocolId protocol, void* context);
+typedef void (*LFRFIDWorkerWriteCallback)(LFRFIDWorkerWriteResult result, void* context);
+LFRFIDWorker* lfrfid_worker_alloc(ProtocolDict* dict);
+void lfrfid_worker_free(LFRFIDWorker* worker);
+void lfrfid_worker_start_thread(LFRFIDWorker* worker);
+void lfrfid_worker_stop_thread(LFRFIDWorker* worker);
+void lfrfid_worker_stop(LFRFIDWorker* worker);
+void lfrfid_worker_read_start(
+    LFRFIDWorker* worker,
+    LFRFIDWorkerReadType type,
+    LFRFIDWorkerReadCallback callback,
+    void* context);
+void lfrfid_worker_write_start(
+    LFRFIDWorker* worker,
+    LFRFIDProtocol protocol,
+    LFRFIDWorkerWriteCallback callback,
+    void* context);
+void lfrfid_worker_emulate_start(LFRFIDWorker* worker, LFRFIDProtocol protocol);
+ProtocolId lfrfid_dict_file_load(ProtocolDict* dict, const char* filename);
+bool lfrfid_dict_file_save(ProtocolDict* dict, ProtocolId protocol, const char* filename);
+
+// hardware_worker.h builds against the iButton types unless RFID_125_PROTOCOL is set
+typedef int32_t iButtonProtocolId;
+
+typedef struct PulseGlue PulseGlue;
+PulseGlue* pulse_glue_alloc(void);
+void pulse_glue_free(PulseGlue* glue);
+bool pulse_glue_push(PulseGlue* glue, bool polarity, uint32_t length);
+void pulse_glue_pop(PulseGlue* glue, uint32_t* length, uint32_t* period);
+
+/* gui */
+typedef struct Gui Gui;
+typedef struct ViewPort ViewPort;
+typedef struct Canvas Canvas;
+#define RECORD_GUI "gui"
+typedef enum {
+    GuiLayerFullscreen,
+} GuiLayer;
+typedef enum {
+    FontPrimary,
+    FontSecondary,
+    FontKeyboard,
+} Font;
+typedef enum {
+    InputKeyUp,
+    InputKeyDown,
+    InputKeyRight,
+    InputKeyLeft,
+    InputKeyOk,
+    InputKeyBack,
+    InputKeyMAX,
+} InputKey;
+typedef enum {
+    InputTypePress,
+    InputTypeRelease,
+    InputTypeShort,
+    InputTypeLong,
+    InputTypeRepeat,
+    InputTypeMAX,
+} InputType;
+typedef struct {
+    uint32_t sequence;
+    InputKey key;
+    InputType type;
+} InputEvent;
+typedef void (*ViewPortDrawCallback)(Canvas* canvas, void* context);
+typedef void (*ViewPortInputCallback)(InputEvent* event, void* context);
+ViewPort* view_port_alloc(void);
+void view_port_free(ViewPort* view_port);
+void view_port_draw_callback_set(ViewPort* view_port, ViewPortDrawCallback callback, void* context);
+void view_port_input_callback_set(ViewPort* view_port, ViewPortInputCallback callback, void* context);
+void view_port_update(ViewPort* view_port);
+void view_port_enabled_set(ViewPort* view_port, bool enabled);
+void gui_add_view_port(Gui* gui, ViewPort* view_port, GuiLayer layer);
+void gui_remove_view_port(Gui* gui, ViewPort* view_port);
+void canvas_clear(Canvas* canvas);
+void canvas_set_font(Canvas* canvas, Font font);
+void canvas_draw_str(Canvas* canvas, int32_t x, int32_t y, const char* text);
+size_t canvas_width(const Canvas* canvas);
+void elements_scrollbar_pos(Canvas* canvas, int32_t x, int32_t y, size_t height, size_t pos, size_t total);
+typedef struct ByteInput ByteInput;
+
+/* storage */
+typedef struct Storage Storage;
+typedef struct File File;
+#define RECORD_STORAGE "storage"
+typedef enum {
+    FSAM_READ = 1,
+    FSAM_WRITE = 2,
+    FSAM_READ_WRITE = 3,
+} FS_AccessMode;
+typedef enum {
+    FSOM_OPEN_EXISTING = 1,
+    FSOM_OPEN_ALWAYS = 2,
+    FSOM_OPEN_APPEND = 4,
+    FSOM_CREATE_NEW = 8,
+    FSOM_CREATE_ALWAYS = 16,
+} FS_OpenMode;
+typedef enum {
+    FSE_OK,
+    FSE_NOT_READY,
+    FSE_EXIST,
+    FSE_NOT_EXIST,
+    FSE_INVALID_PARAMETER,
+    FSE_DENIED,
+    FSE_INVALID_NAME,
+    FSE_INTERNAL,
+    FSE_NOT_IMPLEMENTED,
+    FSE_ALREADY_OPEN,
+} FS_Error;
+typedef enum {
+    FSF_DIRECTORY = 1,
+} FS_Flags;
+typedef struct {
+    uint8_t flags;
+    uint64_t size;
+} FileInfo;
+File* storage_file_alloc(Storage* storage);
+void storage_file_free(File* file);
+bool storage_file_open(File* file, const char* path, FS_AccessMode access_mode, FS_OpenMode open_mode);
+bool storage_file_close(File* file);
+size_t storage_file_read(File* file, void* buff, size_t bytes_to_read);
+size_t storage_file_write(File* file, const void* buff, size_t bytes_to_write);
+bool storage_file_seek(File* file, uint32_t offset, bool from_start);
+uint64_t storage_file_tell(File* file);
+uint64_t storage_file_size(File* file);
+bool storage_file_truncate(File* file);
+bool storage_file_exists(Storage* storage, const char* path);
+bool storage_dir_open(File* file, const char* path);
+bool storage_dir_close(File* file);
+bool storage_dir_read(File* file, FileInfo* fileinfo, char* name, uint16_t name_length);
+bool file_info_is_dir(const FileInfo* file_info);
+FS_Error storage_common_stat(Storage* storage, const char* path, FileInfo* fileinfo);
+FS_Error storage_common_copy(Storage* storage, const char* old_path, const char* new_path);
+FS_Error storage_common_remove(Storage* storage, const char* path);
+bool storage_simply_mkdir(Storage* storage, const char* path);
+bool storage_simply_remove_recursive(Storage* storage, const char* path);
+
+typedef struct FlipperFormat FlipperFormat;
+FlipperFormat* flipper_format_file_alloc(Storage* storage);
+void flipper_format_free(FlipperFormat* format);
+bool flipper_format_file_open_new(FlipperFormat* format, const char* path);
+bool flipper_format_file_open_existing(FlipperFormat* format, const char* path);
+bool flipper_format_file_open_always(FlipperFormat* format, const char* path);
+bool flipper_format_file_close(FlipperFormat* format);
+bool flipper_format_rewind(FlipperFormat* format);
+bool flipper_format_get_value_count(FlipperFormat* format, const char* key, uint32_t* count);
+bool flipper_format_write_header_cstr(FlipperFormat* format, const char* filetype, uint32_t version);
+bool flipper_format_delete_key(FlipperFormat* format, const char* key);
+bool flipper_format_write_hex(FlipperFormat* format, const char* key, const uint8_t* data, uint16_t count);
+bool flipper_format_read_hex(FlipperFormat* format, const char* key, uint8_t* data, uint16_t count);
+bool flipper_format_write_uint32(FlipperFormat* format, const char* key, const uint32_t* data, uint16_t count);
+bool flipper_format_read_uint32(FlipperFormat* format, const char* key, uint32_t* data, uint16_t count);
+
+/* notification */
+typedef struct NotificationApp NotificationApp;
+typedef struct {
+    const char* name;
+} NotificationSequence;
+#define RECORD_NOTIFICATION "notification"
+extern const NotificationSequence sequence_success;
+extern const NotificationSequence sequence_error;
+void notification_message(NotificationApp* app, const NotificationSequence* sequence);
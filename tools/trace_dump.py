@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""Prints and summarizes an event trace (trace.bin) recorded by the app.
+
+The layout is described in helpers/event_trace.h:
+  b"HTTR", u8 version, u8 reserved, u16 tick frequency, u32 tick and u32 RTC time
+  at the start of the recording, then records of
+  u32 tick, u16 queue delay in ticks, u8 event type (bit 0x80: a payload follows,
+  bit 0x40: auto repeat of a held key)
+  and, with the payload bit, u8 protocol and 8 data bytes
+All little-endian. Create /ext/rfid_hashes/trace.on to have every session recorded;
+"Replay Trace" in the menu plays the last recording back through the app.
+
+  trace_dump.py rfid_hashes/trace.bin
+  trace_dump.py trace.bin --summary --gaps 10
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"HTTR"
+VERSION = 2
+HEADER = struct.Struct("<4sBBHII")
+RECORD = struct.Struct("<IHB")  # tick, delay, type
+PAYLOAD = struct.Struct("<B8s")  # protocol, data
+HAS_DATA = 0x80
+REPEAT = 0x40
+# RfidAppEventType, in enum order
+EVENTS = [
+    "Up", "Down", "Left", "Right", "Ok", "Back", "BackLong", "OkLong",
+    "CardSensed", "CardRemoved", "ReadDone", "WriteOk", "WriteFail", "Tick",
+]
+
+
+def read_trace(path):
+    """Returns the tick frequency, the start tick and the records as (tick, delay, type, repeat, protocol, data)."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER.size:
+        raise ValueError("file too short")
+    magic, version, _, frequency, start, _ = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        raise ValueError("not a HTTR file")
+    if version != VERSION:
+        raise ValueError(f"unsupported version {version}")
+    records = []
+    pos = HEADER.size
+    while pos + RECORD.size <= len(data):
+        tick, delay, kind = RECORD.unpack_from(data, pos)
+        pos += RECORD.size
+        protocol, payload = None, None
+        if kind & HAS_DATA:
+            if pos + PAYLOAD.size > len(data):
+                break  # cut off while the app was running
+            protocol, payload = PAYLOAD.unpack_from(data, pos)
+            pos += PAYLOAD.size
+        records.append((tick, delay, kind & ~(HAS_DATA | REPEAT), bool(kind & REPEAT), protocol, payload))
+    return frequency or 1000, start, records
+
+
+def event_name(kind):
+    return EVENTS[kind] if kind < len(EVENTS) else f"event {kind}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("trace", help="trace.bin copied from /ext/rfid_hashes")
+    parser.add_argument("--summary", action="store_true", help="only print the statistics")
+    parser.add_argument("--gaps", type=int, default=5, help="number of longest pauses to list")
+    args = parser.parse_args()
+    try:
+        frequency, first, records = read_trace(args.trace)
+    except (OSError, ValueError) as e:
+        sys.exit(f"error: {e}")
+    if not records:
+        sys.exit("empty trace")
+
+    ms = 1000 / frequency
+    if not args.summary:
+        for tick, delay, kind, repeat, protocol, payload in records:
+            name = event_name(kind) + (" rep" if repeat else "")
+            line = f"{(tick - first) * ms:10.0f} ms  {name:<12} queued {delay * ms:4.0f} ms"
+            if payload is not None:
+                name = "none" if protocol == 0xFF else f"protocol {protocol}"
+                line += f"  {name} {payload.hex(' ')}"
+            print(line)
+
+    # how long events waited in the queue before the state machine got to them, per type
+    print(f"\n{len(records)} events over {(records[-1][0] - first) * ms / 1000:.1f} s")
+    print(f"{'event':<12} {'count':>6} {'mean queued':>12} {'max queued':>11}")
+    for kind in sorted({record[2] for record in records}):
+        delays = [record[1] for record in records if record[2] == kind]
+        mean = sum(delays) / len(delays) * ms
+        print(f"{event_name(kind):<12} {len(delays):6d} {mean:9.1f} ms {max(delays) * ms:8.0f} ms")
+
+    gaps = sorted(
+        ((records[i][0] - records[i - 1][0], i) for i in range(1, len(records))), reverse=True)[: args.gaps]
+    if gaps:
+        print("\nlongest pauses")
+        for gap, i in gaps:
+            before, after = event_name(records[i - 1][2]), event_name(records[i][2])
+            print(f"{gap * ms:8.0f} ms  {before} -> {after} at {(records[i][0] - first) * ms:.0f} ms")
+
+
+if __name__ == "__main__":
+    main()
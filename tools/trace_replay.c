@@ -0,0 +1,90 @@
+/*
+ * Replays a trace recorded on the device through the app's real state machine, on a host with
+ * the SDK shim in tools/host. The reader, writer and emulation aren't started during a replay
+ * on the device either; the shim has no radio, draws nothing and counts ns as DWT cycles.
+ *
+ *   make -C tools trace_replay && tools/trace_replay [-r] [-v] <sd dir>
+ *
+ * <sd dir> stands in for /ext: copy rfid_hashes from the SD card into it, with trace.bin and
+ * the trace folder the recording started from. As on the device the replay runs on a fresh
+ * copy in rfid_hashes/replay and leaves it as the replay ended. -r replays at the recorded pace
+ * instead of full speed, -v prints what the app logs.
+ */
+#include "rfid_app.h"
+
+#include <host_sdk.h>
+
+static const char* const trace_replay_results[AuditResultCount] = {
+    [AuditResultAccepted] = "accepted",
+    [AuditResultUnknown] = "unknown",
+    [AuditResultRevoked] = "revoked",
+    [AuditResultStale] = "stale",
+    [AuditResultWriteFailed] = "write failed",
+    [AuditResultStorageError] = "storage error",
+};
+
+int main(int argc, char** argv) {
+    bool real_speed = false;
+    char log_level = 'W';
+    const char* sd_root = NULL;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-r") == 0) {
+            real_speed = true;
+        } else if(strcmp(argv[i], "-v") == 0) {
+            log_level = 'D';
+        } else if(!sd_root && argv[i][0] != '-') {
+            sd_root = argv[i];
+        } else {
+            sd_root = NULL;
+            break;
+        }
+    }
+    if(!sd_root) {
+        fprintf(stderr, "usage: %s [-r] [-v] <sd dir>\n", argv[0]);
+        return 2;
+    }
+    char flag[512];
+    snprintf(flag, sizeof(flag), "%s/rfid_hashes/trace.on", sd_root);
+    FILE* recording = fopen(flag, "r");
+    if(recording) {
+        fclose(recording);
+        fprintf(stderr, "%s would have this session recorded instead, remove it\n", flag);
+        return 1;
+    }
+
+    host_sdk_init(sd_root);
+    host_sdk_log_level(log_level);
+    RfidApp* app = rfid_app_alloc();
+    bool started = rfid_app_replay(app, real_speed);
+    while(started && rfid_app_replaying(app)) {
+        rfid_app_step(app);
+    }
+    RfidAppReplayReport report;
+    rfid_app_replay_report(app, &report);
+    rfid_app_free(app);
+    if(!started) {
+        fprintf(stderr, "no trace to replay in %s/rfid_hashes, see trace.bin and trace/\n", sd_root);
+        return 1;
+    }
+
+    printf(
+        "%s %u events in %u ms, recorded over %u ms\n",
+        report.aborted ? "stopped after" : "replayed",
+        report.events,
+        report.ms,
+        report.recorded_ms);
+    if(report.events) {
+        double per_us = furi_hal_cortex_instructions_per_microsecond();
+        printf(
+            "handling: avg %.1f us, max %.1f us (event %u in state %u)\n",
+            report.cycles / per_us / report.events,
+            report.max_cycles / per_us,
+            report.max_type,
+            report.max_state);
+    }
+    printf("taps:");
+    for(uint8_t result = 0; result < AuditResultCount; result++) {
+        printf(" %s %u%s", trace_replay_results[result], report.taps[result], result + 1 < AuditResultCount ? "," : "\n");
+    }
+    return report.aborted ? 1 : 0;
+}